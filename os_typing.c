@@ -9,6 +9,7 @@
  * - Input validation and sanitization
  * - Cross-platform OS detection
  * - Type information printing
+ * - A multi-client command server (`--serve`, see src/terminal_server.h)
  */
 
 #include <iostream>
@@ -16,8 +17,18 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
+#ifndef _WIN32
+#include <sys/utsname.h>
+#endif
+
+#include "terminal_server.h"
+
 /**
  * Print available C++ types
  * @param types Vector of type names to display
@@ -87,6 +98,93 @@ void demonstrateIteration(const std::vector<int>& items) {
     }
 }
 
+static const char *const kTypes[] = {"int", "float", "double", "char", "bool", "long", "short", "unsigned int"};
+
+/* ---- commands served by --serve ---------------------------------------- */
+
+static int cmdHelp(int, char **, void *ctx) {
+    for (const term_cmd *c = static_cast<const term_cmd *>(ctx); c->name; ++c)
+        std::fprintf(term_out(), "  %s\t- %s\n", c->name, c->help);
+    return 0;
+}
+
+static int cmdEcho(int argc, char **argv, void *) {
+    for (int i = 1; i < argc; ++i) std::fprintf(term_out(), i == 1 ? "%s" : " %s", argv[i]);
+    std::fputc('\n', term_out());
+    return 0;
+}
+
+static int cmdTypes(int, char **, void *) {
+    for (const char *t : kTypes) std::fprintf(term_out(), "  - Type: %s\n", t);
+    return 0;
+}
+
+static int cmdOs(int, char **, void *) {
+#ifdef _WIN32
+    std::fputs("  Operating System: Windows\n", term_out());
+#else
+    struct utsname u;
+    if (uname(&u) != 0) {
+        std::fprintf(term_err(), "os: %s\n", std::strerror(errno));
+        return 1;
+    }
+    std::fprintf(term_out(), "  Operating System: %s\n  Version: %s\n", u.sysname, u.release);
+#endif
+    return 0;
+}
+
+static term_cmd kCommands[] = {
+    {"help", "Show this help", cmdHelp, kCommands, TERM_CMD_STREAMS},
+    {"echo", "Print arguments", cmdEcho, nullptr, TERM_CMD_STREAMS},
+    {"types", "List the supported data types", cmdTypes, nullptr, TERM_CMD_STREAMS},
+    {"os", "Show the operating system name and version", cmdOs, nullptr, TERM_CMD_STREAMS},
+    {nullptr, nullptr, nullptr, nullptr, 0},
+};
+
+static void onStopSignal(int) { terminal_serve_stop(); }
+
+/**
+ * Serve kCommands to network clients until SIGTERM/SIGINT
+ * @param argc Argument count (argv[1] is "--serve")
+ * @param argv --port N, --bind HOST, --unix PATH, --threads N, --max-conns N
+ * @return Exit status
+ */
+static int serve(int argc, char **argv) {
+    term_serve_config cfg{};
+    cfg.port = 12345;
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error: " << opt << " needs a value" << std::endl;
+            return 2;
+        }
+        const char *val = argv[++i];
+        if (opt == "--port") cfg.port = std::atoi(val);
+        else if (opt == "--bind") cfg.host = val;
+        else if (opt == "--unix") cfg.unix_path = val;
+        else if (opt == "--threads") cfg.threads = std::atoi(val);
+        else if (opt == "--max-conns") cfg.max_conns = std::atoi(val);
+        else {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return 2;
+        }
+    }
+
+    term_registry *reg = term_registry_new(kCommands, -1);
+    if (!reg) {
+        std::cerr << "Error: out of memory" << std::endl;
+        return 1;
+    }
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGINT, onStopSignal);
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    int ret = terminal_serve(reg, &cfg);
+    term_registry_free(reg);
+    return ret == 0 ? 0 : 1;
+}
+
 /**
  * Main entry point
  * @param argc Argument count
@@ -94,12 +192,11 @@ void demonstrateIteration(const std::vector<int>& items) {
  * @return Exit status (0 = success)
  */
 int main(int argc, char** argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "--serve") == 0) return serve(argc, argv);
+
     try {
         // Initialize supported types list
-        std::vector<std::string> types = {
-            "int", "float", "double", "char", 
-            "bool", "long", "short", "unsigned int"
-        };
+        std::vector<std::string> types(std::begin(kTypes), std::end(kTypes));
         printTypes(types);
 
         // Initialize OS information with defaults
@@ -2,7 +2,16 @@
 set -euo pipefail
 
 # Build script for Unix-like systems (Linux, macOS)
-# Usage: ./scripts/build.sh
+# Usage: ./scripts/build.sh [--bench [benchmark args...]]
+#   --bench  also build os_controlsystem_bench and terminal_bench and run them
+#            after the tests; remaining args go to os_controlsystem_bench
+#            (e.g. --compare baseline.json)
+
+BENCH=0
+if [ "${1:-}" = "--bench" ]; then
+    BENCH=1
+    shift
+fi
 
 TOPDIR="$(cd "$(dirname "$0")/.." && pwd)"
 cd "$TOPDIR"
@@ -16,18 +25,50 @@ else
     exit 1
 fi
 
-echo "Using compiler: $CC"
+if command -v g++ >/dev/null 2>&1; then
+    CXX=g++
+elif command -v clang++ >/dev/null 2>&1; then
+    CXX=clang++
+else
+    echo "No supported C++ compiler found (g++ or clang++)." >&2
+    exit 1
+fi
+
+echo "Using compilers: $CC / $CXX"
 
 $CC -DOS_CHECKING_TEST -Isrc -o os_checking src/os_checking.c
-$CC -Isrc -o terminal_test src/terminal_test.c src/terminal.c
-$CC -Iscripts/c-c++ -o os_controlsystem scripts/c-c++/os_controlsystem.cpp
+$CC -pthread -Isrc -o terminal_test src/terminal_test.c src/terminal.c src/terminal_history.c
+$CC -Isrc -o os_manager src/os_manager.c
+$CXX -std=c++17 -O2 -pthread -Iscripts/c-c++ -o os_controlsystem scripts/c-c++/os_controlsystem.cpp
+if [ "$(uname -s)" = Linux ]; then
+    # os_typing.c is C++; the terminal sources are C (--serve needs epoll)
+    $CXX -O2 -pthread -Isrc -o os_typing -x c++ os_typing.c -x c src/terminal.c src/terminal_history.c src/terminal_server.c
+fi
 
 echo "Running tests..."
 ./os_checking
-printf "help\nexit\n" | ./terminal_test
+printf "help\nsleep 0.05 &\necho foreground\nhelp | grep seq | count\nwait\nexit\n" | ./terminal_test
+
+# Firewall parser regressions: every rule set under tests/firewall must block tcp/12345
+for root in tests/firewall/*/; do
+    out=$(./os_controlsystem --root "$root" --checks firewall --service-port 12345 || true)
+    case "$out" in
+        *"[firewall:tcp/12345] NOT allowed"*) ;;
+        *) echo "firewall regression: $root allows tcp/12345" >&2; echo "$out" >&2; exit 1 ;;
+    esac
+done
 
 # Run os_controlsystem for non-fatal environment checks; do not fail the build on non-zero
 echo "Running os_controlsystem (non-fatal checks)..."
 ./os_controlsystem --checks all || echo "os_controlsystem reported issues (non-fatal)"
 
 echo "All tests passed (except non-fatal control checks may have reported issues)."
+
+if [ "$BENCH" = 1 ]; then
+    $CXX -std=c++17 -O2 -pthread -Iscripts/c-c++ -o os_controlsystem_bench scripts/c-c++/os_controlsystem_bench.cpp
+    echo "Running os_controlsystem benchmark..."
+    ./os_controlsystem_bench "$@"
+    $CC -O2 -pthread -Isrc -o terminal_bench src/terminal_bench.c src/terminal.c src/terminal_history.c
+    echo "Running terminal replay benchmark..."
+    ./terminal_bench
+fi
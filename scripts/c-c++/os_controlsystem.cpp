@@ -3,167 +3,1049 @@
  * @brief OS hardening control/check utility for os_typing project.
  * 
  * Provides portable system checks for:
- * - Linux: sysctl kernel parameters, systemd service status, UFW firewall rules.
+ * - Linux: sysctl kernel parameters (read directly from /proc/sys), systemd unit files and
+ *   service state (parsed natively, no systemctl), firewall rules (ufw/nftables/iptables rule files).
  * - Windows: presence of hardening scripts and suggested checks.
  * 
  * Supports config-driven checks via JSON file (tests/hardening_config.json).
  * Reports per-key results suitable for conversion to JUnit XML for CI.
+ * Check categories run concurrently; output order is fixed regardless.
+ * `--capture` writes the inspected state to a binary snapshot and
+ * `--evaluate-snapshot` audits a directory of snapshots offline.
+ * `--watch` keeps running and re-checks only what inotify reports as changed.
+ * `--format jsonl|junit` emits structured results with per-check durations.
+ * `--history FILE` appends every result to a compact history log and
+ * `--drift --since TIME` lists the findings whose status changed since then.
+ * `--metrics-out FILE` writes a Prometheus textfile for node_exporter.
+ * Commands that still have to be executed (ufw) run without a shell and are
+ * killed after `--command-timeout SEC`, so a hung tool cannot stall the audit.
+ * `--remediate` writes mismatched sysctl keys in one batch with rollback
+ * (`--journal FILE` keeps an undo journal for `--undo FILE`); `--proc-root DIR`
+ * points sysctl checks and writes at another tree.
+ * `--root DIR` (repeatable) audits extracted images or chroots offline, with
+ * every path resolved inside the root; roots are scanned concurrently.
  * 
  * @usage
- *   - Build: `g++ -std=c++17 -O2 -o os_controlsystem os_controlsystem.cpp`
+ *   - Build: `g++ -std=c++17 -O2 -pthread -o os_controlsystem os_controlsystem.cpp`
  *   - Run: `./os_controlsystem --checks all --config tests/hardening_config.json`
  * 
  * @example
  *   Output line: `[sysctl:net.ipv4.ip_forward] OK`
  *   Output line: `[sysctl:net.ipv6.conf.default.forwarding] MISMATCH expected=0 actual=1`
+ *   Output line: `[sysctl:kernel.kptr_restrict] DENIED` (key exists but is not readable)
  */
 
 // os_controlsystem.cpp
 // Portable system control/check utility for os_typing project.
 // - On Linux: checks for sysctl file, systemd service status, and UFW rules.
 // - On Windows: verifies presence of hardening script and prints suggested checks.
-// Build: g++ -std=c++17 -O2 -o os_controlsystem os_controlsystem.cpp
+// Build: g++ -std=c++17 -O2 -pthread -o os_controlsystem os_controlsystem.cpp
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <array>
+#include <map>
+#include <set>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <ctime>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <sys/stat.h>
 
 #ifdef _WIN32
 #include <windows.h>
-#define popen _popen
-#define pclose _pclose
 #else
 #include <unistd.h>
-#include <sys/wait.h>
 #endif
 
+#include "os_sysctl.h"
+#include "os_scheduler.h"
+#include "os_json.h"
+#include "os_host.h"
+#include "os_expect.h"
+#include "os_firewall.h"
+#include "os_history.h"
+#include "os_metrics.h"
+#include "os_process.h"
+#include "os_remediate.h"
+#include "os_report.h"
+#include "os_rootfs.h"
+#include "os_snapshot.h"
+#include "os_watch.h"
+
+// Progress and diagnostics ("[config] ...", summaries). Stays on stdout for
+// --format text; moves to stderr so structured formats own stdout.
+static std::ostream *g_log = &std::cout;
+static std::ostream &log_out() { return *g_log; }
+
 static bool file_exists(const std::string &path) {
     struct stat st;
     return stat(path.c_str(), &st) == 0;
 }
 
-static bool file_contains(const std::string &path, const std::string &needle) {
-    std::ifstream ifs(path);
-    if (!ifs) return false;
-    std::string line;
-    while (std::getline(ifs, line)) {
-        if (line.find(needle) != std::string::npos) return true;
+// Root of the sysctl tree that is checked and remediated (--proc-root).
+static std::string g_proc_sys_root = "/proc/sys";
+
+// Deadline for every command a check still has to run (--command-timeout).
+static std::chrono::milliseconds g_command_timeout{10000};
+
+// Runs argv (no shell) with stderr merged into stdout, bounded by g_command_timeout.
+// A command that did not exit normally gets -1 and a note appended to its output.
+static CommandResult run_cmd(std::vector<std::string> argv) {
+    ProcessSpec spec;
+    spec.argv = std::move(argv);
+    spec.timeout = g_command_timeout;
+    spec.merge_stderr = true;
+    ProcessResult p = process_run(spec);
+    CommandResult r;
+    r.output = std::move(p.out);
+    if (p.status == ProcessStatus::Exited) {
+        r.exit_code = p.exit_code;
+        return r;
     }
-    return false;
+    // The note goes on a line of its own, even after a partial last line.
+    if (!r.output.empty() && r.output.back() != '\n') r.output += '\n';
+    r.output += spec.argv[0] + ": " + p.describe(spec);
+    return r;
 }
 
-// Executes a command and captures stdout. Returns exit code via out_exit.
-static std::string run_cmd(const std::string &cmd, int &out_exit) {
-    std::array<char, 256> buffer{};
-    std::string result;
-    FILE *pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
-        out_exit = -1;
-        return "";
+// Settings shared by every check: CLI defaults overridden by the JSON config.
+// A port (range) the firewall must accept, e.g. {"tcp", 22, 22}; proto "" means tcp and udp.
+struct FirewallPortExpectation {
+    std::string proto;
+    uint16_t lo = 0, hi = 0;
+};
+
+struct HardeningConfig {
+    std::string service_name;
+    std::string service_exec;
+    int service_port = 0;
+    // Defaults to service_port/tcp when the config has no firewall_allowed_ports.
+    std::vector<FirewallPortExpectation> firewall_ports;
+    std::string firewall_policy;  // "" = not checked
+    // Compiled sysctl expectations sorted by key (last duplicate wins). Keys
+    // are copied out of the mapped config file, which --watch may see rewritten.
+    std::vector<std::pair<std::string, SysctlExpectation>> sysctl;
+};
+
+// Loads `hardening_config.json` with the single-pass parser in os_json.h.
+// Recognised top-level keys: service_name, service_exec, service_port,
+// firewall_allowed_ports, firewall_default_policy and the sysctl object;
+// anything else is parsed and ignored.
+// Fields absent from the file keep the values already present in `cfg`.
+static bool load_config(const std::string &path, HardeningConfig &cfg, JsonError &err) {
+    JsonDocument doc;
+    if (!doc.load_file(path, err)) return false;
+    JsonValue root = doc.root();
+    if (!root.is_object()) {
+        err = JsonError{1, 1, "top-level value must be an object"};
+        return false;
     }
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
+
+    JsonValue v = root.find("service_name");
+    if (v.is_string() && !v.str().empty()) cfg.service_name = std::string(v.str());
+    v = root.find("service_exec");
+    if (v.is_string() && !v.str().empty()) cfg.service_exec = std::string(v.str());
+    long long port = 0;
+    v = root.find("service_port");
+    if (v.as_int(port) && port >= 0 && port <= 65535) cfg.service_port = static_cast<int>(port);
+
+    // [{"port": 22, "proto": "tcp"}, {"port": "6000:6010", "proto": "udp"}], as in
+    // os_hardening_firewall_allowed_ports.
+    JsonValue fw = root.find("firewall_allowed_ports");
+    if (fw.valid() && !fw.is_array()) {
+        err = fw.error("firewall_allowed_ports must be an array");
+        return false;
     }
-    int rc = pclose(pipe);
-#ifndef _WIN32
-    if (WIFEXITED(rc)) out_exit = WEXITSTATUS(rc);
-    else out_exit = rc;
+    cfg.firewall_ports.clear();
+    bool fw_ok = true;
+    fw.for_each_element([&](JsonValue e) {
+        if (!fw_ok) return;
+        FirewallPortExpectation x;
+        JsonValue p = e.find("port");
+        long long n = 0;
+        bool port_ok = false;
+        if (p.as_int(n)) {
+            port_ok = n >= 0 && n <= 65535;
+            x.lo = x.hi = static_cast<uint16_t>(n);
+        } else if (p.is_string()) {
+            port_ok = fw_parse_port_range(p.str(), x.lo, x.hi);
+        }
+        if (!e.is_object() || !port_ok) {
+            err = (p.valid() ? p : e).error("firewall port must be 0-65535 or a \"lo:hi\" range");
+            fw_ok = false;
+            return;
+        }
+        JsonValue proto = e.find("proto");
+        x.proto = proto.is_string() ? std::string(proto.str()) : "tcp";
+        if (x.proto == "any") x.proto.clear();
+        cfg.firewall_ports.push_back(std::move(x));
+    });
+    if (!fw_ok) return false;
+    v = root.find("firewall_default_policy");
+    FwVerdict policy;
+    if (v.valid() && !(v.is_string() && fw_parse_verdict(v.str(), policy))) {
+        err = v.error("firewall_default_policy must be \"allow\", \"deny\" or \"reject\"");
+        return false;
+    }
+    cfg.firewall_policy = v.valid() ? fw_verdict_name(policy) : "";
+
+    // Values may be strings or bare numbers/booleans; the raw token is the
+    // expectation (see os_expect.h), compiled here once.
+    std::vector<std::pair<std::string_view, SysctlExpectation>> sysctl;
+    JsonValue sys = root.find("sysctl");
+    sysctl.reserve(sys.size());
+    bool sys_ok = true;
+    sys.for_each_member([&](std::string_view key, JsonValue val) {
+        if (!sys_ok || val.is_object() || val.is_array() || val.type() == JsonType::Null) return;
+        SysctlExpectation expect;
+        std::string why;
+        if (!SysctlExpectation::compile(key, val.str(), expect, why)) {
+            err = val.error("sysctl " + std::string(key) + ": " + why);
+            sys_ok = false;
+            return;
+        }
+        sysctl.emplace_back(key, std::move(expect));
+    });
+    if (!sys_ok) return false;
+    std::stable_sort(sysctl.begin(), sysctl.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    cfg.sysctl.clear();
+    for (size_t i = 0; i < sysctl.size(); ++i) {
+        if (i + 1 < sysctl.size() && sysctl[i + 1].first == sysctl[i].first) continue;
+        cfg.sysctl.emplace_back(std::string(sysctl[i].first), std::move(sysctl[i].second));
+    }
+    return true;
+}
+
+// One line of check output, e.g. id "sysctl:fs.file-max", text "[sysctl:fs.file-max] OK".
+// expected/actual are the compared values where a check has them (kept in --history).
+struct CheckFinding {
+    std::string id;
+    bool ok;
+    std::string text;
+    std::string expected;
+    std::string actual;
+};
+
+// Result slot owned by a single check task. Slots are printed in registration
+// order once all tasks finished, so output stays deterministic.
+struct CheckResult {
+    std::vector<CheckFinding> findings;
+    int exit_bits = 0;
+    double duration_ms = 0;  // wall-clock time of the check function
+
+    void add(std::string id, bool ok, std::string text, int fail_bits, std::string expected = std::string(),
+             std::string actual = std::string()) {
+        if (!ok) exit_bits |= fail_bits;
+        findings.push_back(CheckFinding{std::move(id), ok, std::move(text), std::move(expected), std::move(actual)});
+    }
+};
+
+// The machine os_controlsystem is running on.
+class LiveHostSource : public HostSource {
+public:
+    std::string name() const override {
+#ifdef _WIN32
+        const char *n = std::getenv("COMPUTERNAME");
+        return n ? n : "localhost";
 #else
-    out_exit = rc;
+        char buf[256] = {0};
+        if (gethostname(buf, sizeof(buf) - 1) != 0) return "localhost";
+        return buf;
 #endif
-    return result;
+    }
+
+    std::vector<SysctlValue> read_sysctl(const std::vector<std::string> &keys) override {
+        SysctlReader reader(g_proc_sys_root);
+        if (!metrics_enabled()) return reader.read_all(keys);
+        // --metrics-out: time every read for the sysctl_read histogram.
+        std::vector<SysctlValue> out;
+        out.reserve(keys.size());
+        for (const auto &k : keys) {
+            PhaseTimer t(MetricPhase::SysctlRead);
+            out.push_back(reader.read(k));
+        }
+        return out;
+    }
+
+    bool read_file(const std::string &path, std::string &out) override {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) return false;
+        out.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        metrics_count_read(out.size());
+        return true;
+    }
+
+    std::vector<std::string> list_dir(const std::string &dir) override {
+        SystemdLiveFs fs;
+        return fs.list_dir(dir);
+    }
+
+    // Parsed units are shared across checks (and --watch iterations) via an mtime-keyed cache.
+    bool load_unit(const std::string &name, SystemdUnit &out) override {
+        static SystemdUnitCache cache;
+        return cache.load(name, out);
+    }
+
+    ServiceState service_state(const std::string &name) override {
+        SystemdUnit unit;
+        load_unit(name, unit);
+        return systemd_service_state(name, unit);
+    }
+
+    CommandResult firewall_status() override { return run_cmd({"ufw", "status", "verbose"}); }
+
+    // Parses /proc/net/{tcp,tcp6,udp,udp6}: TCP sockets in LISTEN (0A), UDP sockets unconnected (07).
+    std::vector<ListeningPort> listening_ports() override {
+        std::vector<ListeningPort> ports;
+        for (const char *proto : {"tcp", "tcp6", "udp", "udp6"}) {
+            std::ifstream ifs(std::string("/proc/net/") + proto);
+            std::string line;
+            std::getline(ifs, line);  // header
+            const char *want = proto[0] == 't' ? "0A" : "07";
+            while (std::getline(ifs, line)) {
+                metrics_count_read(line.size() + 1);
+                std::istringstream ls(line);
+                std::string sl, local, remote, state;
+                if (!(ls >> sl >> local >> remote >> state) || state != want) continue;
+                auto colon = local.rfind(':');
+                if (colon == std::string::npos) continue;
+                ListeningPort p;
+                p.proto = proto;
+                p.port = static_cast<uint16_t>(std::strtoul(local.c_str() + colon + 1, nullptr, 16));
+                ports.push_back(p);
+            }
+        }
+        std::sort(ports.begin(), ports.end(), [](const ListeningPort &a, const ListeningPort &b) {
+            return a.proto != b.proto ? a.proto < b.proto : a.port < b.port;
+        });
+        ports.erase(std::unique(ports.begin(), ports.end(), [](const ListeningPort &a, const ListeningPort &b) {
+            return a.proto == b.proto && a.port == b.port;
+        }), ports.end());
+        return ports;
+    }
+};
+
+static void check_sysctl(const HardeningConfig &cfg, HostSource &src, CheckResult &res) {
+    if (cfg.sysctl.empty()) {
+        const std::string path = "/etc/sysctl.d/99-os_typing.conf";
+        std::string text = "[sysctl] Checking " + path + " ... ";
+        std::string content;
+        if (src.read_file(path, content)) {
+            bool ok = content.find("kernel.randomize_va_space") != std::string::npos ||
+                      content.find("fs.file-max") != std::string::npos;
+            res.add("sysctl", ok, text + (ok ? "OK" : "MISSING expected keys"), 1);
+        } else {
+            res.add("sysctl", false, text + "MISSING", 1);
+        }
+        return;
+    }
+
+    // Read every key in one batch (straight from /proc/sys on a live host).
+    std::vector<std::string> keys;
+    keys.reserve(cfg.sysctl.size());
+    for (const auto &kv : cfg.sysctl) keys.emplace_back(kv.first);
+    std::vector<SysctlValue> values = src.read_sysctl(keys);
+    size_t i = 0;
+    for (const auto &kv : cfg.sysctl) {
+        const std::string &key = keys[i];
+        const std::string &expected = kv.second.text();
+        const SysctlValue &v = values[i++];
+        std::string id = "sysctl:" + key;
+        std::string text = "[" + id + "] ";
+        if (v.status != SysctlStatus::Ok) {
+            text += sysctl_status_name(v.status);
+            if (v.status == SysctlStatus::Error) text += std::string(" (") + std::strerror(v.err) + ")";
+            res.add(id, false, text, 1, expected, sysctl_status_name(v.status));
+        } else if (kv.second.matches(v.value)) {
+            res.add(id, true, text + "OK", 1, expected, v.value);
+        } else {
+            res.add(id, false, text + "MISMATCH expected=" + expected + " got=" + v.value, 1, expected, v.value);
+        }
+    }
 }
 
-// Lightweight JSON reader for small config files. This is NOT a full JSON parser but
-// sufficient for our simple structured `hardening_config.json` files used in CI.
-// It fills optional fields: service_name, service_exec, service_port and sysctl map.
-static bool load_config(const std::string &path, std::string &out_service_name, std::string &out_service_exec, int &out_service_port, std::map<std::string,std::string> &out_sysctl) {
-    std::ifstream ifs(path);
-    if (!ifs) return false;
-    std::string s((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-
-    auto get_string = [&](const std::string &key)->std::string {
-        std::string pat = "\"" + key + "\"";
-        auto pos = s.find(pat);
-        if (pos == std::string::npos) return std::string();
-        auto colon = s.find(':', pos);
-        if (colon == std::string::npos) return std::string();
-        auto first_quote = s.find('"', colon+1);
-        if (first_quote == std::string::npos) return std::string();
-        auto second_quote = s.find('"', first_quote+1);
-        if (second_quote == std::string::npos) return std::string();
-        return s.substr(first_quote+1, second_quote-first_quote-1);
-    };
+// "os_typing" -> "os_typing.service"; names that already carry a unit suffix are kept.
+static std::string service_unit(const std::string &service) {
+    auto dot = service.rfind('.');
+    if (dot != std::string::npos && dot + 1 < service.size()) return service;
+    return service + ".service";
+}
+
+static void check_service_status(const HardeningConfig &cfg, HostSource &src, CheckResult &res) {
+    std::string text = "[service] Checking systemd service '" + cfg.service_name + "' ... ";
+    ServiceState st = src.service_state(service_unit(cfg.service_name));
+    if (st.active) res.add("service", true, text + "active", 2, "active", "active");
+    else if (!st.determinable) res.add("service", false, text + st.detail, 2, "active", "unknown");
+    else res.add("service", false, text + "not active (" + st.detail + ")", 2, "active", st.detail);
+}
 
-    auto get_int = [&](const std::string &key)->int {
-        std::string pat = "\"" + key + "\"";
-        auto pos = s.find(pat);
-        if (pos == std::string::npos) return -1;
-        auto colon = s.find(':', pos);
-        if (colon == std::string::npos) return -1;
-        size_t i = colon+1;
-        while (i < s.size() && isspace((unsigned char)s[i])) ++i;
-        size_t j = i;
-        while (j < s.size() && (isdigit((unsigned char)s[j]) || s[j]=='-')) ++j;
-        if (j <= i) return -1;
-        std::string num = s.substr(i, j-i);
-        try { return std::stoi(num); } catch (...) { return -1; }
+static void check_service_exec(const HardeningConfig &cfg, HostSource &src, CheckResult &res) {
+    std::string unit_name = service_unit(cfg.service_name);
+    SystemdUnit unit;
+    if (!src.load_unit(unit_name, unit)) {
+        std::string searched;
+        for (const auto &d : systemd_unit_dirs()) searched += (searched.empty() ? "" : ", ") + d;
+        res.add("service:exec", false, "[service:exec] unit file missing: " + unit_name + " (searched " + searched + ")", 2);
+        return;
+    }
+    // Effective ExecStart= after drop-ins and resets.
+    std::string effective;
+    bool found = false;
+    if (const auto *exec = unit.values("Service", "ExecStart")) {
+        for (const auto &e : *exec) {
+            if (e.find(cfg.service_exec) != std::string::npos) found = true;
+            effective += (effective.empty() ? "" : " | ") + e;
+        }
+    }
+    if (found) res.add("service:exec", true, "[service:exec] OK", 2, cfg.service_exec, effective);
+    else res.add("service:exec", false, "[service:exec] MISMATCH expected ExecStart contains: " + cfg.service_exec +
+                 " (effective: " + (effective.empty() ? "<none>" : effective) + ")", 2, cfg.service_exec, effective);
+}
+
+static std::string port_label(const FirewallPortExpectation &p) {
+    std::string label = (p.proto.empty() ? "any" : p.proto) + "/" + std::to_string(p.lo);
+    if (p.hi != p.lo) label += ":" + std::to_string(p.hi);
+    return label;
+}
+
+static void check_firewall(const HardeningConfig &cfg, HostSource &src, CheckResult &res) {
+    std::vector<FirewallPortExpectation> ports = cfg.firewall_ports;
+    if (ports.empty()) ports.push_back(FirewallPortExpectation{"tcp", uint16_t(cfg.service_port), uint16_t(cfg.service_port)});
+
+    // Saved rule files first; `ufw status` only when none are readable.
+    FirewallState st;
+    std::string text;
+    if (firewall_load(src, st)) {
+        text = "[firewall] Checking " + st.backend + " rules";
+    } else {
+        text = "[firewall] Checking UFW status";
+        CommandResult r = src.firewall_status();
+        if (r.exit_code != 0 || !fw_parse_ufw_status(r.output, st.v4.chain(), st.v6.chain(), st.enabled) || !st.enabled) {
+            res.add("firewall", false, text + " ... ufw not active or ufw not installed (output: " + r.output + ")", 4);
+            return;
+        }
+        st.backend = "ufw";
+        st.have_v6 = st.v6.rule_count() > 0;
+    }
+    text += " and " + std::to_string(ports.size()) + " allowed port(s) ... ";
+    if (!st.enabled) {
+        res.add("firewall", false, text + st.backend + " not active (" + st.enabled_detail + ")", 4);
+        return;
+    }
+
+    // One finding per expected port; a port must be open on every loaded family.
+    // They are collected first so the summary line leads the output.
+    CheckResult detail;
+    std::vector<std::string> denied;
+    for (const auto &p : ports) {
+        std::string label = port_label(p);
+        std::string why;
+        std::vector<std::string> protos = p.proto.empty() ? std::vector<std::string>{"tcp", "udp"} : std::vector<std::string>{p.proto};
+        for (const auto &proto : protos) {
+            for (int fam = 0; fam < (st.have_v6 ? 2 : 1) && why.empty(); ++fam) {
+                FirewallRuleset::Match m;
+                if ((fam ? st.v6 : st.v4).range_allowed(proto, p.lo, p.hi, m)) continue;
+                why = std::string(fw_verdict_name(m.verdict)) + (fam ? " (ipv6)" : "") +
+                      (m.by_rule ? " by rule at " + m.origin : " by default policy");
+            }
+        }
+        if (why.empty()) {
+            detail.add("firewall:" + label, true, "[firewall:" + label + "] OK allowed", 4, "allow", "allow");
+        } else {
+            detail.add("firewall:" + label, false, "[firewall:" + label + "] NOT allowed: " + why, 4, "allow", why);
+            denied.push_back(label);
+        }
+    }
+
+    bool policy_ok = true;
+    if (!cfg.firewall_policy.empty()) {
+        std::string got = fw_verdict_name(st.v4.policy());
+        if (st.have_v6 && st.v6.policy() != st.v4.policy()) got += "/" + std::string(fw_verdict_name(st.v6.policy()));
+        policy_ok = got == cfg.firewall_policy;
+        detail.add("firewall:policy", policy_ok,
+                "[firewall:policy] " + (policy_ok ? "OK " + got : "MISMATCH expected=" + cfg.firewall_policy + " got=" + got), 4,
+                cfg.firewall_policy, got);
+    }
+
+    if (!denied.empty()) {
+        std::string list;
+        for (const auto &d : denied) list += (list.empty() ? "" : ", ") + d;
+        res.add("firewall", false, text + "active but port NOT allowed (" + list + ")", 4);
+    } else if (!policy_ok) {
+        res.add("firewall", false, text + "active but default policy NOT " + cfg.firewall_policy, 4);
+    } else {
+        res.add("firewall", true, text + "active and port allowed", 4);
+    }
+    for (auto &f : detail.findings) res.add(std::move(f.id), f.ok, std::move(f.text), 4, std::move(f.expected), std::move(f.actual));
+}
+
+using CheckFn = void (*)(const HardeningConfig &, HostSource &, CheckResult &);
+
+// Host inputs a check reads; --watch re-runs a check when one of them changes.
+enum CheckInput : unsigned {
+    INPUT_SYSCTL = 1u << 0,         // /proc/sys values and /etc/sysctl.d
+    INPUT_UNIT = 1u << 1,           // unit file and drop-ins in the systemd search path
+    INPUT_SERVICE_STATE = 1u << 2,  // unit activation (/run/systemd/units)
+    INPUT_FIREWALL = 1u << 3,       // saved rule files (ufw, nftables, iptables)
+    INPUT_CONFIG = 1u << 4,         // the JSON config itself: re-plan everything
+};
+
+struct PlannedCheck {
+    const char *name;  // check name in structured reports
+    CheckFn fn;
+    unsigned inputs;
+};
+
+// Checks to run, in output order.
+static std::vector<PlannedCheck> plan_checks(const HardeningConfig &cfg, bool do_sysctl, bool do_service, bool do_firewall) {
+    std::vector<PlannedCheck> plan;
+    if (do_sysctl) plan.push_back({"sysctl", check_sysctl, INPUT_SYSCTL});
+    if (do_service) plan.push_back({"service", check_service_status, INPUT_SERVICE_STATE | INPUT_UNIT});
+    if (do_service && !cfg.service_exec.empty()) plan.push_back({"service:exec", check_service_exec, INPUT_UNIT});
+    if (do_firewall) plan.push_back({"firewall", check_firewall, INPUT_FIREWALL});
+    return plan;
+}
+
+// Runs one planned check and records how long it took.
+static void run_check(const PlannedCheck &check, const HardeningConfig &cfg, HostSource &src, CheckResult &res) {
+    auto start = std::chrono::steady_clock::now();
+    check.fn(cfg, src, res);
+    res.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (metrics_enabled()) metrics_observe(metric_phase_for_check(check.name), res.duration_ms / 1000.0);
+}
+
+static void report_check(Reporter &rep, const std::string &host, const PlannedCheck &check, const CheckResult &res) {
+    std::vector<ReportFinding> findings;
+    findings.reserve(res.findings.size());
+    for (const auto &f : res.findings) findings.push_back(ReportFinding{f.id, f.ok, f.text});
+    rep.check(host, check.name, findings, res.duration_ms);
+}
+
+// Files captured alongside sysctl values so the checks can run offline.
+static std::vector<std::string> snapshot_files() {
+    std::vector<std::string> files = {"/etc/sysctl.d/99-os_typing.conf"};
+    files.insert(files.end(), firewall_rule_files().begin(), firewall_rule_files().end());
+    return files;
+}
+
+static int capture_snapshot(const HardeningConfig &cfg, const std::string &path) {
+    LiveHostSource live;
+    SnapshotWriter w;
+    w.set_host(live.name(), static_cast<uint64_t>(std::time(nullptr)));
+
+    // Everything `sysctl -a` would show, plus configured keys so MISSING survives the round trip.
+    std::vector<std::string> keys = sysctl_list_keys();
+    for (const auto &kv : cfg.sysctl) keys.emplace_back(kv.first);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::vector<SysctlValue> values = live.read_sysctl(keys);
+    for (size_t i = 0; i < keys.size(); ++i) w.add_sysctl(keys[i], values[i]);
+
+    // The service unit is stored as resolved: main file plus every drop-in that applied.
+    std::string unit_name = service_unit(cfg.service_name);
+    std::vector<std::string> files = snapshot_files();
+    SystemdUnit unit;
+    if (live.load_unit(unit_name, unit)) {
+        files.push_back(unit.path);
+        files.insert(files.end(), unit.dropins.begin(), unit.dropins.end());
+    }
+    size_t nfiles = 0;
+    for (const auto &f : files) {
+        std::string content;
+        if (live.read_file(f, content)) { w.add_file(f, std::move(content)); ++nfiles; }
+    }
+    ServiceState st = live.service_state(unit_name);
+    w.add_command(SnapshotHostSource::service_state_command(unit_name), CommandResult{st.active ? 0 : st.determinable ? 3 : 4, st.detail});
+    w.add_command(SnapshotHostSource::firewall_command(), live.firewall_status());
+    std::vector<ListeningPort> ports = live.listening_ports();
+    for (const auto &p : ports) w.add_port(p);
+
+    std::string err;
+    if (!w.write(path, err)) {
+        log_out() << "[capture] ERROR " << err << "\n";
+        return 8;
+    }
+    log_out() << "[capture] Wrote " << path << " (" << keys.size() << " sysctl keys, " << nfiles
+              << " files, " << ports.size() << " listening ports)\n";
+    return 0;
+}
+
+// Evaluates every offline host in `paths` in parallel; hosts are reported in
+// path order as soon as they and all hosts before them are done. `Source` is a
+// HostSource with `bool open(path, err)` (a snapshot file or a root directory).
+template <typename Source>
+static int evaluate_offline(const HardeningConfig &cfg, const std::vector<PlannedCheck> &plan,
+                            const std::vector<std::string> &paths, unsigned jobs, Reporter &rep, const char *noun) {
+    struct HostReport {
+        std::string name;
+        std::string error;
+        std::vector<CheckResult> results;
+        double duration_ms = 0;
     };
+    std::vector<HostReport> reports(paths.size());
+    int exit_code = 0;
+    size_t failed = 0;
+    OrderedCompletion done(paths.size(), [&](size_t i) {
+        HostReport &r = reports[i];
+        if (!r.error.empty()) {
+            rep.error(paths[i], r.error);
+            exit_code |= 8;
+            ++failed;
+        } else {
+            rep.begin_host(r.name, paths[i]);
+            int host_exit = 0;
+            for (size_t k = 0; k < plan.size(); ++k) {
+                report_check(rep, r.name, plan[k], r.results[k]);
+                host_exit |= r.results[k].exit_bits;
+            }
+            rep.end_host(r.name, paths[i], host_exit, r.duration_ms);
+            if (host_exit != 0) ++failed;
+            exit_code |= host_exit;
+        }
+        reports[i] = HostReport();  // release the findings once written
+    });
 
-    // sysctl map: find the "sysctl" object and extract "key": "value" pairs
-    auto pos_sys = s.find("\"sysctl\"");
-    if (pos_sys != std::string::npos) {
-        auto brace = s.find('{', pos_sys);
-        if (brace != std::string::npos) {
-            size_t p = brace+1;
-            while (p < s.size()) {
-                // find next key
-                auto q = s.find('"', p);
-                if (q == std::string::npos) break;
-                auto r = s.find('"', q+1);
-                if (r == std::string::npos) break;
-                std::string k = s.substr(q+1, r-q-1);
-                auto colon = s.find(':', r);
-                if (colon == std::string::npos) break;
-                auto v1 = s.find('"', colon);
-                if (v1 == std::string::npos) break;
-                auto v2 = s.find('"', v1+1);
-                if (v2 == std::string::npos) break;
-                std::string v = s.substr(v1+1, v2-v1-1);
-                out_sysctl[k] = v;
-                p = v2 + 1;
-                // stop when closing brace found near p
-                auto closing = s.find('}', p);
-                if (closing != std::string::npos && closing < s.find(',', p)) {
-                    break;
-                }
+    TaskScheduler sched(jobs);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        sched.add([&, i] {
+            auto start = std::chrono::steady_clock::now();
+            Source src;
+            HostReport &r = reports[i];
+            if (src.open(paths[i], r.error)) {
+                r.name = src.name();
+                r.results.resize(plan.size());
+                for (size_t k = 0; k < plan.size(); ++k) run_check(plan[k], cfg, src, r.results[k]);
             }
+            r.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            done.complete(i);
+        });
+    }
+    sched.run();
+
+    rep.finish(paths.size(), failed, exit_code);
+    rep.flush();
+    log_out() << "Evaluated " << paths.size() << " " << noun << "(s): " << (paths.size() - failed)
+              << " passed, " << failed << " failed.\n";
+    return exit_code;
+}
+
+// Evaluates every snapshot in `target` (a file or a directory of files).
+static int evaluate_snapshots(const HardeningConfig &cfg, const std::vector<PlannedCheck> &plan,
+                              const std::string &target, unsigned jobs, Reporter &rep) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    std::error_code ec;
+    if (fs::is_directory(target, ec)) {
+        for (const auto &e : fs::directory_iterator(target, ec))
+            if (e.is_regular_file(ec)) paths.push_back(e.path().string());
+    } else {
+        paths.push_back(target);
+    }
+    std::sort(paths.begin(), paths.end());
+    return evaluate_offline<SnapshotHostSource>(cfg, plan, paths, jobs, rep, "snapshot");
+}
+
+// Runs the planned checks whose inputs intersect `mask` in parallel; other slots are left untouched.
+// With `done`, every slot (run or not) is passed to it as soon as it is final.
+static void run_live_checks(const HardeningConfig &cfg, const std::vector<PlannedCheck> &plan, unsigned mask,
+                            HostSource &src, std::vector<CheckResult> &results, unsigned jobs,
+                            OrderedCompletion *done = nullptr) {
+    TaskScheduler sched(jobs);
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (!(plan[i].inputs & mask)) {
+            if (done) done->complete(i);
+            continue;
+        }
+        results[i] = CheckResult();
+        sched.add([&cfg, &src, &results, &plan, done, i] {
+            run_check(plan[i], cfg, src, results[i]);
+            if (done) done->complete(i);
+        });
+    }
+    sched.run();
+}
+
+// Loads the config if present; reports problems and returns the exit bits to add.
+static int load_config_if_present(const std::string &cfg_path, HardeningConfig &cfg) {
+    if (!file_exists(cfg_path)) return 0;
+    JsonError err;
+    if (!load_config(cfg_path, cfg, err)) {
+        log_out() << "[config] ERROR " << cfg_path << ":" << err.to_string() << "\n";
+        return 8;
+    }
+    log_out() << "[config] Loaded config from " << cfg_path << "\n";
+    return 0;
+}
+
+static uint64_t unix_time_ms() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Appends every finding of one run to the --history log; returns the exit bits to add.
+static int record_history(const std::string &path, const std::vector<CheckResult> &results) {
+    if (path.empty()) return 0;
+    HistoryRun run;
+    run.time_ms = unix_time_ms();
+    for (const auto &r : results) {
+        uint32_t us = static_cast<uint32_t>(r.duration_ms * 1000.0);
+        for (const auto &f : r.findings) run.records.push_back(HistoryRecord{f.id, f.ok, f.expected, f.actual, us});
+    }
+    std::string err;
+    if (!history_append(path, std::move(run), err)) {
+        log_out() << "[history] ERROR " << err << "\n";
+        return 8;
+    }
+    return 0;
+}
+
+// Rewrites the --metrics-out textfile from the latest results; returns the exit bits to add.
+static int write_metrics(const std::string &path, const std::vector<CheckResult> &results, int exit_code) {
+    if (path.empty()) return 0;
+    std::vector<std::pair<std::string, bool>> statuses;
+    for (const auto &r : results)
+        for (const auto &f : r.findings) statuses.emplace_back(f.id, f.ok);
+    std::string err;
+    if (!metrics_write_textfile(path, metrics_render(statuses, exit_code, unix_time_ms() / 1000.0), err)) {
+        log_out() << "[metrics] ERROR " << err << "\n";
+        return 8;
+    }
+    return 0;
+}
+
+// --remediate: writes every mismatched sysctl key in one batch; any failed write or
+// read-back rolls the whole batch back. Returns the exit bits to add (8 if a rollback
+// left keys in an unknown state); keys that still mismatch are left to the checks.
+static int remediate_sysctl(const HardeningConfig &cfg, const std::string &journal) {
+    SysctlReader reader(g_proc_sys_root);
+    std::vector<SysctlChange> changes;
+    std::vector<const SysctlExpectation *> expect;
+    for (const auto &kv : cfg.sysctl) {
+        std::string key(kv.first);
+        SysctlValue v = reader.read(key);
+        if (v.status == SysctlStatus::Ok && kv.second.matches(v.value)) continue;
+        SysctlChange c{key, v.value, std::string()};
+        std::string err;
+        if (v.status != SysctlStatus::Ok) err = sysctl_status_name(v.status);
+        else if (!kv.second.remedy(v.value, c.after, err)) err = "expected " + kv.second.text() + ": " + err;
+        if (!err.empty()) {
+            log_out() << "[remediate] " << key << ": skipped (" << err << ")\n";
+            continue;
+        }
+        changes.push_back(std::move(c));
+        expect.push_back(&kv.second);
+    }
+    if (changes.empty()) {
+        log_out() << "[remediate] nothing to change\n";
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SysctlApplyResult r = sysctl_apply(g_proc_sys_root, changes,
+                                       [&](size_t i, const std::string &value) { return expect[i]->matches(value); },
+                                       journal);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    if (r.ok()) {
+        for (const auto &c : r.applied) log_out() << "[remediate] " << c.key << ": " << c.before << " -> " << c.after << "\n";
+        log_out() << "[remediate] applied " << r.applied.size() << " change(s) in " << us << " us";
+        if (!journal.empty()) log_out() << " (undo with --undo " << journal << ")";
+        log_out() << "\n";
+        return 0;
+    }
+    log_out() << "[remediate] ERROR " << r.error;
+    if (r.rolled_back) log_out() << "; batch of " << changes.size() << " change(s) rolled back";
+    log_out() << "\n";
+    for (const auto &e : r.rollback_errors) log_out() << "[remediate] ERROR rollback " << e << "\n";
+    return r.rollback_errors.empty() ? 0 : 8;
+}
+
+// --undo: restores the values recorded in a --remediate journal.
+static int undo_remediation(const std::string &journal) {
+    std::vector<std::string> errors;
+    size_t restored = sysctl_undo(g_proc_sys_root, journal, errors);
+    for (const auto &e : errors) log_out() << "[remediate] ERROR undo " << e << "\n";
+    log_out() << "[remediate] restored " << restored << " key(s) from " << journal << "\n";
+    return errors.empty() ? 0 : 8;
+}
+
+// --drift: findings in the --history log whose status changed after `since`.
+static int report_drift(const std::string &path, const std::string &since, const std::string &format) {
+    uint64_t since_ms = 0;
+    if (!since.empty() && !history_parse_time(since, unix_time_ms(), since_ms)) {
+        std::cerr << "Invalid --since '" << since << "' (expected YYYY-MM-DD[THH:MM[:SS]], @EPOCH or e.g. 7d)\n";
+        return 8;
+    }
+    HistoryLog log;
+    std::string err;
+    if (!log.open(path, err)) {
+        log_out() << "[history] ERROR " << err << "\n";
+        return 8;
+    }
+
+    ReportWriter w(stdout);
+    size_t flips = 0, runs = 0;
+    bool ok = history_drift(log, since_ms, [&](const HistoryFlip &f) {
+        ++flips;
+        if (format == "jsonl") {
+            w.write("{\"type\":\"drift\",\"time\":\"");
+            w.write(history_format_time(f.time_ms));
+            w.write("\",\"id\":\"");
+            w.json_escaped(f.now->id);
+            w.write(f.was_ok ? "\",\"was_ok\":true" : "\",\"was_ok\":false");
+            w.write(f.now->ok ? ",\"ok\":true,\"expected\":\"" : ",\"ok\":false,\"expected\":\"");
+            w.json_escaped(f.now->expected);
+            w.write("\",\"actual\":\"");
+            w.json_escaped(f.now->actual);
+            w.write("\",\"was_actual\":\"");
+            w.json_escaped(f.was_actual);
+            w.write("\"}\n");
+        } else {
+            w.write("[drift:" + f.now->id + "] " + history_format_time(f.time_ms) + (f.was_ok ? " OK" : " FAIL") +
+                    (f.now->ok ? " -> OK" : " -> FAIL") + " expected=" + f.now->expected + " actual=" + f.now->actual);
+            if (f.was_actual != f.now->actual) w.write(" (was " + f.was_actual + ")");
+            w.put('\n');
         }
+    }, runs, err);
+    w.flush();
+    if (!ok) {
+        log_out() << "[history] ERROR " << path << ": " << err << "\n";
+        return 8;
     }
+    log_out() << "[drift] " << flips << " status change(s) in " << runs << " run(s)";
+    if (!since.empty()) log_out() << " since " << history_format_time(since_ms);
+    log_out() << " (" << log.blocks().size() << " run(s) recorded in " << path << ")\n";
+    return 0;
+}
+
+#ifdef __linux__
+static volatile sig_atomic_t g_watch_stop = 0;
+
+static void watch_signal(int) { g_watch_stop = 1; }
 
-    std::string svc = get_string("service_name");
-    if (!svc.empty()) out_service_name = svc;
-    std::string exec = get_string("service_exec");
-    if (!exec.empty()) out_service_exec = exec;
-    int port = get_int("service_port");
-    if (port != -1) out_service_port = port;
+static std::string watch_timestamp() {
+    char buf[32];
+    std::time_t t = std::time(nullptr);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    return buf;
+}
 
+static bool same_findings(const CheckResult &a, const CheckResult &b) {
+    if (a.exit_bits != b.exit_bits || a.findings.size() != b.findings.size()) return false;
+    for (size_t i = 0; i < a.findings.size(); ++i)
+        if (a.findings[i].text != b.findings[i].text) return false;
     return true;
 }
 
+// Long-running mode: after the initial full check, re-evaluate only the checks
+// whose inputs changed. inotify events are coalesced for `debounce_ms` (capped
+// at 10x that under a continuous stream). procfs does not emit inotify events,
+// so sysctl values are additionally re-read every `poll_sec` seconds, which is
+// cheap now that no sysctl(8) process is involved. Only changed results are
+// printed (and, with --history, recorded); --metrics-out is rewritten after
+// every re-evaluation. Stops on SIGINT/SIGTERM and returns the latest exit code.
+template <typename Planner>
+static int run_watch(const std::string &cfg_path, HardeningConfig &cfg, std::vector<PlannedCheck> &plan,
+                     std::vector<CheckResult> &results, unsigned jobs, int debounce_ms, int poll_sec, Planner replan,
+                     Reporter &rep, const std::string &history_path, const std::string &metrics_path) {
+    using clock = std::chrono::steady_clock;
+    InotifyWatcher w;
+    std::string err;
+    if (!w.init(err)) {
+        log_out() << "[watch] ERROR " << err << "\n";
+        return 8;
+    }
+
+    std::set<std::string> unwatched;  // reported once, not on every setup()
+    auto add = [&](const std::string &dir, const std::string &name, unsigned tags) {
+        std::string e;
+        if (!w.watch(dir, name, tags, e) && unwatched.insert(e).second) log_out() << "[watch] not watching " << e << "\n";
+    };
+    // (Re)builds every watch: the unit name comes from the config, and drop-in
+    // directories come and go.
+    auto setup = [&] {
+        w.clear();
+        std::string cfg_dir = "." , cfg_name = cfg_path;
+        auto slash = cfg_path.rfind('/');
+        if (slash != std::string::npos) { cfg_dir = slash == 0 ? "/" : cfg_path.substr(0, slash); cfg_name = cfg_path.substr(slash + 1); }
+        add(cfg_dir, cfg_name, INPUT_CONFIG);
+        add("/etc/sysctl.d", "", INPUT_SYSCTL);
+        std::string unit = service_unit(cfg.service_name);
+        // Every search directory can shadow the unit or contribute drop-ins; only existing ones are watched.
+        for (const auto &dir : systemd_unit_dirs()) {
+            struct stat sb;
+            if (dir != "/etc/systemd/system" && stat(dir.c_str(), &sb) != 0) continue;
+            add(dir, unit, INPUT_UNIT);
+            add(dir, unit + ".d", INPUT_UNIT);
+            if (stat((dir + "/" + unit + ".d").c_str(), &sb) == 0) add(dir + "/" + unit + ".d", "", INPUT_UNIT);
+        }
+        add("/run/systemd/units", "invocation:" + unit, INPUT_SERVICE_STATE);
+        for (const auto &f : firewall_rule_files()) {
+            auto slash = f.rfind('/');
+            struct stat sb;
+            if (stat(f.substr(0, slash).c_str(), &sb) == 0) add(f.substr(0, slash), f.substr(slash + 1), INPUT_FIREWALL);
+        }
+    };
+    setup();
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = watch_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    int exit_code = 0;
+    for (const auto &r : results) exit_code |= r.exit_bits;
+    log_out() << "[watch] " << watch_timestamp() << " watching for changes (exit code: " << exit_code << ")" << std::endl;
+
+    LiveHostSource live;
+    const std::string host = live.name();
+    unsigned pending = 0;
+    std::vector<std::string> triggers;
+    clock::time_point first_event, last_event;
+    const auto poll_every = std::chrono::seconds(poll_sec > 0 ? poll_sec : 0);
+    clock::time_point next_poll = clock::now() + poll_every;
+    const auto debounce = std::chrono::milliseconds(debounce_ms);
+
+    while (!g_watch_stop) {
+        clock::time_point now = clock::now();
+        clock::time_point wake = clock::time_point::max();
+        if (pending) wake = std::min(last_event + debounce, first_event + debounce * 10);
+        if (poll_sec > 0) wake = std::min(wake, next_poll);
+        int timeout = -1;
+        if (wake != clock::time_point::max())
+            timeout = static_cast<int>(std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count()));
+
+        unsigned tags = w.poll(timeout, &triggers);
+        now = clock::now();
+        if (tags) {
+            if (!pending) first_event = now;
+            pending |= tags;
+            last_event = now;
+        }
+
+        // Fall through even after new events: a continuous stream must still hit the cap.
+        unsigned mask = 0;
+        if (pending && (now >= last_event + debounce || now >= first_event + debounce * 10)) {
+            mask = pending;
+            pending = 0;
+        }
+        if (poll_sec > 0 && now >= next_poll) {
+            mask |= INPUT_SYSCTL;
+            next_poll = now + poll_every;
+        }
+        if (!mask) continue;
+
+        std::vector<CheckResult> previous = results;
+        if (mask & INPUT_CONFIG) {
+            HardeningConfig fresh;
+            fresh.service_name = cfg.service_name;
+            fresh.service_port = cfg.service_port;
+            JsonError jerr;
+            bool loaded;
+            {
+                PhaseTimer t(MetricPhase::Config);
+                loaded = load_config(cfg_path, fresh, jerr);
+            }
+            if (!loaded) {
+                log_out() << "[watch] " << watch_timestamp() << " [config] ERROR " << cfg_path << ":" << jerr.to_string()
+                          << " (keeping previous config)" << std::endl;
+                mask &= ~static_cast<unsigned>(INPUT_CONFIG);
+            } else {
+                cfg = std::move(fresh);
+                plan = replan(cfg);
+                previous.assign(plan.size(), CheckResult());
+                results.assign(plan.size(), CheckResult());
+                mask = ~0u;
+            }
+        }
+        if (w.take_lost() || (mask & (INPUT_CONFIG | INPUT_UNIT))) setup();
+        run_live_checks(cfg, plan, mask, live, results, jobs);
+
+        std::vector<size_t> changed;
+        for (size_t i = 0; i < results.size(); ++i)
+            if ((plan[i].inputs & mask) && !same_findings(previous[i], results[i])) changed.push_back(i);
+        if (!changed.empty()) {
+            exit_code = 0;
+            for (const auto &r : results) exit_code |= r.exit_bits;
+            log_out() << "[watch] " << watch_timestamp() << " change detected";
+            if (!triggers.empty()) {
+                std::sort(triggers.begin(), triggers.end());
+                triggers.erase(std::unique(triggers.begin(), triggers.end()), triggers.end());
+                log_out() << " (trigger:";
+                for (const auto &t : triggers) log_out() << " " << t;
+                log_out() << ")";
+            }
+            log_out() << "\n";
+            for (size_t i : changed) report_check(rep, host, plan[i], results[i]);
+            rep.flush();
+            exit_code |= record_history(history_path, results);
+            log_out() << "[watch] exit code: " << exit_code << std::endl;
+        }
+        exit_code |= write_metrics(metrics_path, results, exit_code);
+        triggers.clear();
+    }
+    log_out() << "[watch] stopped" << std::endl;
+    rep.finish(1, exit_code != 0, exit_code);
+    return exit_code;
+}
+#endif
+
+// The benchmark (os_controlsystem_bench.cpp) includes this file for the checks
+// and brings its own main().
+#ifndef OS_CONTROLSYSTEM_NO_MAIN
 static void usage(const char *prog) {
-    std::cerr << "Usage: " << prog << " [--service-name NAME] [--service-port PORT] [--checks all|sysctl|service|firewall] [--config path]" << std::endl;
-    std::cerr << "Examples:\n  " << prog << " --checks all\n  " << prog << " --service-name os_typing --service-port 12345 --checks service,firewall --config tests/hardening_config.json" << std::endl;
+    std::cerr << "Usage: " << prog << " [--service-name NAME] [--service-port PORT] [--checks all|sysctl|service|firewall] [--config path] [--jobs N]\n"
+              << "       " << prog << " --capture FILE [--config path]\n"
+              << "       " << prog << " --evaluate-snapshot FILE|DIR [--checks ...] [--config path] [--jobs N]\n"
+              << "       " << prog << " --root DIR [--root DIR ...] [--checks ...] [--config path] [--jobs N]\n"
+              << "       " << prog << " --watch [--debounce MS] [--poll SEC] [--checks ...] [--config path]\n"
+              << "       " << prog << " --history FILE --drift [--since YYYY-MM-DD[THH:MM[:SS]]|@EPOCH|7d] [--format text|jsonl]\n"
+              << "       " << prog << " --remediate [--journal FILE] [--checks ...] [--config path] [--proc-root DIR]\n"
+              << "       " << prog << " --undo FILE [--proc-root DIR]\n"
+              << "Result format (live, snapshot and watch modes): --format text|jsonl|junit (default text)\n"
+              << "Live and watch runs append every result to a history log with --history FILE and write\n"
+              << "a Prometheus textfile (check status, latency histograms, I/O counters) with --metrics-out FILE.\n"
+              << "External commands (ufw) are killed after --command-timeout SEC (default 10, 0 = no limit)." << std::endl;
+    std::cerr << "Examples:\n  " << prog << " --checks all\n  " << prog << " --service-name os_typing --service-port 12345 --checks service,firewall --config tests/hardening_config.json\n"
+              << "  " << prog << " --capture /var/tmp/$(hostname).snap\n  " << prog << " --evaluate-snapshot /srv/audit/snapshots\n"
+              << "  " << prog << " --jobs 16 $(for d in /srv/mirror/rootfs/*; do printf -- '--root %s ' \"$d\"; done)\n"
+              << "  " << prog << " --format junit > test-results/os_controlsystem.junit.xml\n"
+              << "  " << prog << " --history /var/lib/os_controlsystem/history --drift --since 30d\n"
+              << "  " << prog << " --metrics-out /var/lib/node_exporter/textfile_collector/os_controlsystem.prom\n"
+              << "  " << prog << " --remediate --journal /var/lib/os_controlsystem/sysctl.undo --checks sysctl" << std::endl;
 }
 
 int main(int argc, char **argv) {
     std::string service_name = "os_typing";
     int service_port = 12345;
+    unsigned jobs = 0;
+    std::string cfg_path = "tests/hardening_config.json";
+    std::string capture_path;
+    std::string snapshot_target;
+    std::vector<std::string> roots;
+    bool watch = false;
+    int debounce_ms = 200;
+    int poll_sec = 10;
+    std::string format = "text";
+    std::string history_path;
+    std::string metrics_path;
+    bool drift = false;
+    std::string since;
+    bool remediate = false;
+    std::string journal_path;
+    std::string undo_path;
     std::vector<std::string> checks;
 
     // simple arg parsing
@@ -172,6 +1054,27 @@ int main(int argc, char **argv) {
         if (a == "--help" || a == "-h") { usage(argv[0]); return 0; }
         if (a == "--service-name" && i + 1 < argc) { service_name = argv[++i]; continue; }
         if (a == "--service-port" && i + 1 < argc) { service_port = std::atoi(argv[++i]); continue; }
+        if (a == "--config" && i + 1 < argc) { cfg_path = argv[++i]; continue; }
+        if (a == "--jobs" && i + 1 < argc) { jobs = static_cast<unsigned>(std::atoi(argv[++i])); continue; }
+        if (a == "--capture" && i + 1 < argc) { capture_path = argv[++i]; continue; }
+        if (a == "--evaluate-snapshot" && i + 1 < argc) { snapshot_target = argv[++i]; continue; }
+        if (a == "--root" && i + 1 < argc) { roots.push_back(argv[++i]); continue; }
+        if (a == "--watch") { watch = true; continue; }
+        if (a == "--format" && i + 1 < argc) { format = argv[++i]; continue; }
+        if (a == "--history" && i + 1 < argc) { history_path = argv[++i]; continue; }
+        if (a == "--drift") { drift = true; continue; }
+        if (a == "--metrics-out" && i + 1 < argc) { metrics_path = argv[++i]; continue; }
+        if (a == "--since" && i + 1 < argc) { since = argv[++i]; continue; }
+        if (a == "--remediate") { remediate = true; continue; }
+        if (a == "--journal" && i + 1 < argc) { journal_path = argv[++i]; continue; }
+        if (a == "--undo" && i + 1 < argc) { undo_path = argv[++i]; continue; }
+        if (a == "--proc-root" && i + 1 < argc) { g_proc_sys_root = argv[++i]; continue; }
+        if (a == "--debounce" && i + 1 < argc) { debounce_ms = std::max(0, std::atoi(argv[++i])); continue; }
+        if (a == "--poll" && i + 1 < argc) { poll_sec = std::max(0, std::atoi(argv[++i])); continue; }
+        if (a == "--command-timeout" && i + 1 < argc) {
+            g_command_timeout = std::chrono::seconds(std::max(0, std::atoi(argv[++i])));
+            continue;
+        }
         if (a == "--checks" && i + 1 < argc) {
             std::string arg = argv[++i];
             if (arg == "all") { checks = {"sysctl","service","firewall"}; }
@@ -193,6 +1096,42 @@ int main(int argc, char **argv) {
         if (c == "firewall") do_firewall = true;
     }
 
+    ReportWriter writer(stdout);
+    std::unique_ptr<Reporter> reporter = make_reporter(format, writer);
+    if (!reporter) {
+        std::cerr << "Unknown --format '" << format << "' (expected text, jsonl or junit)\n";
+        return 8;
+    }
+    if (format != "text") g_log = &std::cerr;
+
+    if (drift) {
+        if (history_path.empty() || format == "junit") {
+            std::cerr << "--drift needs --history FILE and --format text or jsonl\n";
+            return 8;
+        }
+        return report_drift(history_path, since, format);
+    }
+    if (!undo_path.empty()) return undo_remediation(undo_path);
+
+    HardeningConfig cfg;
+    cfg.service_name = service_name;
+    cfg.service_port = service_port;
+
+    // Offline modes: capture the live state once, or audit captured snapshots or image roots.
+    if (!capture_path.empty() || !snapshot_target.empty() || !roots.empty()) {
+        int exit_code = load_config_if_present(cfg_path, cfg);
+        if (!capture_path.empty()) return exit_code | capture_snapshot(cfg, capture_path);
+#ifndef _WIN32
+        if (!roots.empty()) {
+            return exit_code | evaluate_offline<RootfsHostSource>(cfg, plan_checks(cfg, do_sysctl, do_service, do_firewall),
+                                                                  roots, jobs, *reporter, "root");
+        }
+#endif
+        exit_code |= evaluate_snapshots(cfg, plan_checks(cfg, do_sysctl, do_service, do_firewall), snapshot_target, jobs,
+                                        *reporter);
+        return exit_code;
+    }
+
     bool is_linux = false;
 #ifdef __linux__
     is_linux = true;
@@ -201,122 +1140,70 @@ int main(int argc, char **argv) {
     int exit_code = 0;
 
     if (is_linux) {
-        std::cout << "Platform: Linux (detected)\n";
+        log_out() << "Platform: Linux (detected)\n";
 
         // If a config file is present, prefer config-driven checks
-        std::string cfg_path = "tests/hardening_config.json";
-        std::string cfg_service_name = service_name;
-        std::string cfg_service_exec;
-        int cfg_service_port = service_port;
-        std::map<std::string,std::string> cfg_sysctl;
-        if (!file_exists(cfg_path)) {
-            // try relative to current working dir (already there) - nothing else
-        } else {
-            if (load_config(cfg_path, cfg_service_name, cfg_service_exec, cfg_service_port, cfg_sysctl)) {
-                std::cout << "[config] Loaded config from " << cfg_path << "\n";
-            }
-        }
-
-        if (do_sysctl) {
-            if (!cfg_sysctl.empty()) {
-                for (const auto &kv : cfg_sysctl) {
-                    const auto &key = kv.first;
-                    const auto &expected = kv.second;
-                    int rc = 0;
-                    std::string out = run_cmd(std::string("sysctl -n ") + key + " 2>&1", rc);
-                    if (rc != 0 || out.find("no such file or directory") != std::string::npos || out.find("unknown oid") != std::string::npos) {
-                        std::cout << "[sysctl:" << key << "] MISSING\n";
-                        exit_code |= 1;
-                    } else {
-                        std::string value = out;
-                        // trim
-                        while (!value.empty() && (value.back() == '\n' || value.back() == '\r' || value.back() == ' ')) value.pop_back();
-                        if (value == expected) {
-                            std::cout << "[sysctl:" << key << "] OK\n";
-                        } else {
-                            std::cout << "[sysctl:" << key << "] MISMATCH expected=" << expected << " got=" << value << "\n";
-                            exit_code |= 1;
-                        }
-                    }
-                }
-            } else {
-                const std::string path = "/etc/sysctl.d/99-os_typing.conf";
-                std::cout << "[sysctl] Checking " << path << " ... ";
-                if (file_exists(path)) {
-                    bool ok = file_contains(path, "kernel.randomize_va_space") || file_contains(path, "fs.file-max");
-                    if (ok) std::cout << "OK\n";
-                    else { std::cout << "MISSING expected keys\n"; exit_code |= 1; }
-                } else { std::cout << "MISSING\n"; exit_code |= 1; }
-            }
+        if (!metrics_path.empty()) g_metrics.enabled = true;
+        {
+            PhaseTimer t(MetricPhase::Config);
+            exit_code |= load_config_if_present(cfg_path, cfg);
         }
+        // Fix first, so the checks below report the state after remediation.
+        if (remediate && do_sysctl) exit_code |= remediate_sysctl(cfg, journal_path);
 
-        if (do_service) {
-            std::cout << "[service] Checking systemd service '" << cfg_service_name << "' ... ";
-            int rc = 0;
-            std::string out = run_cmd("systemctl is-active " + cfg_service_name + " 2>&1", rc);
-            if (rc == 0 && out.find("active") != std::string::npos) {
-                std::cout << "active\n";
-            } else {
-                std::cout << "not active (output: " << out << ")\n";
-                exit_code |= 2;
-            }
-
-            if (!cfg_service_exec.empty()) {
-                std::string unit_path = std::string("/etc/systemd/system/") + cfg_service_name + ".service";
-                if (file_exists(unit_path)) {
-                    std::ifstream f(unit_path);
-                    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-                    if (content.find(cfg_service_exec) != std::string::npos) {
-                        std::cout << "[service:exec] OK\n";
-                    } else {
-                        std::cout << "[service:exec] MISMATCH expected ExecStart contains: " << cfg_service_exec << "\n";
-                        exit_code |= 2;
-                    }
-                } else {
-                    std::cout << "[service:exec] unit file missing: " << unit_path << "\n";
-                    exit_code |= 2;
-                }
-            }
-        }
-
-        if (do_firewall) {
-            std::cout << "[firewall] Checking UFW status and port " << cfg_service_port << " ... ";
-            int rc = 0;
-            std::string out = run_cmd("ufw status verbose 2>&1", rc);
-            if (rc == 0 && out.find("Status: active") != std::string::npos) {
-                std::stringstream ss(out);
-                std::string line;
-                bool port_ok = false;
-                while (std::getline(ss, line)) {
-                    if (line.find(std::to_string(cfg_service_port)) != std::string::npos && (line.find("ALLOW") != std::string::npos)) {
-                        port_ok = true; break;
-                    }
-                }
-                if (port_ok) std::cout << "active and port allowed\n";
-                else { std::cout << "active but port NOT allowed\n"; exit_code |= 4; }
-            } else {
-                std::cout << "ufw not active or ufw not installed (output: " << out << ")\n";
-                exit_code |= 4;
-            }
+        // Each check is an independent task writing into its own slot; the slow
+        // shell-outs (ufw) overlap instead of adding up. Results are reported in
+        // plan order as soon as every earlier check has finished.
+        std::vector<PlannedCheck> plan = plan_checks(cfg, do_sysctl, do_service, do_firewall);
+        std::vector<CheckResult> results(plan.size());
+        LiveHostSource live;
+        const std::string host = live.name();
+        auto start = std::chrono::steady_clock::now();
+        reporter->begin_host(host, "live");
+        OrderedCompletion done(plan.size(), [&](size_t i) {
+            report_check(*reporter, host, plan[i], results[i]);
+            reporter->flush();
+        });
+        run_live_checks(cfg, plan, ~0u, live, results, jobs, &done);
+        for (const auto &r : results) exit_code |= r.exit_bits;
+        reporter->end_host(host, "live", exit_code,
+                           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        exit_code |= record_history(history_path, results);
+        exit_code |= write_metrics(metrics_path, results, exit_code);
+#ifdef __linux__
+        if (watch) {
+            reporter->flush();
+            return run_watch(cfg_path, cfg, plan, results, jobs, debounce_ms, poll_sec,
+                             [&](const HardeningConfig &c) { return plan_checks(c, do_sysctl, do_service, do_firewall); },
+                             *reporter, history_path, metrics_path);
         }
+#endif
     } else {
-        std::cout << "Platform: Non-Linux (Windows or others). Running basic checks...\n";
+        log_out() << "Platform: Non-Linux (Windows or others). Running basic checks...\n";
+        CheckResult res;
         if (do_sysctl) {
-            std::cout << "[sysctl] Not applicable on Windows — skip\n";
+            res.add("sysctl", true, "[sysctl] Not applicable on Windows — skip", 0);
         }
         if (do_service) {
             std::string path = "deploy\\windows\\hardening.ps1";
-            std::cout << "[service] Checking presence of " << path << " ... ";
-            if (file_exists(path)) std::cout << "FOUND\n";
-            else { std::cout << "MISSING\n"; exit_code |= 2; }
+            std::string text = "[service] Checking presence of " + path + " ... ";
+            if (file_exists(path)) res.add("service", true, text + "FOUND", 2);
+            else res.add("service", false, text + "MISSING", 2);
         }
         if (do_firewall) {
-            std::cout << "[firewall] Suggestion: run 'Get-NetFirewallProfile' in an elevated PowerShell to inspect firewall status.\n";
+            res.add("firewall", true, "[firewall] Suggestion: run 'Get-NetFirewallProfile' in an elevated PowerShell to inspect firewall status.", 0);
         }
+        exit_code |= res.exit_bits;
+        reporter->begin_host("localhost", "live");
+        report_check(*reporter, "localhost", PlannedCheck{"windows", nullptr, 0}, res);
+        reporter->end_host("localhost", "live", exit_code, 0);
     }
+    reporter->finish(1, exit_code != 0, exit_code);
+    reporter->flush();
 
-    if (exit_code == 0) std::cout << "All requested checks passed.\n";
-    else std::cout << "Some checks failed (exit code: " << exit_code << "). Review output above.\n";
+    if (exit_code == 0) log_out() << "All requested checks passed.\n";
+    else log_out() << "Some checks failed (exit code: " << exit_code << "). Review output above.\n";
 
     return exit_code;
 }
+#endif /* OS_CONTROLSYSTEM_NO_MAIN */
@@ -0,0 +1,459 @@
+/**
+ * @file os_controlsystem_bench.cpp
+ * @brief Benchmark and synthetic workload generator for os_controlsystem.
+ *
+ * Builds a fake host in a temporary directory (a /proc/sys style tree,
+ * systemd units with drop-ins and cgroups, a ufw rule set) plus JSON configs
+ * of increasing size, then times each phase separately using the real check
+ * code from os_controlsystem.cpp:
+ *   - config:   load_config() of a config with N sysctl keys
+ *   - sysctl:   check_sysctl() over N keys
+ *   - service:  check_service_status() + check_service_exec() for N services
+ *   - firewall: check_firewall() against N rules (64 expected ports)
+ *
+ * For every phase and size it reports p50/p99 wall time and the number of heap
+ * allocations per check evaluated (global operator new is counted; config
+ * counts one check per sysctl key loaded), and can write them as a JSON
+ * baseline that later runs are compared against.
+ *
+ * @usage
+ *   - Build: `g++ -std=c++17 -O2 -pthread -Iscripts/c-c++ -o os_controlsystem_bench scripts/c-c++/os_controlsystem_bench.cpp`
+ *   - Run:   `./os_controlsystem_bench --out bench-baseline.json`
+ *   - Check: `./os_controlsystem_bench --compare bench-baseline.json --threshold 0.25`
+ *
+ * `./scripts/build.sh --bench` builds and runs it with the default sizes.
+ */
+
+#define OS_CONTROLSYSTEM_NO_MAIN
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"  // modes main() would use
+#endif
+#include "os_controlsystem.cpp"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <atomic>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+// ---- allocation counting ----------------------------------------------------
+
+static std::atomic<size_t> g_allocs{0};
+
+// GCC flags free() on memory from the replaced operator new as mismatched once
+// it inlines these; they are a matched malloc/free pair.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t n) { return operator new(n); }
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+void *operator new[](std::size_t n, const std::nothrow_t &t) noexcept { return operator new(n, t); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// ---- fake host ---------------------------------------------------------------
+
+// HostSource rooted at a generated directory tree; mirrors LiveHostSource.
+class BenchHostSource : public HostSource {
+public:
+    explicit BenchHostSource(std::string root) : root_(std::move(root)) {}
+
+    std::string name() const override { return "bench"; }
+
+    std::vector<SysctlValue> read_sysctl(const std::vector<std::string> &keys) override {
+        SysctlReader reader(root_ + "/proc/sys");
+        return reader.read_all(keys);
+    }
+
+    bool read_file(const std::string &path, std::string &out) override { return fs_.read_file(root_ + path, out); }
+
+    std::vector<std::string> list_dir(const std::string &dir) override { return fs_.list_dir(root_ + dir); }
+
+    ServiceState service_state(const std::string &name) override {
+        SystemdUnit unit;
+        load_unit(name, unit);
+        return systemd_service_state(name, unit, root_ + "/sys/fs/cgroup", root_ + "/run/systemd/units");
+    }
+
+    CommandResult firewall_status() override { return CommandResult{127, "ufw: not found"}; }
+
+    std::vector<ListeningPort> listening_ports() override { return {}; }
+
+private:
+    std::string root_;
+    SystemdLiveFs fs_;
+};
+
+static bool write_text(const std::string &path, const std::string &text) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs << text;
+    return static_cast<bool>(ofs);
+}
+
+static std::string sysctl_key(size_t i) {
+    return "bench.g" + std::to_string(i / 100) + ".k" + std::to_string(i % 100);
+}
+
+// /proc/sys/bench/g<i/100>/k<i%100> holding "<i>"; 100 keys per directory.
+static bool make_proc_tree(const std::string &root, size_t keys) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (size_t i = 0; i < keys; ++i) {
+        std::string dir = root + "/proc/sys/bench/g" + std::to_string(i / 100);
+        if (i % 100 == 0) fs::create_directories(dir, ec);
+        if (!write_text(dir + "/k" + std::to_string(i % 100), std::to_string(i) + "\n")) return false;
+    }
+    return true;
+}
+
+// svc<i>.service in /etc/systemd/system; every third one gets a drop-in that
+// resets ExecStart=, every other one has a populated cgroup.
+static bool make_units(const std::string &root, size_t services) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string units = root + "/etc/systemd/system";
+    std::string cg = root + "/sys/fs/cgroup/system.slice";
+    fs::create_directories(units, ec);
+    fs::create_directories(cg, ec);
+    for (size_t i = 0; i < services; ++i) {
+        std::string name = "svc" + std::to_string(i) + ".service";
+        std::string body = "[Unit]\nDescription=Synthetic service " + std::to_string(i) +
+                           "\nAfter=network.target\n\n[Service]\nType=simple\nExecStart=/usr/bin/svc" + std::to_string(i) +
+                           " --serve \\\n    --port " + std::to_string(10000 + i) +
+                           "\nRestart=on-failure\nUser=nobody\n# hardening\nNoNewPrivileges=yes\nProtectSystem=strict\n\n"
+                           "[Install]\nWantedBy=multi-user.target\n";
+        if (!write_text(units + "/" + name, body)) return false;
+        if (i % 3 == 0) {
+            fs::create_directories(units + "/" + name + ".d", ec);
+            if (!write_text(units + "/" + name + ".d/10-override.conf",
+                            "[Service]\nExecStart=\nExecStart=/usr/bin/svc" + std::to_string(i) + " --serve --override\n"))
+                return false;
+        }
+        fs::create_directories(cg + "/" + name, ec);
+        if (!write_text(cg + "/" + name + "/cgroup.events", i % 2 ? "populated 0\nfrozen 0\n" : "populated 1\nfrozen 0\n"))
+            return false;
+    }
+    return true;
+}
+
+// ufw user.rules with `rules` entries: single ports, multiport ranges, deny
+// rules and address-restricted rules, in ufw's own layout.
+static bool make_ufw(const std::string &dir, size_t rules) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(dir + "/etc/ufw", ec);
+    fs::create_directories(dir + "/etc/default", ec);
+    std::string text = "*filter\n:ufw-user-input - [0:0]\n:ufw-user-output - [0:0]\n\n### RULES ###\n\n";
+    for (size_t i = 0; i < rules; ++i) {
+        unsigned port = 1024 + static_cast<unsigned>((i * 7919) % 60000);
+        switch (i % 4) {
+        case 0:
+            text += "### tuple ### allow tcp " + std::to_string(port) + " 0.0.0.0/0 any 0.0.0.0/0 in\n";
+            text += "-A ufw-user-input -p tcp --dport " + std::to_string(port) + " -j ACCEPT\n\n";
+            break;
+        case 1:
+            text += "-A ufw-user-input -p udp -m multiport --dports " + std::to_string(port) + ":" + std::to_string(port + 20) + " -j ACCEPT\n";
+            break;
+        case 2:
+            text += "-A ufw-user-input -p tcp --dport " + std::to_string(port) + " -j DROP\n";
+            break;
+        default:
+            text += "-A ufw-user-input -p tcp --dport " + std::to_string(port) + " -s 10.0.0.0/8 -j ACCEPT\n";
+        }
+    }
+    text += "-A ufw-user-input -p tcp --dport 22 -j ACCEPT\n### END RULES ###\nCOMMIT\n";
+    return write_text(dir + "/etc/ufw/user.rules", text) && write_text(dir + "/etc/ufw/ufw.conf", "ENABLED=yes\n") &&
+           write_text(dir + "/etc/default/ufw", "IPV6=no\nDEFAULT_INPUT_POLICY=\"DROP\"\n");
+}
+
+// Config with `keys` sysctl expectations: ~90% match, ~9% mismatch, ~1% missing.
+static std::string make_config(size_t keys) {
+    std::string j = "{\n  \"service_name\": \"svc0\",\n  \"service_exec\": \"/usr/bin/svc0 --serve\",\n  \"service_port\": 22,\n";
+    j += "  \"firewall_default_policy\": \"deny\",\n  \"firewall_allowed_ports\": [\n";
+    for (unsigned i = 0; i < 64; ++i) {
+        unsigned port = 1024 + (i * 4 * 7919) % 60000;
+        j += "    { \"port\": " + std::to_string(port) + ", \"proto\": \"tcp\" },\n";
+    }
+    j += "    { \"port\": 22, \"proto\": \"tcp\", \"comment\": \"SSH\" }\n  ],\n  \"sysctl\": {\n";
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key = i % 100 == 99 ? "bench.missing.k" + std::to_string(i) : sysctl_key(i);
+        std::string value = i % 11 == 10 ? "x" : std::to_string(i);
+        j += "    \"" + key + "\": \"" + value + "\"" + (i + 1 < keys ? ",\n" : "\n");
+    }
+    j += "  }\n}\n";
+    return j;
+}
+
+// ---- measurement -------------------------------------------------------------
+
+struct PhaseResult {
+    std::string phase;
+    size_t size = 0;
+    double p50_us = 0, p99_us = 0;
+    size_t checks = 0;  // checks evaluated per run
+    double allocs = 0;  // median allocations per run, divided by checks
+};
+
+static double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t rank = static_cast<size_t>(q * static_cast<double>(v.size()) + 0.999999);  // nearest-rank
+    return v[std::min(v.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// One warm-up run, then `iterations` timed runs of fn(), which returns the
+// number of checks it evaluated.
+template <typename Fn>
+static PhaseResult measure(const std::string &phase, size_t size, unsigned iterations, Fn &&fn) {
+    size_t checks = std::max<size_t>(fn(), 1);
+    std::vector<double> times, allocs;
+    times.reserve(iterations);
+    allocs.reserve(iterations);
+    for (unsigned i = 0; i < iterations; ++i) {
+        size_t a0 = g_allocs.load(std::memory_order_relaxed);
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        size_t a1 = g_allocs.load(std::memory_order_relaxed);
+        times.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        allocs.push_back(static_cast<double>(a1 - a0));
+    }
+    PhaseResult r;
+    r.phase = phase;
+    r.size = size;
+    r.p50_us = percentile(times, 0.50);
+    r.p99_us = percentile(times, 0.99);
+    r.checks = checks;
+    r.allocs = percentile(allocs, 0.50) / static_cast<double>(checks);
+    return r;
+}
+
+static std::string results_json(const std::vector<PhaseResult> &results, unsigned iterations) {
+    std::ostringstream os;
+    os << "{\n  \"version\": 2,\n  \"iterations\": " << iterations << ",\n  \"results\": [\n";
+    char line[256];
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        std::snprintf(line, sizeof(line),
+                      "    {\"phase\": \"%s\", \"size\": %zu, \"p50_us\": %.2f, \"p99_us\": %.2f, \"checks\": %zu, "
+                      "\"allocs_per_check\": %.3f}%s\n",
+                      r.phase.c_str(), r.size, r.p50_us, r.p99_us, r.checks, r.allocs, i + 1 < results.size() ? "," : "");
+        os << line;
+    }
+    os << "  ]\n}\n";
+    return os.str();
+}
+
+// Compares against a baseline written by --out. A phase regresses when its p50
+// grows by more than `threshold` (fraction) or it allocates more per check.
+// Baselines from before allocs_per_check only compare times.
+static int compare_baseline(const std::string &path, const std::vector<PhaseResult> &results, double threshold) {
+    JsonDocument doc;
+    JsonError err;
+    if (!doc.load_file(path, err)) {
+        std::cerr << "[bench] ERROR " << path << ":" << err.to_string() << "\n";
+        return 2;
+    }
+    std::map<std::pair<std::string, size_t>, PhaseResult> base;
+    doc.root().find("results").for_each_element([&](JsonValue e) {
+        PhaseResult r;
+        long long size = 0;
+        e.find("size").as_int(size);
+        r.phase = std::string(e.find("phase").str());
+        r.size = static_cast<size_t>(size);
+        r.p50_us = std::strtod(std::string(e.find("p50_us").str()).c_str(), nullptr);
+        JsonValue a = e.find("allocs_per_check");
+        r.allocs = a.valid() ? std::strtod(std::string(a.str()).c_str(), nullptr) : -1;
+        base[{r.phase, r.size}] = r;
+    });
+
+    int regressions = 0;
+    std::fprintf(stderr, "\n%-9s %8s %12s %12s %8s %12s %12s\n", "phase", "size", "base p50us", "p50us", "delta", "base a/check", "allocs/check");
+    for (const auto &r : results) {
+        auto it = base.find({r.phase, r.size});
+        if (it == base.end()) {
+            std::fprintf(stderr, "%-9s %8zu %12s %12.1f %8s %12s %12.3f  (new)\n", r.phase.c_str(), r.size, "-", r.p50_us, "-", "-", r.allocs);
+            continue;
+        }
+        const PhaseResult &b = it->second;
+        double delta = b.p50_us > 0 ? (r.p50_us - b.p50_us) / b.p50_us : 0;
+        bool slow = delta > threshold;
+        bool alloc = b.allocs >= 0 && r.allocs > b.allocs + 0.0005;  // beyond the printed precision
+        if (slow || alloc) ++regressions;
+        std::fprintf(stderr, "%-9s %8zu %12.1f %12.1f %+7.1f%% %12.3f %12.3f%s%s\n", r.phase.c_str(), r.size, b.p50_us, r.p50_us,
+                     delta * 100, b.allocs, r.allocs, slow ? "  SLOWER" : "", alloc ? "  MORE-ALLOCS" : "");
+    }
+    std::fprintf(stderr, "[bench] %d regression(s) against %s (threshold %.0f%%)\n", regressions, path.c_str(), threshold * 100);
+    return regressions ? 1 : 0;
+}
+
+static std::vector<size_t> parse_sizes(const std::string &arg) {
+    std::vector<size_t> v;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) v.push_back(static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10)));
+    return v;
+}
+
+static void bench_usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [--keys 10,1000,10000,100000] [--services 1,10,100] [--rules 10,1000,10000]\n"
+              << "       [--iterations N] [--out FILE] [--compare FILE [--threshold 0.25]] [--keep]\n"
+              << "Times config load, sysctl, service and firewall checks on a synthetic host and reports\n"
+              << "p50/p99 and allocations per check. --out writes a JSON baseline; --compare exits 1 on regression." << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::vector<size_t> key_sizes = {10, 1000, 10000, 100000};
+    std::vector<size_t> service_sizes = {1, 10, 100};
+    std::vector<size_t> rule_sizes = {10, 1000, 10000};
+    unsigned iterations = 20;
+    std::string out_path, compare_path;
+    double threshold = 0.25;
+    bool keep = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--help" || a == "-h") { bench_usage(argv[0]); return 0; }
+        if (a == "--keys" && i + 1 < argc) { key_sizes = parse_sizes(argv[++i]); continue; }
+        if (a == "--services" && i + 1 < argc) { service_sizes = parse_sizes(argv[++i]); continue; }
+        if (a == "--rules" && i + 1 < argc) { rule_sizes = parse_sizes(argv[++i]); continue; }
+        if (a == "--iterations" && i + 1 < argc) { iterations = static_cast<unsigned>(std::max(1, std::atoi(argv[++i]))); continue; }
+        if (a == "--out" && i + 1 < argc) { out_path = argv[++i]; continue; }
+        if (a == "--compare" && i + 1 < argc) { compare_path = argv[++i]; continue; }
+        if (a == "--threshold" && i + 1 < argc) { threshold = std::atof(argv[++i]); continue; }
+        if (a == "--keep") { keep = true; continue; }
+        bench_usage(argv[0]);
+        return 2;
+    }
+
+#ifdef _WIN32
+    std::cerr << "[bench] the synthetic host needs a POSIX filesystem; not supported on Windows\n";
+    return 2;
+#else
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string tmpl = (fs::temp_directory_path(ec) / "os_controlsystem_bench.XXXXXX").string();
+    std::vector<char> buf(tmpl.begin(), tmpl.end());
+    buf.push_back('\0');
+    if (!mkdtemp(buf.data())) {
+        std::cerr << "[bench] ERROR mkdtemp " << tmpl << ": " << std::strerror(errno) << "\n";
+        return 2;
+    }
+    const std::string root = buf.data();
+
+    size_t max_keys = key_sizes.empty() ? 0 : *std::max_element(key_sizes.begin(), key_sizes.end());
+    size_t max_services = service_sizes.empty() ? 0 : *std::max_element(service_sizes.begin(), service_sizes.end());
+    auto gen_start = std::chrono::steady_clock::now();
+    if (!make_proc_tree(root, max_keys) || !make_units(root, max_services)) {
+        std::cerr << "[bench] ERROR generating the synthetic host under " << root << "\n";
+        fs::remove_all(root, ec);
+        return 2;
+    }
+    std::cerr << "[bench] synthetic host in " << root << " (" << max_keys << " keys, " << max_services << " services) built in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - gen_start).count()
+              << " ms; " << iterations << " iterations per phase\n";
+
+    std::vector<PhaseResult> results;
+    auto print = [](const PhaseResult &r) {
+        std::fprintf(stderr, "%-9s %8zu  p50 %10.1f us  p99 %10.1f us  allocs/check %9.3f (%zu checks)\n", r.phase.c_str(),
+                     r.size, r.p50_us, r.p99_us, r.allocs, r.checks);
+    };
+    BenchHostSource host(root);
+
+    for (size_t n : key_sizes) {
+        std::string cfg_path = root + "/config_" + std::to_string(n) + ".json";
+        write_text(cfg_path, make_config(n));
+        results.push_back(measure("config", n, iterations, [&] {
+            HardeningConfig cfg;
+            JsonError err;
+            if (!load_config(cfg_path, cfg, err)) std::cerr << "[bench] config: " << err.to_string() << "\n";
+            return cfg.sysctl.size();
+        }));
+        print(results.back());
+
+        HardeningConfig cfg;
+        JsonError err;
+        load_config(cfg_path, cfg, err);
+        results.push_back(measure("sysctl", n, iterations, [&] {
+            CheckResult res;
+            check_sysctl(cfg, host, res);
+            return res.findings.size();
+        }));
+        print(results.back());
+    }
+
+    for (size_t n : service_sizes) {
+        std::vector<HardeningConfig> cfgs(n);
+        for (size_t i = 0; i < n; ++i) {
+            cfgs[i].service_name = "svc" + std::to_string(i);
+            cfgs[i].service_exec = "/usr/bin/svc" + std::to_string(i) + " --serve";
+        }
+        results.push_back(measure("service", n, iterations, [&] {
+            size_t checks = 0;
+            for (const auto &c : cfgs) {
+                CheckResult res;
+                check_service_status(c, host, res);
+                check_service_exec(c, host, res);
+                checks += res.findings.size();
+            }
+            return checks;
+        }));
+        print(results.back());
+    }
+
+    HardeningConfig fw_cfg;
+    {
+        std::string cfg_path = root + "/config_fw.json";
+        write_text(cfg_path, make_config(0));
+        JsonError err;
+        load_config(cfg_path, fw_cfg, err);
+    }
+    for (size_t n : rule_sizes) {
+        std::string dir = root + "/fw_" + std::to_string(n);
+        make_ufw(dir, n);
+        BenchHostSource fw_host(dir);
+        results.push_back(measure("firewall", n, iterations, [&] {
+            CheckResult res;
+            check_firewall(fw_cfg, fw_host, res);
+            return res.findings.size();
+        }));
+        print(results.back());
+    }
+
+    if (keep) std::cerr << "[bench] kept " << root << "\n";
+    else fs::remove_all(root, ec);
+
+    std::string json = results_json(results, iterations);
+    if (!out_path.empty()) {
+        if (!write_text(out_path, json)) {
+            std::cerr << "[bench] ERROR writing " << out_path << "\n";
+            return 2;
+        }
+        std::cerr << "[bench] baseline written to " << out_path << "\n";
+    } else if (compare_path.empty()) {
+        std::cout << json;
+    }
+    return compare_path.empty() ? 0 : compare_baseline(compare_path, results, threshold);
+#endif
+}
@@ -0,0 +1,418 @@
+#ifndef OS_EXPECT_H
+#define OS_EXPECT_H
+
+/**
+ * @file os_expect.h
+ * @brief Typed expectations for sysctl values, compiled once at config load.
+ *
+ * An expectation is one or more whitespace-separated fields, matched against
+ * the whitespace-separated fields of the value (sysctl prints tuples such as
+ * `net.ipv4.ip_local_port_range` as "32768\t60999"):
+ *
+ *     field := "*"                        anything
+ *            | ["==" | "!=" | ">=" | "<=" | ">" | "<"] atom
+ *            | int ".." int               inclusive range
+ *            | "{" atom ("," atom)* "}"   one of
+ *
+ * Integer atoms compare numerically, anything else as a string (`==`, `!=`
+ * and sets only). A lone "*" accepts any value, tuples included. Examples:
+ * "2", ">= 100000", "0..2", "{1,2}", "32768 60999", ">=1024 *".
+ *
+ * Keys whose format is known (table below) are checked when the config is
+ * loaded: a field count or non-integer atom that can never match is a config
+ * error. Values are parsed straight into integers, without building strings.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** @brief Known all-integer sysctl: key and number of fields. */
+struct SysctlShape {
+    std::string_view key;
+    uint8_t fields;
+};
+
+/** @brief Sorted by key; looked up with sysctl_shape(). */
+inline constexpr SysctlShape sysctl_known_shapes[] = {
+    {"fs.file-max", 1},
+    {"fs.protected_fifos", 1},
+    {"fs.protected_hardlinks", 1},
+    {"fs.protected_regular", 1},
+    {"fs.protected_symlinks", 1},
+    {"fs.suid_dumpable", 1},
+    {"kernel.dmesg_restrict", 1},
+    {"kernel.kexec_load_disabled", 1},
+    {"kernel.kptr_restrict", 1},
+    {"kernel.perf_event_paranoid", 1},
+    {"kernel.pid_max", 1},
+    {"kernel.printk", 4},
+    {"kernel.randomize_va_space", 1},
+    {"kernel.sysrq", 1},
+    {"kernel.unprivileged_bpf_disabled", 1},
+    {"kernel.yama.ptrace_scope", 1},
+    {"net.core.bpf_jit_harden", 1},
+    {"net.core.rmem_max", 1},
+    {"net.core.somaxconn", 1},
+    {"net.core.wmem_max", 1},
+    {"net.ipv4.conf.all.accept_redirects", 1},
+    {"net.ipv4.conf.all.accept_source_route", 1},
+    {"net.ipv4.conf.all.log_martians", 1},
+    {"net.ipv4.conf.all.rp_filter", 1},
+    {"net.ipv4.conf.all.secure_redirects", 1},
+    {"net.ipv4.conf.all.send_redirects", 1},
+    {"net.ipv4.conf.default.accept_redirects", 1},
+    {"net.ipv4.conf.default.accept_source_route", 1},
+    {"net.ipv4.conf.default.rp_filter", 1},
+    {"net.ipv4.conf.default.send_redirects", 1},
+    {"net.ipv4.icmp_echo_ignore_broadcasts", 1},
+    {"net.ipv4.icmp_ignore_bogus_error_responses", 1},
+    {"net.ipv4.ip_forward", 1},
+    {"net.ipv4.ip_local_port_range", 2},
+    {"net.ipv4.tcp_fin_timeout", 1},
+    {"net.ipv4.tcp_max_syn_backlog", 1},
+    {"net.ipv4.tcp_mem", 3},
+    {"net.ipv4.tcp_rfc1337", 1},
+    {"net.ipv4.tcp_rmem", 3},
+    {"net.ipv4.tcp_syncookies", 1},
+    {"net.ipv4.tcp_timestamps", 1},
+    {"net.ipv4.tcp_wmem", 3},
+    {"net.ipv6.conf.all.accept_ra", 1},
+    {"net.ipv6.conf.all.accept_redirects", 1},
+    {"net.ipv6.conf.all.forwarding", 1},
+    {"net.ipv6.conf.default.accept_ra", 1},
+    {"net.ipv6.conf.default.accept_redirects", 1},
+    {"net.ipv6.conf.default.forwarding", 1},
+    {"vm.max_map_count", 1},
+    {"vm.mmap_min_addr", 1},
+    {"vm.overcommit_memory", 1},
+    {"vm.swappiness", 1},
+};
+
+/** @brief Shape of @p key, or nullptr if it is not in the table. */
+constexpr const SysctlShape *sysctl_shape(std::string_view key) {
+    size_t lo = 0, hi = sizeof(sysctl_known_shapes) / sizeof(sysctl_known_shapes[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (sysctl_known_shapes[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < sizeof(sysctl_known_shapes) / sizeof(sysctl_known_shapes[0]) && sysctl_known_shapes[lo].key == key
+               ? &sysctl_known_shapes[lo]
+               : nullptr;
+}
+
+constexpr bool expect_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+/** @brief Parse all of @p s as a decimal int64 (optional sign); false on junk or overflow. */
+constexpr bool expect_parse_int(std::string_view s, int64_t &out) {
+    size_t i = 0;
+    bool neg = false;
+    if (i < s.size() && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+    if (i == s.size()) return false;
+    uint64_t v = 0;
+    const uint64_t limit = neg ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX);
+    for (; i < s.size(); ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        uint64_t d = static_cast<uint64_t>(s[i] - '0');
+        if (v > (limit - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    out = neg ? static_cast<int64_t>(0 - v) : static_cast<int64_t>(v);
+    return true;
+}
+
+/**
+ * @brief Split @p s into exactly @p n whitespace-separated integers.
+ * @return false if there are more or fewer fields, or one is not an integer.
+ */
+constexpr bool expect_parse_ints(std::string_view s, int64_t *out, size_t n) {
+    size_t i = 0, count = 0;
+    while (true) {
+        while (i < s.size() && expect_space(s[i])) ++i;
+        if (i == s.size()) return count == n;
+        size_t start = i;
+        while (i < s.size() && !expect_space(s[i])) ++i;
+        if (count == n || !expect_parse_int(s.substr(start, i - start), out[count])) return false;
+        ++count;
+    }
+}
+
+constexpr bool sysctl_shapes_sorted() {
+    for (size_t i = 0; i < sizeof(sysctl_known_shapes) / sizeof(sysctl_known_shapes[0]); ++i) {
+        if (sysctl_known_shapes[i].fields < 1 || sysctl_known_shapes[i].fields > 4) return false;
+        if (i > 0 && !(sysctl_known_shapes[i - 1].key < sysctl_known_shapes[i].key)) return false;
+    }
+    return true;
+}
+static_assert(sysctl_shapes_sorted(), "sysctl_known_shapes must be sorted by key, with at most 4 fields");
+
+/** @brief A compiled expectation; see the file comment for the syntax. */
+class SysctlExpectation {
+public:
+    /**
+     * @brief Compile @p text for @p key.
+     * @param err Reason on failure, e.g. "expected 2 field(s), got 1" for ip_local_port_range.
+     */
+    static bool compile(std::string_view key, std::string_view text, SysctlExpectation &out, std::string &err) {
+        out = SysctlExpectation();
+        out.text_ = std::string(text);
+        bool parsed = tokenize(text, err, [&](std::string_view tok) {
+            Field f;
+            if (!parse_field(tok, f, err)) return false;
+            out.fields_.push_back(std::move(f));
+            return true;
+        });
+        if (!parsed) return false;
+        if (out.fields_.empty()) {
+            // "" expects an empty value.
+            Field f;
+            f.numeric = false;
+            f.strs.emplace_back();
+            out.fields_.push_back(std::move(f));
+        }
+        out.any_ = out.fields_.size() == 1 && out.fields_[0].op == Op::Any;
+
+        if (const SysctlShape *shape = sysctl_shape(key)) {
+            if (!out.any_ && out.fields_.size() != shape->fields) {
+                err = "expected " + std::to_string(shape->fields) + " field(s), got " + std::to_string(out.fields_.size());
+                return false;
+            }
+            for (const auto &f : out.fields_) {
+                if (f.op != Op::Any && !f.numeric) {
+                    err = "integer expected, got '" + f.strs[0] + "'";
+                    return false;
+                }
+            }
+            out.shape_ = shape->fields;
+        }
+        return true;
+    }
+
+    /** @brief The expectation as written in the config. */
+    const std::string &text() const { return text_; }
+
+    /** @brief Whether @p value (as read from /proc/sys) satisfies the expectation. */
+    bool matches(std::string_view value) const {
+        if (any_) return true;
+        if (shape_) {
+            // Known integer tuple: parse the fields once, compare integers only.
+            int64_t v[4] = {0, 0, 0, 0};
+            if (!expect_parse_ints(value, v, shape_)) return false;
+            for (size_t i = 0; i < shape_; ++i)
+                if (!fields_[i].test_int(v[i])) return false;
+            return true;
+        }
+        size_t pos = 0, i = 0;
+        for (; i < fields_.size(); ++i) {
+            while (pos < value.size() && expect_space(value[pos])) ++pos;
+            size_t start = pos;
+            while (pos < value.size() && !expect_space(value[pos])) ++pos;
+            if (start == pos && !(fields_.size() == 1 && value.empty())) return false;
+            if (!fields_[i].test(value.substr(start, pos - start))) return false;
+        }
+        while (pos < value.size() && expect_space(value[pos])) ++pos;
+        return pos == value.size();
+    }
+
+    /**
+     * @brief The value to write so that @p current satisfies the expectation with the smallest change.
+     *
+     * Fields that already match, and `*` fields, keep their current value; `=` writes the value;
+     * comparisons and ranges clamp to the nearest bound. Sets and `!=` have no single answer.
+     * @return false (with @p err set) if no value can be derived.
+     */
+    bool remedy(std::string_view current, std::string &out, std::string &err) const {
+        std::vector<std::string_view> cur;
+        if (fields_.size() == 1) {
+            cur.push_back(trim(current));
+        } else {
+            tokenize(current, err, [&](std::string_view tok) { cur.push_back(tok); return true; });
+        }
+        out.clear();
+        for (size_t i = 0; i < fields_.size(); ++i) {
+            const Field &f = fields_[i];
+            std::string_view c = i < cur.size() ? cur[i] : std::string_view();
+            if (!out.empty()) out += ' ';
+            if (i < cur.size() && f.test(c)) {
+                out += c;
+                continue;
+            }
+            if (!f.numeric) {
+                if (f.op != Op::Eq) {
+                    err = "no single value satisfies '" + text_ + "'";
+                    return false;
+                }
+                out += f.strs[0];
+                continue;
+            }
+            int64_t v = 0;
+            bool have = i < cur.size() && expect_parse_int(c, v);
+            switch (f.op) {
+            case Op::Eq: v = f.lo; break;
+            case Op::Lt: v = f.lo - 1; break;
+            case Op::Le: v = f.lo; break;
+            case Op::Gt: v = f.lo + 1; break;
+            case Op::Ge: v = f.lo; break;
+            case Op::Range: v = have && v > f.hi ? f.hi : f.lo; break;
+            default:
+                err = i < cur.size() || f.op != Op::Any ? "no single value satisfies '" + text_ + "'"
+                                                        : "current value has no field " + std::to_string(i + 1);
+                return false;
+            }
+            out += std::to_string(v);
+        }
+        return true;
+    }
+
+private:
+    enum class Op : uint8_t { Any, Eq, Ne, Lt, Le, Gt, Ge, Range, Set };
+
+    struct Field {
+        Op op = Op::Eq;
+        bool numeric = true;
+        int64_t lo = 0, hi = 0;      // Eq..Ge: lo; Range: [lo, hi]
+        std::vector<int64_t> ints;   // Set, sorted
+        std::vector<std::string> strs;  // string Eq/Ne: strs[0]; Set: sorted
+
+        bool test_int(int64_t v) const {
+            switch (op) {
+            case Op::Any: return true;
+            case Op::Eq: return v == lo;
+            case Op::Ne: return v != lo;
+            case Op::Lt: return v < lo;
+            case Op::Le: return v <= lo;
+            case Op::Gt: return v > lo;
+            case Op::Ge: return v >= lo;
+            case Op::Range: return v >= lo && v <= hi;
+            case Op::Set: return std::binary_search(ints.begin(), ints.end(), v);
+            }
+            return false;
+        }
+
+        bool test(std::string_view s) const {
+            if (op == Op::Any) return true;
+            if (numeric) {
+                int64_t v = 0;
+                return expect_parse_int(s, v) && test_int(v);
+            }
+            if (op == Op::Set) return std::binary_search(strs.begin(), strs.end(), s);
+            return (s == strs[0]) == (op == Op::Eq);
+        }
+    };
+
+    // Splits on whitespace, keeping "{...}" whole and joining a bare operator
+    // with its operand; stops when @p on_token returns false.
+    template <typename Fn>
+    static bool tokenize(std::string_view text, std::string &err, Fn on_token) {
+        size_t i = 0;
+        while (true) {
+            while (i < text.size() && expect_space(text[i])) ++i;
+            if (i == text.size()) return true;
+            size_t start = i;
+            if (text[i] == '{') {
+                size_t close = text.find('}', i);
+                if (close == std::string_view::npos) {
+                    err = "unterminated '{' in '" + std::string(text) + "'";
+                    return false;
+                }
+                i = close + 1;
+            } else {
+                while (i < text.size() && !expect_space(text[i])) ++i;
+                std::string_view word = text.substr(start, i - start);
+                if (word.find_first_not_of("=!<>") == std::string_view::npos) {
+                    while (i < text.size() && expect_space(text[i])) ++i;
+                    if (i == text.size()) {
+                        err = "operator '" + std::string(word) + "' needs a value";
+                        return false;
+                    }
+                    while (i < text.size() && !expect_space(text[i])) ++i;
+                }
+            }
+            if (!on_token(text.substr(start, i - start))) return false;
+        }
+    }
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && expect_space(s.front())) s.remove_prefix(1);
+        while (!s.empty() && expect_space(s.back())) s.remove_suffix(1);
+        return s;
+    }
+
+    static bool parse_field(std::string_view tok, Field &f, std::string &err) {
+        if (tok == "*") {
+            f.op = Op::Any;
+            return true;
+        }
+        if (!tok.empty() && tok.front() == '{') {
+            f.op = Op::Set;
+            std::string_view body = tok.substr(1, tok.size() - 2);
+            std::vector<std::string_view> atoms;
+            while (true) {
+                size_t comma = body.find(',');
+                atoms.push_back(trim(body.substr(0, comma)));
+                if (comma == std::string_view::npos) break;
+                body.remove_prefix(comma + 1);
+            }
+            for (auto a : atoms) {
+                int64_t v = 0;
+                if (a.empty()) {
+                    err = "empty element in set '" + std::string(tok) + "'";
+                    return false;
+                }
+                if (!expect_parse_int(a, v)) f.numeric = false;
+                f.ints.push_back(v);
+                f.strs.emplace_back(a);
+            }
+            // A set is numeric only if every element is; otherwise all compare as strings.
+            if (f.numeric) {
+                f.strs.clear();
+                std::sort(f.ints.begin(), f.ints.end());
+            } else {
+                f.ints.clear();
+                std::sort(f.strs.begin(), f.strs.end());
+            }
+            return true;
+        }
+
+        static constexpr struct { std::string_view text; Op op; } ops[] = {
+            {"==", Op::Eq}, {"!=", Op::Ne}, {">=", Op::Ge}, {"<=", Op::Le}, {">", Op::Gt}, {"<", Op::Lt},
+        };
+        for (const auto &o : ops) {
+            if (tok.substr(0, o.text.size()) != o.text) continue;
+            f.op = o.op;
+            std::string_view atom = trim(tok.substr(o.text.size()));
+            f.numeric = expect_parse_int(atom, f.lo);
+            if (!f.numeric && f.op != Op::Eq && f.op != Op::Ne) {
+                err = "'" + std::string(o.text) + "' needs an integer, got '" + std::string(atom) + "'";
+                return false;
+            }
+            if (!f.numeric) f.strs.emplace_back(atom);
+            return true;
+        }
+
+        size_t dots = tok.find("..");
+        if (dots != std::string_view::npos) {
+            f.op = Op::Range;
+            if (!expect_parse_int(tok.substr(0, dots), f.lo) || !expect_parse_int(tok.substr(dots + 2), f.hi) || f.lo > f.hi) {
+                err = "range '" + std::string(tok) + "' must be LO..HI with integers LO <= HI";
+                return false;
+            }
+            return true;
+        }
+
+        f.op = Op::Eq;
+        f.numeric = expect_parse_int(tok, f.lo);
+        if (!f.numeric) f.strs.emplace_back(tok);
+        return true;
+    }
+
+    std::string text_;
+    std::vector<Field> fields_;
+    bool any_ = false;
+    uint8_t shape_ = 0;  // field count of a known integer key, 0 otherwise
+};
+
+#endif /* OS_EXPECT_H */
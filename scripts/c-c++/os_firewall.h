@@ -0,0 +1,640 @@
+#ifndef OS_FIREWALL_H
+#define OS_FIREWALL_H
+
+/**
+ * @file os_firewall.h
+ * @brief Native firewall rule evaluation from saved rule files.
+ *
+ * Reads the rules the firewall actually loads instead of scraping
+ * `ufw status`:
+ * - ufw: /etc/ufw/user.rules and user6.rules (iptables-restore syntax), the
+ *   enabled flag from /etc/ufw/ufw.conf and the input policy from
+ *   /etc/default/ufw (DROP, ufw's default, when it is missing or unset);
+ * - nftables: `nft list ruleset` style text in /etc/nftables.conf;
+ * - iptables: iptables-save dumps (/etc/iptables/rules.v4, rules.v6, or
+ *   /etc/sysconfig/iptables, ip6tables).
+ *
+ * Rules that apply to all traffic on the input path are compiled, in order,
+ * into one interval index per protocol: sorted, disjoint port ranges, each
+ * tagged with the first rule that matches it. A port lookup is one
+ * upper_bound(), and ports not covered by any rule fall through to the chain
+ * policy. Rules narrowed by source/destination address, interface, connection
+ * state or negation do not decide reachability for everyone and are skipped.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** @brief Outcome of a rule or policy. */
+enum class FwVerdict : uint8_t { Allow, Deny, Reject };
+
+/** @brief Lower-case ufw-style name: "allow", "deny" or "reject". */
+inline const char *fw_verdict_name(FwVerdict v) {
+    switch (v) {
+    case FwVerdict::Allow: return "allow";
+    case FwVerdict::Deny: return "deny";
+    default: return "reject";
+    }
+}
+
+/** @brief Parse ACCEPT/accept/allow, DROP/drop/deny or REJECT/reject. */
+inline bool fw_parse_verdict(std::string_view s, FwVerdict &out) {
+    std::string l(s);
+    for (auto &c : l) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    // ufw's rate-limited allow ends in a jump to ufw-user-limit-accept.
+    if (l == "accept" || l == "allow" || l == "ufw-user-limit-accept" || l == "ufw6-user-limit-accept") out = FwVerdict::Allow;
+    else if (l == "drop" || l == "deny") out = FwVerdict::Deny;
+    else if (l == "reject") out = FwVerdict::Reject;
+    else return false;
+    return true;
+}
+
+/** @brief Parse "22", "1000:2000" or "1000-2000" into an inclusive range. */
+inline bool fw_parse_port_range(std::string_view s, uint16_t &lo, uint16_t &hi) {
+    auto num = [](std::string_view t, uint16_t &out) {
+        if (t.empty() || t.size() > 5) return false;
+        unsigned v = 0;
+        for (char c : t) {
+            if (c < '0' || c > '9') return false;
+            v = v * 10 + static_cast<unsigned>(c - '0');
+        }
+        if (v > 65535) return false;
+        out = static_cast<uint16_t>(v);
+        return true;
+    };
+    auto sep = s.find_first_of(":-");
+    if (sep == std::string_view::npos) {
+        if (!num(s, lo)) return false;
+        hi = lo;
+        return true;
+    }
+    return num(s.substr(0, sep), lo) && num(s.substr(sep + 1), hi) && lo <= hi;
+}
+
+/** @brief Rules and policy of one address family's input path. */
+class FirewallRuleset {
+public:
+    /** @brief Result of a port lookup. */
+    struct Match {
+        FwVerdict verdict = FwVerdict::Allow;
+        bool by_rule = false;   /**< false: decided by the chain policy. */
+        std::string origin;     /**< "file:line" of the deciding rule. */
+    };
+
+    /** @brief Append a rule; @p proto "" means every protocol. Call compile() afterwards. */
+    void add_rule(std::string proto, uint16_t lo, uint16_t hi, FwVerdict v, std::string origin) {
+        rules_.push_back(Rule{std::move(proto), lo, hi, v, std::move(origin)});
+        compiled_ = false;
+    }
+
+    void set_policy(FwVerdict v) { policy_ = v; }
+    FwVerdict policy() const { return policy_; }
+    size_t rule_count() const { return rules_.size(); }
+
+    /** @brief Build the per-protocol interval index (first matching rule wins). */
+    void compile() {
+        index_.clear();
+        std::vector<std::string> protos = {"tcp", "udp"};
+        for (const auto &r : rules_)
+            if (!r.proto.empty() && std::find(protos.begin(), protos.end(), r.proto) == protos.end()) protos.push_back(r.proto);
+        for (const auto &p : protos) {
+            std::map<uint32_t, Interval> covered;  // keyed by lo
+            for (uint32_t i = 0; i < rules_.size(); ++i) {
+                const Rule &r = rules_[i];
+                if (!r.proto.empty() && r.proto != p) continue;
+                // Only the parts no earlier rule claimed belong to this rule.
+                uint32_t cur = r.lo, hi = r.hi;
+                auto it = covered.upper_bound(cur);
+                if (it != covered.begin() && std::prev(it)->second.hi >= cur) --it;
+                while (cur <= hi) {
+                    if (it == covered.end() || it->second.lo > hi) {
+                        covered.emplace(cur, Interval{cur, hi, i});
+                        break;
+                    }
+                    if (it->second.lo > cur) covered.emplace(cur, Interval{cur, it->second.lo - 1, i});
+                    cur = it->second.hi + 1;
+                    ++it;
+                }
+            }
+            auto &v = index_[p];
+            v.reserve(covered.size());
+            for (const auto &kv : covered) {
+                if (!v.empty() && v.back().rule == kv.second.rule && v.back().hi + 1 == kv.second.lo) v.back().hi = kv.second.hi;
+                else v.push_back(kv.second);
+            }
+        }
+        compiled_ = true;
+    }
+
+    /** @brief Verdict for traffic to @p port over @p proto ("tcp", "udp", ...). */
+    Match lookup(const std::string &proto, uint16_t port) const {
+        Match m;
+        m.verdict = policy_;
+        if (!compiled_) return m;
+        auto p = index_.find(proto);
+        if (p == index_.end()) return m;
+        auto it = upper(p->second, port);
+        if (it == p->second.begin() || std::prev(it)->hi < port) return m;
+        const Rule &r = rules_[std::prev(it)->rule];
+        m.verdict = r.verdict;
+        m.by_rule = true;
+        m.origin = r.origin;
+        return m;
+    }
+
+    /**
+     * @brief Whether every port in [lo, hi] is allowed.
+     * On failure @p m describes the first port that is not.
+     */
+    bool range_allowed(const std::string &proto, uint16_t lo, uint16_t hi, Match &m) const {
+        auto p = index_.find(proto);
+        for (uint32_t port = lo; port <= hi;) {
+            m = lookup(proto, static_cast<uint16_t>(port));
+            if (m.verdict != FwVerdict::Allow) return false;
+            if (p == index_.end()) break;  // the policy decides every port
+            // Inside an interval jump past it; in a gap jump to the next interval.
+            auto it = upper(p->second, port);
+            port = m.by_rule ? std::prev(it)->hi + 1 : (it == p->second.end() ? 65536u : it->lo);
+        }
+        return true;
+    }
+
+private:
+    struct Rule {
+        std::string proto;
+        uint16_t lo, hi;
+        FwVerdict verdict;
+        std::string origin;
+    };
+    struct Interval {
+        uint32_t lo, hi;
+        uint32_t rule;
+    };
+
+    // First interval starting after @p port.
+    static std::vector<Interval>::const_iterator upper(const std::vector<Interval> &v, uint32_t port) {
+        return std::upper_bound(v.begin(), v.end(), port, [](uint32_t x, const Interval &iv) { return x < iv.lo; });
+    }
+
+    std::vector<Rule> rules_;
+    std::map<std::string, std::vector<Interval>> index_;
+    FwVerdict policy_ = FwVerdict::Allow;  // no filtering unless a policy says otherwise
+    bool compiled_ = false;
+};
+
+/**
+ * @brief All input-hook chains of one address family.
+ *
+ * nftables runs every base chain hooked on input; a packet gets through only
+ * if none of them drops it. ufw and iptables have a single chain.
+ */
+class FirewallFamily {
+public:
+    /** @brief The only (or last added) chain; created on first use. */
+    FirewallRuleset &chain() {
+        if (chains_.empty()) chains_.emplace_back();
+        return chains_.back();
+    }
+    FirewallRuleset &add_chain() {
+        chains_.emplace_back();
+        return chains_.back();
+    }
+
+    void compile() {
+        for (auto &c : chains_) c.compile();
+    }
+
+    size_t rule_count() const {
+        size_t n = 0;
+        for (const auto &c : chains_) n += c.rule_count();
+        return n;
+    }
+
+    /** @brief First non-allow chain policy; allow when nothing filters. */
+    FwVerdict policy() const {
+        for (const auto &c : chains_)
+            if (c.policy() != FwVerdict::Allow) return c.policy();
+        return FwVerdict::Allow;
+    }
+
+    /** @brief Whether every chain allows every port in [lo, hi]. */
+    bool range_allowed(const std::string &proto, uint16_t lo, uint16_t hi, FirewallRuleset::Match &m) const {
+        m = FirewallRuleset::Match();
+        for (const auto &c : chains_)
+            if (!c.range_allowed(proto, lo, hi, m)) return false;
+        return true;
+    }
+
+private:
+    std::deque<FirewallRuleset> chains_;  // stable references while parsers append
+};
+
+namespace firewall_detail {
+
+inline std::vector<std::string_view> split_ws(std::string_view line) {
+    std::vector<std::string_view> out;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') ++i;
+        if (i > start) out.push_back(line.substr(start, i - start));
+    }
+    return out;
+}
+
+template <typename Fn> void for_each_line(std::string_view text, Fn &&fn) {
+    size_t pos = 0, lineno = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) eol = text.size();
+        fn(text.substr(pos, eol - pos), ++lineno);
+        pos = eol + 1;
+    }
+}
+
+inline bool is_any_address(std::string_view a) {
+    return a == "0.0.0.0/0" || a == "::/0" || a == "0/0";
+}
+
+// nft value at tok[i]: a single word or an anonymous set in any spacing
+// ("{ 22, 80 }", "{22,80}", "{ 22,80 }"). Leaves i on the last token used.
+inline void nft_values(const std::vector<std::string_view> &tok, size_t &i, std::vector<std::string_view> &out) {
+    bool set = tok[i][0] == '{';
+    for (; i < tok.size(); ++i) {
+        std::string_view t = tok[i];
+        bool last = !set || t.back() == '}';
+        for (size_t s = 0; s < t.size();) {
+            size_t e = t.find_first_of("{},", s);
+            if (e == std::string_view::npos) e = t.size();
+            if (e > s) out.push_back(t.substr(s, e - s));
+            s = e + 1;
+        }
+        if (last) break;
+    }
+}
+
+}  // namespace firewall_detail
+
+/**
+ * @brief Load iptables-restore text (ufw user*.rules or iptables-save output).
+ *
+ * Rules appended to INPUT or the ufw user input chains count; the policy comes
+ * from the `:INPUT <POLICY>` line when present.
+ */
+inline void fw_parse_iptables(std::string_view text, const std::string &origin, FirewallRuleset &rs) {
+    using namespace firewall_detail;
+    auto input_chain = [](std::string_view c) {
+        return c == "INPUT" || c == "ufw-user-input" || c == "ufw6-user-input";
+    };
+    bool in_filter = true;  // ufw user*.rules and most dumps only carry *filter
+    for_each_line(text, [&](std::string_view line, size_t lineno) {
+        if (line.empty() || line[0] == '#') return;
+        if (line[0] == '*') { in_filter = line.substr(0, 7) == "*filter"; return; }
+        if (!in_filter) return;
+        auto tok = split_ws(line);
+        if (tok.empty()) return;
+        if (tok[0] == ":INPUT" && tok.size() >= 2) {
+            FwVerdict v;
+            if (fw_parse_verdict(tok[1], v)) rs.set_policy(v);
+            return;
+        }
+        if (tok[0] != "-A" || tok.size() < 2 || !input_chain(tok[1])) return;
+
+        std::string proto;
+        std::vector<std::string_view> ports;
+        bool restricted = false, have_verdict = false;
+        FwVerdict verdict = FwVerdict::Allow;
+        for (size_t i = 2; i < tok.size(); ++i) {
+            std::string_view t = tok[i];
+            std::string_view arg = i + 1 < tok.size() ? tok[i + 1] : std::string_view();
+            if (t == "!") restricted = true;
+            else if (t == "-p" || t == "--protocol") { proto = std::string(arg); ++i; }
+            else if (t == "--dport" || t == "--destination-port") { ports.push_back(arg); ++i; }
+            else if (t == "--dports" || t == "--destination-ports") {
+                for (size_t s = 0; s <= arg.size();) {
+                    size_t c = arg.find(',', s);
+                    if (c == std::string_view::npos) c = arg.size();
+                    ports.push_back(arg.substr(s, c - s));
+                    s = c + 1;
+                }
+                ++i;
+            } else if (t == "-s" || t == "--source" || t == "-d" || t == "--destination") {
+                if (!is_any_address(arg)) restricted = true;
+                ++i;
+            } else if (t == "-i" || t == "--in-interface" || t == "--ctstate" || t == "--state" || t == "--sport" ||
+                       t == "--sports" || t == "--source-port") {
+                restricted = true;
+                ++i;
+            } else if (t == "-j" || t == "--jump") {
+                have_verdict = fw_parse_verdict(arg, verdict);
+                ++i;
+            }
+        }
+        if (restricted || !have_verdict) return;
+        if (proto == "all") proto.clear();
+        std::string where = origin + ":" + std::to_string(lineno);
+        if (ports.empty()) {
+            rs.add_rule(proto, 0, 65535, verdict, where);
+            return;
+        }
+        for (auto p : ports) {
+            uint16_t lo, hi;
+            if (fw_parse_port_range(p, lo, hi)) rs.add_rule(proto, lo, hi, verdict, where);
+        }
+    });
+}
+
+/**
+ * @brief Load an nftables ruleset (`nft list ruleset` / /etc/nftables.conf).
+ *
+ * Only base chains hooked on input are read. `inet` tables feed both
+ * families, `ip` only @p v4 and `ip6` only @p v6. Supported matches are
+ * `tcp dport` / `udp dport` with a port, a range or an anonymous set, and
+ * `meta l4proto` / `ip protocol` / `ip6 nexthdr`; sets may span lines. A
+ * rule without a dport covers every port of its protocol(s), or of all
+ * protocols.
+ */
+inline void fw_parse_nft(std::string_view text, const std::string &origin, FirewallFamily &v4, FirewallFamily &v6) {
+    using namespace firewall_detail;
+    struct Frame {
+        std::string kind, family;
+        FirewallRuleset *r4 = nullptr, *r6 = nullptr;  // set once the chain hooks input
+    };
+    std::vector<Frame> stack;
+    auto statement = [&](std::string_view line, size_t lineno) {
+        auto tok = split_ws(line);
+        if (tok.empty()) return;
+        if (tok[0] == "}") { if (!stack.empty()) stack.pop_back(); return; }
+        if (tok.back() == "{") {
+            Frame f;
+            f.kind = std::string(tok[0]);
+            if (f.kind == "table") f.family = tok.size() >= 4 ? std::string(tok[1]) : "ip";
+            else if (!stack.empty()) f.family = stack.back().family;
+            stack.push_back(std::move(f));
+            return;
+        }
+        if (stack.empty() || stack.back().kind != "chain") return;
+        Frame &chain = stack.back();
+        bool to4 = chain.family == "inet" || chain.family == "ip";
+        bool to6 = chain.family == "inet" || chain.family == "ip6";
+
+        auto set_policy = [&](std::string_view word) {
+            FwVerdict v;
+            if (!fw_parse_verdict(word.substr(0, word.find(';')), v)) return;
+            if (chain.r4) chain.r4->set_policy(v);
+            if (chain.r6) chain.r6->set_policy(v);
+        };
+        // Chain header: "type filter hook input priority 0; policy drop;"
+        if (tok[0] == "type") {
+            for (size_t i = 0; i + 1 < tok.size(); ++i) {
+                if (tok[i] == "hook" && tok[i + 1].substr(0, tok[i + 1].find(';')) == "input") {
+                    if (to4) chain.r4 = &v4.add_chain();
+                    if (to6) chain.r6 = &v6.add_chain();
+                }
+            }
+            for (size_t i = 0; i + 1 < tok.size(); ++i)
+                if (tok[i] == "policy") set_policy(tok[i + 1]);
+            return;
+        }
+        if (tok[0] == "policy" && tok.size() >= 2) {
+            set_policy(tok[1]);
+            return;
+        }
+        if (!chain.r4 && !chain.r6) return;
+
+        std::string proto;
+        std::vector<std::string_view> ports, protos;
+        bool restricted = false, have_verdict = false;
+        FwVerdict verdict = FwVerdict::Allow;
+        // Matches come before the verdict; what follows it ("reject with icmpx type
+        // port-unreachable", "reject with tcp reset") only shapes the verdict.
+        for (size_t i = 0; i < tok.size() && !have_verdict; ++i) {
+            std::string_view t = tok[i];
+            if (t == "!=" || t == "saddr" || t == "daddr" || t == "iif" || t == "iifname" || t == "ct" || t == "sport" ||
+                t == "flags" || t == "type" || t == "limit" || t == "mark" || t[0] == '@') {
+                restricted = true;
+            } else if ((t == "tcp" || t == "udp") && i + 2 < tok.size() && tok[i + 1] == "dport") {
+                proto = std::string(t);
+                i += 2;
+                if (tok[i][0] == '@') restricted = true;  // named sets are not resolved
+                else nft_values(tok, i, ports);
+            } else if ((t == "l4proto" || t == "protocol" || t == "nexthdr") && i + 1 < tok.size()) {
+                ++i;
+                if (tok[i][0] == '@' || tok[i] == "!=") restricted = true;
+                else nft_values(tok, i, protos);
+            } else if (fw_parse_verdict(t, verdict)) {
+                have_verdict = true;
+            }
+        }
+        if (restricted || !have_verdict) return;
+        std::string where = origin + ":" + std::to_string(lineno);
+        if (ports.empty()) {
+            // No dport: the rule decides every port, e.g. a trailing bare "drop".
+            if (protos.empty()) protos.push_back("");
+            for (auto p : protos) {
+                if (chain.r4) chain.r4->add_rule(std::string(p), 0, 65535, verdict, where);
+                if (chain.r6) chain.r6->add_rule(std::string(p), 0, 65535, verdict, where);
+            }
+            return;
+        }
+        for (auto p : ports) {
+            uint16_t lo, hi;
+            if (!fw_parse_port_range(p, lo, hi)) continue;
+            if (chain.r4) chain.r4->add_rule(proto, lo, hi, verdict, where);
+            if (chain.r6) chain.r6->add_rule(proto, lo, hi, verdict, where);
+        }
+    };
+
+    // Chains and sets hold no nested blocks, so an unbalanced "{" inside one
+    // opens an anonymous set that continues on the following lines
+    // ("tcp dport {" ... "} accept"); such lines are joined into one statement.
+    auto depth = [](std::string_view line) {
+        long d = 0;
+        for (char c : line) d += c == '{' ? 1 : c == '}' ? -1 : 0;
+        return d;
+    };
+    std::string joined;
+    size_t joined_line = 0;
+    for_each_line(text, [&](std::string_view raw, size_t lineno) {
+        std::string_view line = raw.substr(0, raw.find('#'));
+        if (!joined.empty()) {
+            joined += ' ';
+            joined += line;
+            if (depth(joined) > 0) return;
+            std::string full;
+            full.swap(joined);
+            statement(full, joined_line);
+        } else if (!stack.empty() && stack.back().kind != "table" && depth(line) > 0) {
+            joined = std::string(line);
+            joined_line = lineno;
+        } else {
+            statement(line, lineno);
+        }
+    });
+}
+
+/**
+ * @brief Load `ufw status verbose` output (fallback when no rule files are readable).
+ *
+ * Port columns are matched as whole tokens ("22/tcp", "1000:2000/udp", "53"),
+ * so port 123 no longer matches a rule for 12345.
+ */
+inline bool fw_parse_ufw_status(std::string_view text, FirewallRuleset &v4, FirewallRuleset &v6, bool &active) {
+    using namespace firewall_detail;
+    active = false;
+    bool any = false;
+    for_each_line(text, [&](std::string_view line, size_t lineno) {
+        auto tok = split_ws(line);
+        if (tok.size() >= 2 && tok[0] == "Status:") { active = tok[1] == "active"; any = true; return; }
+        if (tok.size() >= 2 && tok[0] == "Default:") {
+            // "Default: deny (incoming), allow (outgoing), disabled (routed)"
+            for (size_t i = 1; i + 1 < tok.size(); ++i) {
+                FwVerdict v;
+                std::string_view name = tok[i].substr(0, tok[i].find(','));
+                if (tok[i + 1].substr(0, 10) == "(incoming)" && fw_parse_verdict(name, v)) {
+                    v4.set_policy(v);
+                    v6.set_policy(v);
+                }
+            }
+            return;
+        }
+        if (tok.size() < 3) return;
+        // "22/tcp (v6)   ALLOW IN    Anywhere (v6)"
+        bool is6 = tok[1] == "(v6)";
+        size_t act = is6 ? 2 : 1;
+        FwVerdict v;
+        if (tok[act] == "LIMIT") v = FwVerdict::Allow;
+        else if (!fw_parse_verdict(tok[act], v)) return;
+        if (act + 1 < tok.size() && tok[act + 1] == "OUT") return;
+        // Only rules from Anywhere apply to everyone.
+        size_t from = act + 1 < tok.size() && tok[act + 1] == "IN" ? act + 2 : act + 1;
+        if (from >= tok.size() || tok[from] != "Anywhere") return;
+        std::string_view spec = tok[0];
+        std::string proto;
+        auto slash = spec.find('/');
+        if (slash != std::string_view::npos) { proto = std::string(spec.substr(slash + 1)); spec = spec.substr(0, slash); }
+        std::string where = "ufw status:" + std::to_string(lineno);
+        for (size_t s = 0; s <= spec.size();) {
+            size_t c = spec.find(',', s);
+            if (c == std::string_view::npos) c = spec.size();
+            uint16_t lo, hi;
+            if (fw_parse_port_range(spec.substr(s, c - s), lo, hi)) (is6 ? v6 : v4).add_rule(proto, lo, hi, v, where);
+            s = c + 1;
+        }
+    });
+    v4.compile();
+    v6.compile();
+    return any;
+}
+
+/** @brief Value of `KEY=value` / `KEY="value"` in a shell-style config file. */
+inline bool fw_shell_var(std::string_view text, std::string_view key, std::string &out) {
+    bool found = false;
+    firewall_detail::for_each_line(text, [&](std::string_view line, size_t) {
+        while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.remove_suffix(1);
+        if (line.size() <= key.size() || line.substr(0, key.size()) != key || line[key.size()] != '=') return;
+        std::string_view v = line.substr(key.size() + 1);
+        if (v.size() >= 2 && (v.front() == '"' || v.front() == '\'') && v.back() == v.front()) v = v.substr(1, v.size() - 2);
+        out = std::string(v);
+        found = true;
+    });
+    return found;
+}
+
+/** @brief Everything needed to answer "is this port reachable" for one host. */
+struct FirewallState {
+    std::string backend;               /**< "ufw", "nftables" or "iptables". */
+    bool enabled = false;
+    std::string enabled_detail;        /**< Why the firewall is considered (in)active. */
+    FirewallFamily v4, v6;
+    bool have_v6 = false;
+    std::vector<std::string> sources;  /**< Files the rules were read from. */
+};
+
+/** @brief Files read by firewall_load(), in backend order (for snapshots and --watch). */
+inline const std::vector<std::string> &firewall_rule_files() {
+    static const std::vector<std::string> files = {
+        "/etc/ufw/ufw.conf", "/etc/default/ufw", "/etc/ufw/user.rules", "/etc/ufw/user6.rules",
+        "/etc/nftables.conf",
+        "/etc/iptables/rules.v4", "/etc/iptables/rules.v6", "/etc/sysconfig/iptables", "/etc/sysconfig/ip6tables",
+    };
+    return files;
+}
+
+/**
+ * @brief Load the saved rules of the first backend found (ufw, nftables, iptables).
+ * @tparam Fs Provides `bool read_file(const std::string&, std::string&)`.
+ * @return false if no backend's rule files are readable.
+ */
+template <typename Fs>
+bool firewall_load(Fs &fs, FirewallState &st) {
+    st = FirewallState();
+    std::string text;
+    if (fs.read_file("/etc/ufw/user.rules", text)) {
+        st.backend = "ufw";
+        st.sources.push_back("/etc/ufw/user.rules");
+        fw_parse_iptables(text, "/etc/ufw/user.rules", st.v4.chain());
+        std::string defaults, value;
+        bool ipv6 = true;
+        // ufw's own default when /etc/default/ufw does not say otherwise.
+        st.v4.chain().set_policy(FwVerdict::Deny);
+        st.v6.chain().set_policy(FwVerdict::Deny);
+        if (fs.read_file("/etc/default/ufw", defaults)) {
+            FwVerdict v;
+            if (fw_shell_var(defaults, "DEFAULT_INPUT_POLICY", value) && fw_parse_verdict(value, v)) {
+                st.v4.chain().set_policy(v);
+                st.v6.chain().set_policy(v);
+            }
+            if (fw_shell_var(defaults, "IPV6", value)) ipv6 = value == "yes";
+        }
+        if (ipv6 && fs.read_file("/etc/ufw/user6.rules", text)) {
+            st.have_v6 = true;
+            st.sources.push_back("/etc/ufw/user6.rules");
+            fw_parse_iptables(text, "/etc/ufw/user6.rules", st.v6.chain());
+        }
+        std::string conf;
+        st.enabled = fs.read_file("/etc/ufw/ufw.conf", conf) && fw_shell_var(conf, "ENABLED", value) && value == "yes";
+        st.enabled_detail = st.enabled ? "ENABLED=yes" : "/etc/ufw/ufw.conf does not set ENABLED=yes";
+    } else if (fs.read_file("/etc/nftables.conf", text)) {
+        st.backend = "nftables";
+        st.sources.push_back("/etc/nftables.conf");
+        st.have_v6 = true;
+        fw_parse_nft(text, "/etc/nftables.conf", st.v4, st.v6);
+        st.enabled = true;
+        st.enabled_detail = "ruleset in /etc/nftables.conf";
+    } else {
+        static const char *pairs[][2] = {
+            {"/etc/iptables/rules.v4", "/etc/iptables/rules.v6"},
+            {"/etc/sysconfig/iptables", "/etc/sysconfig/ip6tables"},
+        };
+        for (const auto &p : pairs) {
+            if (!fs.read_file(p[0], text)) continue;
+            st.backend = "iptables";
+            st.sources.push_back(p[0]);
+            fw_parse_iptables(text, p[0], st.v4.chain());
+            if (fs.read_file(p[1], text)) {
+                st.have_v6 = true;
+                st.sources.push_back(p[1]);
+                fw_parse_iptables(text, p[1], st.v6.chain());
+            }
+            st.enabled = true;
+            st.enabled_detail = std::string("ruleset in ") + p[0];
+            break;
+        }
+        if (st.backend.empty()) return false;
+    }
+    st.v4.compile();
+    st.v6.compile();
+    return true;
+}
+
+#endif /* OS_FIREWALL_H */
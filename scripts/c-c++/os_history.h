@@ -0,0 +1,690 @@
+#ifndef OS_HISTORY_H
+#define OS_HISTORY_H
+
+/**
+ * @file os_history.h
+ * @brief Append-only history of check results with status-drift queries.
+ *
+ * `os_controlsystem --history FILE` appends one block per run (every finding:
+ * check id, pass/fail, expected, actual, check duration). Consecutive runs are
+ * nearly identical, so blocks are stored column by column and as a delta
+ * against the previous run: an unchanged run of thousands of findings costs a
+ * few dozen bytes. Every 256th block is a key block that stands alone, which
+ * bounds the work needed to reconstruct any point in time.
+ *
+ * Log (`FILE`; integers little-endian, `varint` = unsigned LEB128,
+ * `str` = varint length + bytes):
+ *
+ *     "OSTHIST1"
+ *     block* : u8 kind (1 key, 2 delta) | varint payload_len | u32 fnv1a(payload) | payload
+ *
+ *     payload: varint time_ms (key) or zigzag(time_ms - previous) (delta)
+ *              varint n                          findings in the run, sorted by id
+ *              ids       key:   n x { varint shared_prefix, str suffix }
+ *                        delta: varint r, r x varint gap     positions dropped from the previous run
+ *                               varint a, a x { varint shared_prefix, str suffix }   ids added
+ *              status    runs over "status differs from previous run" (key blocks and new ids:
+ *                        "failing"): varint count, count x varint length, alternating, unchanged first
+ *              expected  runs over "changed since previous run", then str per changed
+ *              actual    same as expected
+ *              duration  varint count, count x { varint microseconds, varint length }
+ *
+ * Index (`FILE.idx`): "OSTHIDX1", then one 24-byte entry per block
+ * { u64 time_ms, u64 offset, u32 length, u8 kind, 3 x u8 0 }. It is derived
+ * data: if missing or stale it is rebuilt from the log. A block torn by a crash
+ * (its declared length runs past the end of the file) is cut off at the next
+ * append; any other damage after the last intact block makes appends fail.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "os_mmap.h"
+#include "os_snapshot.h"
+
+/** @brief One finding as stored in the history. */
+struct HistoryRecord {
+    std::string id;        /**< e.g. "sysctl:fs.file-max" */
+    bool ok = false;
+    std::string expected;
+    std::string actual;
+    uint32_t duration_us = 0;  /**< Duration of the check that produced the finding. */
+};
+
+/** @brief All findings of one run, sorted by id. */
+struct HistoryRun {
+    uint64_t time_ms = 0;  /**< Unix time in milliseconds. */
+    std::vector<HistoryRecord> records;
+};
+
+/** @brief A finding whose status differs from the previous run. */
+struct HistoryFlip {
+    uint64_t time_ms;
+    const HistoryRecord *now;  /**< Points into the run just decoded. */
+    bool was_ok;
+    std::string was_actual;
+};
+
+namespace history_detail {
+
+using snapshot_detail::Cursor;
+using snapshot_detail::put_fixed;
+using snapshot_detail::put_str;
+using snapshot_detail::put_varint;
+using snapshot_detail::unzigzag;
+using snapshot_detail::zigzag;
+
+constexpr char log_magic[8] = {'O', 'S', 'T', 'H', 'I', 'S', 'T', '1'};
+constexpr char idx_magic[8] = {'O', 'S', 'T', 'H', 'I', 'D', 'X', '1'};
+constexpr size_t idx_entry_size = 24;
+constexpr size_t keyframe_every = 256;
+
+enum BlockKind : uint8_t { BLOCK_KEY = 1, BLOCK_DELTA = 2 };
+
+inline uint32_t fnv1a(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    return h;
+}
+
+// Lengths of alternating false/true runs; the first run may be empty.
+inline void put_runs(std::string &out, const std::vector<bool> &bits) {
+    std::vector<uint64_t> runs;
+    bool cur = false;
+    uint64_t len = 0;
+    for (bool b : bits) {
+        if (b != cur) { runs.push_back(len); cur = b; len = 0; }
+        ++len;
+    }
+    runs.push_back(len);
+    put_varint(out, runs.size());
+    for (uint64_t r : runs) put_varint(out, r);
+}
+
+inline bool get_runs(Cursor &c, size_t n, std::vector<bool> &bits) {
+    bits.clear();
+    uint64_t count = c.varint();
+    bool cur = false;
+    for (uint64_t i = 0; i < count && !c.bad; ++i, cur = !cur) {
+        uint64_t len = c.varint();
+        if (len > n - bits.size()) return false;
+        bits.insert(bits.end(), len, cur);
+    }
+    return !c.bad && bits.size() == n;
+}
+
+inline void put_front_coded(std::string &out, std::string_view prev, std::string_view id) {
+    size_t shared = 0;
+    while (shared < prev.size() && shared < id.size() && prev[shared] == id[shared]) ++shared;
+    put_varint(out, shared);
+    put_str(out, id.substr(shared));
+}
+
+inline bool get_front_coded(Cursor &c, const std::string &prev, std::string &id) {
+    uint64_t shared = c.varint();
+    std::string_view suffix = c.str();
+    if (c.bad || shared > prev.size()) return false;
+    id.assign(prev, 0, shared);
+    id.append(suffix.data(), suffix.size());
+    return true;
+}
+
+// Encodes @p run as a key block, or as a delta against @p prev.
+inline std::string encode_payload(const HistoryRun *prev, const HistoryRun &run) {
+    std::string out;
+    const auto &recs = run.records;
+    put_varint(out, prev ? zigzag(static_cast<int64_t>(run.time_ms - prev->time_ms)) : run.time_ms);
+    put_varint(out, recs.size());
+
+    // base[i]: the same finding in the previous run, if any.
+    std::vector<const HistoryRecord *> base(recs.size(), nullptr);
+    if (!prev) {
+        std::string_view last;
+        for (const auto &r : recs) { put_front_coded(out, last, r.id); last = r.id; }
+    } else {
+        std::vector<size_t> removed;
+        std::vector<size_t> added;
+        size_t i = 0, j = 0;
+        const auto &old = prev->records;
+        while (i < old.size() || j < recs.size()) {
+            if (j == recs.size() || (i < old.size() && old[i].id < recs[j].id)) removed.push_back(i++);
+            else if (i == old.size() || recs[j].id < old[i].id) added.push_back(j++);
+            else base[j++] = &old[i++];
+        }
+        put_varint(out, removed.size());
+        for (size_t k = 0; k < removed.size(); ++k) put_varint(out, k ? removed[k] - removed[k - 1] - 1 : removed[k]);
+        put_varint(out, added.size());
+        std::string_view last;
+        for (size_t k : added) { put_front_coded(out, last, recs[k].id); last = recs[k].id; }
+    }
+
+    std::vector<bool> bits(recs.size());
+    for (size_t i = 0; i < recs.size(); ++i) bits[i] = base[i] ? base[i]->ok != recs[i].ok : !recs[i].ok;
+    put_runs(out, bits);
+
+    for (int col = 0; col < 2; ++col) {
+        auto field = [col](const HistoryRecord &r) -> const std::string & { return col ? r.actual : r.expected; };
+        for (size_t i = 0; i < recs.size(); ++i) bits[i] = !base[i] || field(*base[i]) != field(recs[i]);
+        put_runs(out, bits);
+        for (size_t i = 0; i < recs.size(); ++i)
+            if (bits[i]) put_str(out, field(recs[i]));
+    }
+
+    std::string runs;
+    size_t count = 0;
+    for (size_t i = 0; i < recs.size();) {
+        size_t end = i;
+        while (end < recs.size() && recs[end].duration_us == recs[i].duration_us) ++end;
+        put_varint(runs, recs[i].duration_us);
+        put_varint(runs, end - i);
+        ++count;
+        i = end;
+    }
+    put_varint(out, count);
+    out += runs;
+    return out;
+}
+
+// Decodes a block onto @p state (the previous run; ignored for key blocks).
+// Unchanged values are moved out of @p state, or its records are taken over
+// whole when the set of findings did not change. Status changes are appended
+// to @p flips.
+inline bool decode_payload(uint8_t kind, std::string_view payload, HistoryRun &state, HistoryRun &next,
+                           std::vector<HistoryFlip> *flips) {
+    Cursor c{payload};
+    uint64_t t = c.varint();
+    next.time_ms = kind == BLOCK_KEY ? t : state.time_ms + static_cast<uint64_t>(unzigzag(t));
+    uint64_t n = c.varint();
+    auto &recs = next.records;
+    std::vector<HistoryRecord *> base;  // the same finding in @p state, if any
+
+    if (kind == BLOCK_KEY) {
+        if (c.bad || n > payload.size()) return false;  // every id takes at least two bytes
+        recs.assign(n, HistoryRecord());
+        base.assign(n, nullptr);
+        for (uint64_t i = 0; i < n; ++i)
+            if (!get_front_coded(c, i ? recs[i - 1].id : std::string(), recs[i].id)) return false;
+        for (uint64_t i = 1; i < n; ++i)
+            if (!(recs[i - 1].id < recs[i].id)) return false;
+        // Values are all stored; the match only lets status changes across a key block show up.
+        auto &old = state.records;
+        for (size_t i = 0, j = 0; i < old.size() && j < n;) {
+            if (old[i].id < recs[j].id) ++i;
+            else if (recs[j].id < old[i].id) ++j;
+            else base[j++] = &old[i++];
+        }
+    } else {
+        auto &old = state.records;
+        uint64_t nr = c.varint();
+        if (c.bad || nr > old.size()) return false;
+        std::vector<bool> dropped(old.size(), false);
+        uint64_t pos = 0;
+        for (uint64_t k = 0; k < nr; ++k) {
+            pos += c.varint() + (k ? 1 : 0);
+            if (c.bad || pos >= old.size()) return false;
+            dropped[pos] = true;
+        }
+        uint64_t na = c.varint();
+        if (c.bad || na > payload.size() || old.size() - nr + na != n) return false;
+        if (nr == 0 && na == 0) {
+            // Same findings as before (the common case): update them in place.
+            recs = std::move(old);
+            base.resize(n);
+            for (uint64_t i = 0; i < n; ++i) base[i] = &recs[i];
+        } else {
+            recs.assign(n, HistoryRecord());
+            base.assign(n, nullptr);
+            std::vector<std::string> added(na);
+            for (uint64_t k = 0; k < na; ++k)
+                if (!get_front_coded(c, k ? added[k - 1] : std::string(), added[k])) return false;
+            size_t i = 0, a = 0;
+            for (uint64_t j = 0; j < n; ++j) {
+                while (i < old.size() && dropped[i]) ++i;
+                if (a < na && (i == old.size() || added[a] < old[i].id)) {
+                    recs[j].id = std::move(added[a++]);
+                } else if (i < old.size()) {
+                    if (a < na && added[a] == old[i].id) return false;
+                    base[j] = &old[i];
+                    recs[j].id = std::move(old[i++].id);
+                } else {
+                    return false;
+                }
+            }
+            for (uint64_t j = 1; j < n; ++j)
+                if (!(recs[j - 1].id < recs[j].id)) return false;
+        }
+    }
+
+    std::vector<bool> bits;
+    if (!get_runs(c, n, bits)) return false;
+    for (uint64_t i = 0; i < n; ++i) {
+        bool ok = kind == BLOCK_DELTA && base[i] ? base[i]->ok != bits[i] : !bits[i];
+        // Values of base[i] are still intact here (even when updating in place).
+        if (flips && base[i] && base[i]->ok != ok) flips->push_back(HistoryFlip{next.time_ms, &recs[i], base[i]->ok, base[i]->actual});
+        recs[i].ok = ok;
+    }
+
+    for (int col = 0; col < 2; ++col) {
+        if (!get_runs(c, n, bits)) return false;
+        for (uint64_t i = 0; i < n; ++i) {
+            std::string &dst = col ? recs[i].actual : recs[i].expected;
+            if (bits[i]) {
+                std::string_view s = c.str();
+                dst.assign(s.data(), s.size());
+            } else if (base[i]) {
+                if (base[i] != &recs[i]) dst = std::move(col ? base[i]->actual : base[i]->expected);
+            } else {
+                return false;
+            }
+        }
+    }
+
+    uint64_t count = c.varint();
+    uint64_t filled = 0;
+    for (uint64_t k = 0; k < count && !c.bad; ++k) {
+        uint64_t us = c.varint();
+        uint64_t len = c.varint();
+        if (len > n - filled) return false;
+        for (uint64_t i = 0; i < len; ++i) recs[filled++].duration_us = static_cast<uint32_t>(us);
+    }
+    return !c.bad && filled == n && c.pos == payload.size();
+}
+
+} // namespace history_detail
+
+/**
+ * @brief Read-only view of a history log and its block index.
+ *
+ * The log is memory-mapped; the index is loaded from `FILE.idx` and extended
+ * (in memory) by scanning any blocks it does not cover yet.
+ */
+class HistoryLog {
+public:
+    struct Block {
+        uint64_t time_ms;
+        uint64_t offset;
+        uint32_t length;
+        uint8_t kind;
+    };
+
+    /** @brief Map @p path. A missing or empty log is a valid, empty history. */
+    bool open(const std::string &path, std::string &err) {
+        using namespace history_detail;
+        blocks_.clear();
+        indexed_ = 0;
+        valid_end_ = 0;
+        if (!file_.open(path, err)) {
+            if (errno != ENOENT) return false;
+            err.clear();
+            file_.reset();
+            return true;
+        }
+        std::string_view log = file_.data();
+        if (log.empty()) return true;
+        if (log.size() < sizeof(log_magic) || log.substr(0, sizeof(log_magic)) != std::string_view(log_magic, sizeof(log_magic))) {
+            err = path + ": not an os_controlsystem history file";
+            return false;
+        }
+        valid_end_ = sizeof(log_magic);
+        load_index(path + ".idx");
+        scan();
+        return true;
+    }
+
+    const std::vector<Block> &blocks() const { return blocks_; }
+    /** @brief Blocks that `FILE.idx` already covered. */
+    size_t indexed() const { return indexed_; }
+    /** @brief End of the last intact block (0 for an empty log). */
+    uint64_t valid_end() const { return valid_end_; }
+    uint64_t file_size() const { return file_.data().size(); }
+
+    /**
+     * @brief Whether the bytes after valid_end() are a block cut short by a
+     *        crash: its header, or the payload it declares, runs past the end
+     *        of the file. Anything else there is corruption.
+     */
+    bool torn_tail() const {
+        using namespace history_detail;
+        Cursor c{file_.data()};
+        c.pos = valid_end_;
+        uint8_t kind = static_cast<uint8_t>(c.fixed(1));
+        if (c.bad || (kind != BLOCK_KEY && kind != BLOCK_DELTA)) return false;
+        uint64_t len = c.varint();
+        if (c.bad) return c.pos == c.buf.size();
+        c.fixed(4);
+        return c.bad || len > c.buf.size() - c.pos;
+    }
+
+    /** @brief Index of the first block written after @p time_ms. */
+    size_t first_after(uint64_t time_ms) const {
+        return static_cast<size_t>(std::upper_bound(blocks_.begin(), blocks_.end(), time_ms,
+                                                    [](uint64_t t, const Block &b) { return t < b.time_ms; }) -
+                                   blocks_.begin());
+    }
+
+    /** @brief Reconstruct the run stored in block @p i, starting from its key block. */
+    bool state_at(size_t i, HistoryRun &out, std::string &err) const {
+        size_t k = i;
+        while (k > 0 && blocks_[k].kind != history_detail::BLOCK_KEY) --k;
+        out = HistoryRun();
+        for (; k <= i; ++k)
+            if (!apply(k, out, nullptr, err)) return false;
+        return true;
+    }
+
+    /**
+     * @brief Advance @p state (the run of block @p i - 1) to block @p i.
+     * @param flips Receives findings whose status changed; they point into
+     *              @p state.
+     */
+    bool apply(size_t i, HistoryRun &state, std::vector<HistoryFlip> *flips, std::string &err) const {
+        const Block &b = blocks_[i];
+        history_detail::Cursor c{file_.data()};
+        c.pos = b.offset + 1;
+        uint64_t len = c.varint();
+        c.fixed(4);
+        HistoryRun prev = std::move(state);
+        if (c.bad || !history_detail::decode_payload(b.kind, c.buf.substr(c.pos, len), prev, state, flips)) {
+            err = "corrupt history block at offset " + std::to_string(b.offset);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // Accepts the index only as far as it agrees with the log.
+    void load_index(const std::string &idx_path) {
+        using namespace history_detail;
+        MappedFile idx;
+        std::string ignored;
+        if (!idx.open(idx_path, ignored)) return;
+        std::string_view d = idx.data();
+        if (d.size() < sizeof(idx_magic) || d.substr(0, sizeof(idx_magic)) != std::string_view(idx_magic, sizeof(idx_magic))) return;
+        Cursor c{d};
+        c.pos = sizeof(idx_magic);
+        uint64_t end = sizeof(log_magic);
+        uint64_t last_time = 0;
+        while (d.size() - c.pos >= idx_entry_size) {
+            Block b;
+            b.time_ms = c.fixed(8);
+            b.offset = c.fixed(8);
+            b.length = static_cast<uint32_t>(c.fixed(4));
+            b.kind = static_cast<uint8_t>(c.fixed(1));
+            c.fixed(3);
+            if (b.offset != end || b.length > file_.data().size() - end || b.time_ms < last_time ||
+                (b.kind != BLOCK_KEY && b.kind != BLOCK_DELTA) || (blocks_.empty() && b.kind != BLOCK_KEY))
+                break;
+            end += b.length;
+            last_time = b.time_ms;
+            blocks_.push_back(b);
+        }
+        // Re-verify the last indexed block: the log may have been truncated and rewritten.
+        if (!blocks_.empty()) {
+            Block last = blocks_.back();
+            blocks_.pop_back();
+            valid_end_ = last.offset;
+            Block check;
+            uint64_t prev_time = blocks_.empty() ? 0 : blocks_.back().time_ms;
+            if (read_block(last.offset, prev_time, check) && check.length == last.length && check.time_ms == last.time_ms) {
+                blocks_.push_back(last);
+                valid_end_ = last.offset + last.length;
+            } else {
+                blocks_.clear();
+                valid_end_ = sizeof(log_magic);
+            }
+        }
+        indexed_ = blocks_.size();
+    }
+
+    // Indexes intact blocks after the last known one; stops at the first torn or corrupt block.
+    void scan() {
+        Block b;
+        while (valid_end_ < file_.data().size() &&
+               read_block(valid_end_, blocks_.empty() ? 0 : blocks_.back().time_ms, b) &&
+               (!blocks_.empty() || b.kind == history_detail::BLOCK_KEY)) {
+            blocks_.push_back(b);
+            valid_end_ += b.length;
+        }
+    }
+
+    bool read_block(uint64_t offset, uint64_t prev_time, Block &b) const {
+        using namespace history_detail;
+        Cursor c{file_.data()};
+        c.pos = offset;
+        b.offset = offset;
+        b.kind = static_cast<uint8_t>(c.fixed(1));
+        uint64_t len = c.varint();
+        uint32_t sum = static_cast<uint32_t>(c.fixed(4));
+        if (c.bad || (b.kind != BLOCK_KEY && b.kind != BLOCK_DELTA) || len > c.buf.size() - c.pos) return false;
+        std::string_view payload = c.buf.substr(c.pos, len);
+        if (fnv1a(payload) != sum) return false;
+        Cursor p{payload};
+        uint64_t t = p.varint();
+        if (p.bad) return false;
+        b.time_ms = b.kind == BLOCK_KEY ? t : prev_time + static_cast<uint64_t>(unzigzag(t));
+        b.length = static_cast<uint32_t>(c.pos - offset + len);
+        return true;
+    }
+
+    MappedFile file_;
+    std::vector<Block> blocks_;
+    size_t indexed_ = 0;
+    uint64_t valid_end_ = 0;
+};
+
+/**
+ * @brief Append @p run to the history at @p path (sorted and de-duplicated by id).
+ *
+ * Appends are serialised with flock(). A run stamped earlier than the last
+ * block (clock stepped back) is stored with the last block's time so the log
+ * stays ordered.
+ */
+inline bool history_append(const std::string &path, HistoryRun run, std::string &err) {
+    using namespace history_detail;
+    std::stable_sort(run.records.begin(), run.records.end(),
+                     [](const HistoryRecord &a, const HistoryRecord &b) { return a.id < b.id; });
+    run.records.erase(std::unique(run.records.begin(), run.records.end(),
+                                  [](const HistoryRecord &a, const HistoryRecord &b) { return a.id == b.id; }),
+                      run.records.end());
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) { err = path + ": " + std::strerror(errno); return false; }
+    if (flock(fd, LOCK_EX) != 0) { err = path + ": " + std::strerror(errno); close(fd); return false; }
+    auto fail = [&](const std::string &why) { err = path + ": " + why; close(fd); return false; };
+
+    HistoryLog log;
+    if (!log.open(path, err)) { close(fd); return false; }
+    if (log.file_size() > log.valid_end() && !log.torn_tail())
+        return fail("corrupt history block at offset " + std::to_string(log.valid_end()));
+    const auto &blocks = log.blocks();
+    uint64_t end = log.valid_end();
+    std::string frame;
+    if (end == 0) {
+        frame.assign(log_magic, sizeof(log_magic));
+        end = sizeof(log_magic);
+    }
+
+    HistoryRun prev;
+    bool key = blocks.empty();
+    if (!key) {
+        if (!log.state_at(blocks.size() - 1, prev, err)) { close(fd); return false; }
+        run.time_ms = std::max(run.time_ms, prev.time_ms);
+        size_t since_key = 0;
+        for (size_t i = blocks.size(); i-- > 0 && blocks[i].kind != BLOCK_KEY;) ++since_key;
+        key = since_key + 1 >= keyframe_every;
+    }
+    std::string payload = encode_payload(key ? nullptr : &prev, run);
+    size_t header = frame.size();
+    frame += static_cast<char>(key ? BLOCK_KEY : BLOCK_DELTA);
+    put_varint(frame, payload.size());
+    put_fixed(frame, fnv1a(payload), 4);
+    frame += payload;
+
+    // Cut off the block torn by an earlier crash before appending.
+    if (log.file_size() > log.valid_end() && ftruncate(fd, static_cast<off_t>(log.valid_end())) != 0)
+        return fail(std::strerror(errno));
+    uint64_t at = log.valid_end();
+    if (pwrite(fd, frame.data(), frame.size(), static_cast<off_t>(at)) != static_cast<ssize_t>(frame.size()))
+        return fail(std::strerror(errno));
+
+    HistoryLog::Block nb{run.time_ms, end, static_cast<uint32_t>(frame.size() - header), static_cast<uint8_t>(key ? BLOCK_KEY : BLOCK_DELTA)};
+    auto entry = [](std::string &out, const HistoryLog::Block &b) {
+        put_fixed(out, b.time_ms, 8);
+        put_fixed(out, b.offset, 8);
+        put_fixed(out, b.length, 4);
+        put_fixed(out, b.kind, 4);
+    };
+
+    // Extend the index in place when it was current, otherwise rewrite it.
+    std::string idx_path = path + ".idx";
+    std::string idx;
+    bool rewrite = log.indexed() != blocks.size();
+    if (!rewrite) {
+        struct stat st;
+        rewrite = stat(idx_path.c_str(), &st) != 0 ||
+                  static_cast<uint64_t>(st.st_size) != sizeof(idx_magic) + blocks.size() * idx_entry_size;
+    }
+    if (rewrite) {
+        idx.assign(idx_magic, sizeof(idx_magic));
+        for (const auto &b : blocks) entry(idx, b);
+        entry(idx, nb);
+        std::string tmp = idx_path + ".tmp";
+        FILE *f = std::fopen(tmp.c_str(), "wb");
+        bool ok = f && std::fwrite(idx.data(), 1, idx.size(), f) == idx.size();
+        ok = (f && std::fclose(f) == 0) && ok;
+        if (!ok || std::rename(tmp.c_str(), idx_path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return fail(idx_path + ": " + std::strerror(errno));
+        }
+    } else {
+        entry(idx, nb);
+        FILE *f = std::fopen(idx_path.c_str(), "ab");
+        bool ok = f && std::fwrite(idx.data(), 1, idx.size(), f) == idx.size();
+        ok = (f && std::fclose(f) == 0) && ok;
+        if (!ok) return fail(idx_path + ": " + std::strerror(errno));
+    }
+    close(fd);
+    return true;
+#else
+    (void)run;
+    err = path + ": history is not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * @brief Report every status change after @p since_ms.
+ *
+ * The baseline is the last run at or before @p since_ms (or the first run
+ * after it). Findings that first appear later have no earlier status and are
+ * not drift. @p on_flip is called in time order.
+ *
+ * @param runs Number of runs examined after the baseline.
+ */
+template <typename Fn>
+bool history_drift(const HistoryLog &log, uint64_t since_ms, Fn on_flip, size_t &runs, std::string &err) {
+    runs = 0;
+    const auto &blocks = log.blocks();
+    size_t first = log.first_after(since_ms);
+    if (first == blocks.size()) return true;
+    HistoryRun state;
+    size_t i = first;
+    if (!log.state_at(first > 0 ? first - 1 : first, state, err)) return false;
+    if (first == 0) ++i;
+    std::vector<HistoryFlip> flips;
+    for (; i < blocks.size(); ++i) {
+        flips.clear();
+        if (!log.apply(i, state, &flips, err)) return false;
+        ++runs;
+        for (const auto &f : flips) on_flip(f);
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a --since value into unix milliseconds.
+ *
+ * Accepts `@SECONDS`, `YYYY-MM-DD`, `YYYY-MM-DDTHH:MM[:SS]` (local time) and
+ * durations relative to @p now_ms such as `90m`, `12h`, `7d` or `2w`.
+ */
+inline bool history_parse_time(const std::string &s, uint64_t now_ms, uint64_t &out) {
+    if (s.empty()) return false;
+    char *end = nullptr;
+    if (s[0] == '@') {
+        unsigned long long v = std::strtoull(s.c_str() + 1, &end, 10);
+        if (end == s.c_str() + 1 || *end) return false;
+        out = static_cast<uint64_t>(v) * 1000;
+        return true;
+    }
+    unsigned long long n = std::strtoull(s.c_str(), &end, 10);
+    if (end != s.c_str() && end[0] && !end[1]) {
+        uint64_t unit = 0;
+        switch (*end) {
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case 'd': unit = 86400; break;
+        case 'w': unit = 7 * 86400; break;
+        default: break;
+        }
+        if (unit) {
+            uint64_t ago = static_cast<uint64_t>(n) * unit * 1000;
+            out = ago > now_ms ? 0 : now_ms - ago;
+            return true;
+        }
+    }
+    struct tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    int consumed = 0;
+    if (std::sscanf(s.c_str(), "%4d-%2d-%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &consumed) != 3) return false;
+    if (s[consumed] == 'T' || s[consumed] == ' ') {
+        int more = 0;
+        if (std::sscanf(s.c_str() + consumed + 1, "%2d:%2d%n", &tm.tm_hour, &tm.tm_min, &more) != 2) return false;
+        consumed += 1 + more;
+        if (s[consumed] == ':') {
+            if (std::sscanf(s.c_str() + consumed + 1, "%2d%n", &tm.tm_sec, &more) != 1) return false;
+            consumed += 1 + more;
+        }
+    }
+    if (s[consumed]) return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    if (t == static_cast<std::time_t>(-1) || t < 0) return false;
+    out = static_cast<uint64_t>(t) * 1000;
+    return true;
+}
+
+/** @brief @p time_ms as local time, `YYYY-MM-DDTHH:MM:SS`. */
+inline std::string history_format_time(uint64_t time_ms) {
+    std::time_t t = static_cast<std::time_t>(time_ms / 1000);
+    struct tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    return buf;
+}
+
+#endif /* OS_HISTORY_H */
@@ -0,0 +1,67 @@
+#ifndef OS_HOST_H
+#define OS_HOST_H
+
+/**
+ * @file os_host.h
+ * @brief Abstract view of the host state inspected by os_controlsystem checks.
+ *
+ * Checks never touch the system directly; they query a HostSource, which is
+ * either the live machine or a captured snapshot (see os_snapshot.h). This
+ * keeps online and offline audits on exactly the same check code.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "os_sysctl.h"
+#include "os_systemd.h"
+
+/** @brief Exit status and combined stdout/stderr of an inspection command. */
+struct CommandResult {
+    int exit_code = -1;
+    std::string output;
+};
+
+/** @brief A listening socket, e.g. {"tcp", 22}. */
+struct ListeningPort {
+    std::string proto;  /**< "tcp", "tcp6", "udp" or "udp6". */
+    uint16_t port = 0;
+};
+
+class HostSource {
+public:
+    virtual ~HostSource() = default;
+
+    /** @brief Host name used in reports. */
+    virtual std::string name() const = 0;
+
+    /** @brief Values for @p keys, index-aligned with the input. */
+    virtual std::vector<SysctlValue> read_sysctl(const std::vector<std::string> &keys) = 0;
+
+    /**
+     * @brief Contents of an absolute file path on the host.
+     * @return false if the file does not exist (or was not captured).
+     */
+    virtual bool read_file(const std::string &path, std::string &out) = 0;
+
+    /** @brief Entry names of directory @p dir (unordered; empty if absent). */
+    virtual std::vector<std::string> list_dir(const std::string &dir) = 0;
+
+    /**
+     * @brief Resolve unit @p name (e.g. "os_typing.service") with its drop-ins.
+     * @return false if no unit file exists.
+     */
+    virtual bool load_unit(const std::string &name, SystemdUnit &out) { return systemd_load_unit(*this, name, out); }
+
+    /** @brief Whether unit @p name is currently running. */
+    virtual ServiceState service_state(const std::string &name) = 0;
+
+    /** @brief Result of `ufw status verbose`. */
+    virtual CommandResult firewall_status() = 0;
+
+    /** @brief Sockets in LISTEN state (TCP) or bound unconnected (UDP). */
+    virtual std::vector<ListeningPort> listening_ports() = 0;
+};
+
+#endif /* OS_HOST_H */
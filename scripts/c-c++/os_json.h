@@ -0,0 +1,416 @@
+#ifndef OS_JSON_H
+#define OS_JSON_H
+
+/**
+ * @file os_json.h
+ * @brief Single-pass, zero-copy JSON parser for os_controlsystem configs.
+ *
+ * The document is parsed once into a flat array of nodes whose text fields
+ * are std::string_view slices of the input buffer (usually a MappedFile), so
+ * loading is linear in the input size and allocates little beyond the node
+ * array.
+ * Strings containing escape sequences are decoded lazily on first access.
+ *
+ * Supports the full JSON grammar: objects, arrays, strings, numbers,
+ * true/false/null. Errors report a 1-based line and column.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "os_mmap.h"
+
+enum class JsonType : uint8_t { Null, Bool, Number, String, Array, Object };
+
+/** @brief Parse failure with position information. */
+struct JsonError {
+    size_t line = 0;
+    size_t column = 0;
+    std::string message;
+
+    std::string to_string() const {
+        return std::to_string(line) + ":" + std::to_string(column) + ": " + message;
+    }
+};
+
+class JsonDocument;
+
+/**
+ * @brief Lightweight handle to a node of a JsonDocument.
+ *
+ * Object members are stored as a key node (String) immediately followed by
+ * the value node; siblings are linked through `next`, so iteration never
+ * rescans the input.
+ */
+class JsonValue {
+public:
+    JsonValue() = default;
+    JsonValue(const JsonDocument *doc, uint32_t idx) : doc_(doc), idx_(idx) {}
+
+    bool valid() const { return doc_ != nullptr; }
+    JsonType type() const;
+    bool is_object() const { return valid() && type() == JsonType::Object; }
+    bool is_array() const { return valid() && type() == JsonType::Array; }
+    bool is_string() const { return valid() && type() == JsonType::String; }
+    bool is_number() const { return valid() && type() == JsonType::Number; }
+    bool is_bool() const { return valid() && type() == JsonType::Bool; }
+
+    /** @brief Raw token text (numbers, literals) or decoded string contents. */
+    std::string_view str() const;
+    /** @brief Integer value of a Number node; false if not an integer in range. */
+    bool as_int(long long &out) const;
+    bool as_bool() const { return is_bool() && str() == "true"; }
+
+    /** @brief Element/member count of an array/object. */
+    size_t size() const;
+    /** @brief Member lookup on an object; returns an invalid value if absent. */
+    JsonValue find(std::string_view key) const;
+
+    /** @brief First child (array element or object key); invalid when empty. */
+    JsonValue first() const;
+    /** @brief Next sibling; for object members call on the value to get the next key. */
+    JsonValue next() const;
+    /** @brief Value belonging to an object key node. */
+    JsonValue value() const { return valid() ? JsonValue(doc_, idx_ + 1) : JsonValue(); }
+
+    /** @brief Calls fn(key, value) for every member of an object, in document order. */
+    template <typename Fn> void for_each_member(Fn &&fn) const {
+        if (!is_object()) return;
+        for (JsonValue k = first(); k.valid(); k = k.value().next()) fn(k.str(), k.value());
+    }
+    /** @brief Calls fn(element) for every element of an array. */
+    template <typename Fn> void for_each_element(Fn &&fn) const {
+        if (!is_array()) return;
+        for (JsonValue e = first(); e.valid(); e = e.next()) fn(e);
+    }
+
+    /** @brief Error positioned at this value, for semantic checks after parsing. */
+    JsonError error(std::string message) const;
+
+private:
+    const JsonDocument *doc_ = nullptr;
+    uint32_t idx_ = 0;
+};
+
+class JsonDocument {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+    static constexpr int max_depth = 256;
+
+    JsonDocument() = default;
+    JsonDocument(const JsonDocument &) = delete;
+    JsonDocument &operator=(const JsonDocument &) = delete;
+
+    /**
+     * @brief Map @p path and parse it. Files under 1 MiB (every real config)
+     *        are copied instead, so --watch survives an editor truncating them.
+     */
+    bool load_file(const std::string &path, JsonError &err) {
+        std::string ioerr;
+        if (!file_.open(path, ioerr, 1 << 20)) {
+            err = JsonError{0, 0, ioerr};
+            return false;
+        }
+        return parse(file_.data(), err);
+    }
+
+    /** @brief Parse @p text; the buffer must outlive the document. */
+    bool parse(std::string_view text, JsonError &err) {
+        in_ = text;
+        pos_ = 0;
+        nodes_.clear();
+        decoded_.clear();
+        nodes_.reserve(node_bound(text));
+        skip_ws();
+        if (!parse_value(0, err)) return false;
+        skip_ws();
+        if (pos_ != in_.size()) return fail(err, "trailing characters after document");
+        return true;
+    }
+
+    JsonValue root() const { return nodes_.empty() ? JsonValue() : JsonValue(this, 0); }
+
+private:
+    friend class JsonValue;
+
+    struct Node {
+        JsonType type;
+        bool escaped;        // string contains escape sequences
+        uint32_t next;       // next sibling
+        uint32_t count;      // element/member count
+        uint32_t offset;     // source position of the token, for JsonValue::error()
+        std::string_view text;
+    };
+
+    // Every node but the root follows one of , : [ { (the count may include
+    // some inside strings), so this reserves enough without a size guess.
+    static size_t node_bound(std::string_view text) {
+        size_t n = 1;
+        for (char c : text) n += c == ',' || c == ':' || c == '[' || c == '{';
+        return n;
+    }
+
+    bool fail(JsonError &err, const char *msg) const {
+        err.line = 1;
+        err.column = 1;
+        for (size_t i = 0; i < pos_ && i < in_.size(); ++i) {
+            if (in_[i] == '\n') { ++err.line; err.column = 1; }
+            else ++err.column;
+        }
+        err.message = msg;
+        return false;
+    }
+
+    void skip_ws() {
+        while (pos_ < in_.size()) {
+            char c = in_[pos_];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+            ++pos_;
+        }
+    }
+
+    uint32_t push(JsonType t, std::string_view text, bool escaped = false) {
+        // Inputs past 4 GiB keep the last representable position.
+        size_t off = static_cast<size_t>(text.data() - in_.data());
+        nodes_.push_back(Node{t, escaped, npos, 0, static_cast<uint32_t>(off < UINT32_MAX ? off : UINT32_MAX), text});
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+
+    bool parse_value(int depth, JsonError &err) {
+        if (depth > max_depth) return fail(err, "nesting too deep");
+        if (pos_ >= in_.size()) return fail(err, "unexpected end of input");
+        char c = in_[pos_];
+        switch (c) {
+        case '{': return parse_container(depth, err, true);
+        case '[': return parse_container(depth, err, false);
+        case '"': return parse_string(err);
+        case 't': return parse_literal("true", JsonType::Bool, err);
+        case 'f': return parse_literal("false", JsonType::Bool, err);
+        case 'n': return parse_literal("null", JsonType::Null, err);
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) return parse_number(err);
+            return fail(err, "unexpected character");
+        }
+    }
+
+    bool parse_literal(std::string_view word, JsonType t, JsonError &err) {
+        if (in_.substr(pos_, word.size()) != word) return fail(err, "invalid literal");
+        push(t, in_.substr(pos_, word.size()));
+        pos_ += word.size();
+        return true;
+    }
+
+    bool parse_number(JsonError &err) {
+        size_t start = pos_;
+        auto digits = [&] {
+            size_t s = pos_;
+            while (pos_ < in_.size() && in_[pos_] >= '0' && in_[pos_] <= '9') ++pos_;
+            return pos_ > s;
+        };
+        if (in_[pos_] == '-') ++pos_;
+        if (pos_ < in_.size() && in_[pos_] == '0') ++pos_;
+        else if (!digits()) return fail(err, "invalid number");
+        if (pos_ < in_.size() && in_[pos_] == '.') {
+            ++pos_;
+            if (!digits()) return fail(err, "invalid number fraction");
+        }
+        if (pos_ < in_.size() && (in_[pos_] == 'e' || in_[pos_] == 'E')) {
+            ++pos_;
+            if (pos_ < in_.size() && (in_[pos_] == '+' || in_[pos_] == '-')) ++pos_;
+            if (!digits()) return fail(err, "invalid number exponent");
+        }
+        push(JsonType::Number, in_.substr(start, pos_ - start));
+        return true;
+    }
+
+    bool parse_string(JsonError &err) {
+        size_t start = ++pos_;  // skip opening quote
+        bool escaped = false;
+        while (pos_ < in_.size()) {
+            char c = in_[pos_];
+            if (c == '"') {
+                push(JsonType::String, in_.substr(start, pos_ - start), escaped);
+                ++pos_;
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) return fail(err, "control character in string");
+            if (c == '\\') {
+                escaped = true;
+                if (++pos_ >= in_.size()) break;
+                char e = in_[pos_];
+                if (e == 'u') {
+                    for (int k = 0; k < 4; ++k) {
+                        if (++pos_ >= in_.size() || !std::isxdigit(static_cast<unsigned char>(in_[pos_])))
+                            return fail(err, "invalid \\u escape");
+                    }
+                } else if (std::string_view("\"\\/bfnrt").find(e) == std::string_view::npos) {
+                    return fail(err, "invalid escape sequence");
+                }
+            }
+            ++pos_;
+        }
+        return fail(err, "unterminated string");
+    }
+
+    bool parse_container(int depth, JsonError &err, bool is_object) {
+        uint32_t self = push(is_object ? JsonType::Object : JsonType::Array, in_.substr(pos_, 1));
+        char close = is_object ? '}' : ']';
+        ++pos_;
+        skip_ws();
+        if (pos_ < in_.size() && in_[pos_] == close) { ++pos_; return true; }
+        uint32_t prev = npos;
+        uint32_t count = 0;
+        for (;;) {
+            skip_ws();
+            uint32_t child = static_cast<uint32_t>(nodes_.size());
+            if (is_object) {
+                if (pos_ >= in_.size() || in_[pos_] != '"') return fail(err, "expected object key");
+                if (!parse_string(err)) return false;
+                skip_ws();
+                if (pos_ >= in_.size() || in_[pos_] != ':') return fail(err, "expected ':' after key");
+                ++pos_;
+                skip_ws();
+                uint32_t value = static_cast<uint32_t>(nodes_.size());
+                if (!parse_value(depth + 1, err)) return false;
+                // Members chain value -> next key; the key's own `next` is unused.
+                if (prev != npos) nodes_[prev].next = child;
+                prev = value;
+            } else {
+                if (!parse_value(depth + 1, err)) return false;
+                if (prev != npos) nodes_[prev].next = child;
+                prev = child;
+            }
+            ++count;
+            skip_ws();
+            if (pos_ >= in_.size()) return fail(err, "unexpected end of input");
+            if (in_[pos_] == ',') { ++pos_; continue; }
+            if (in_[pos_] == close) { ++pos_; break; }
+            return fail(err, is_object ? "expected ',' or '}'" : "expected ',' or ']'");
+        }
+        nodes_[self].count = count;
+        return true;
+    }
+
+    static void append_utf8(std::string &out, unsigned cp) {
+        if (cp < 0x80) out += static_cast<char>(cp);
+        else if (cp < 0x800) { out += static_cast<char>(0xC0 | (cp >> 6)); out += static_cast<char>(0x80 | (cp & 0x3F)); }
+        else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // Decodes an escaped string once and pins the result for the document's lifetime.
+    std::string_view decode(uint32_t idx) const {
+        std::string_view s = nodes_[idx].text;
+        std::string out;
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] != '\\') { out += s[i]; continue; }
+            char e = s[++i];
+            switch (e) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned cp = static_cast<unsigned>(std::strtoul(std::string(s.substr(i + 1, 4)).c_str(), nullptr, 16));
+                i += 4;
+                if (cp >= 0xD800 && cp < 0xDC00 && s.substr(i + 1, 2) == "\\u") {
+                    unsigned lo = static_cast<unsigned>(std::strtoul(std::string(s.substr(i + 3, 4)).c_str(), nullptr, 16));
+                    if (lo >= 0xDC00 && lo < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        i += 6;
+                    }
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default: out += e; break;  // \" \\ \/
+            }
+        }
+        decoded_.push_back(std::move(out));
+        nodes_[idx].text = decoded_.back();
+        nodes_[idx].escaped = false;
+        return nodes_[idx].text;
+    }
+
+    MappedFile file_;
+    std::string_view in_;
+    size_t pos_ = 0;
+    mutable std::vector<Node> nodes_;
+    mutable std::deque<std::string> decoded_;
+};
+
+inline JsonType JsonValue::type() const { return doc_->nodes_[idx_].type; }
+
+inline std::string_view JsonValue::str() const {
+    if (!valid()) return std::string_view();
+    const auto &n = doc_->nodes_[idx_];
+    return n.escaped ? doc_->decode(idx_) : n.text;
+}
+
+inline bool JsonValue::as_int(long long &out) const {
+    if (!is_number()) return false;
+    std::string_view t = str();
+    if (t.find_first_of(".eE") != std::string_view::npos) return false;
+    errno = 0;
+    std::string tmp(t);
+    out = std::strtoll(tmp.c_str(), nullptr, 10);
+    return errno != ERANGE;
+}
+
+inline size_t JsonValue::size() const {
+    if (!is_object() && !is_array()) return 0;
+    return doc_->nodes_[idx_].count;
+}
+
+inline JsonValue JsonValue::first() const {
+    if (size() == 0) return JsonValue();
+    return JsonValue(doc_, idx_ + 1);
+}
+
+inline JsonValue JsonValue::next() const {
+    if (!valid()) return JsonValue();
+    uint32_t n = doc_->nodes_[idx_].next;
+    return n == JsonDocument::npos ? JsonValue() : JsonValue(doc_, n);
+}
+
+inline JsonValue JsonValue::find(std::string_view key) const {
+    JsonValue found;
+    for_each_member([&](std::string_view k, JsonValue v) { if (k == key) found = v; });
+    return found;
+}
+
+inline JsonError JsonValue::error(std::string message) const {
+    JsonError err{0, 0, std::move(message)};
+    if (!valid()) return err;
+    std::string_view in = doc_->in_;
+    // text may have been replaced by decode(); the offset is the parse position.
+    size_t off = doc_->nodes_[idx_].offset;
+    // Strings start past the opening quote; report the quote itself.
+    if (type() == JsonType::String && off > 0) --off;
+    err.line = 1;
+    err.column = 1;
+    for (size_t i = 0; i < off && i < in.size(); ++i) {
+        if (in[i] == '\n') { ++err.line; err.column = 1; }
+        else ++err.column;
+    }
+    return err;
+}
+
+#endif /* OS_JSON_H */
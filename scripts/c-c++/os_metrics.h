@@ -0,0 +1,192 @@
+#ifndef OS_METRICS_H
+#define OS_METRICS_H
+
+/**
+ * @file os_metrics.h
+ * @brief Process-wide I/O counters and latency histograms for --metrics-out.
+ *
+ * The I/O paths (sysctl reads, file reads, spawned commands) bump relaxed
+ * atomic counters unconditionally; they cost a few nanoseconds. Latency is
+ * only measured while metrics are enabled, so runs without --metrics-out do
+ * not read the clock at all. metrics_write_textfile() renders everything in
+ * the Prometheus text format for node_exporter's textfile collector.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/** @brief What a latency observation measured. */
+enum class MetricPhase { Config, SysctlRead, Sysctl, Service, ServiceExec, Firewall, Count };
+
+inline const char *metric_phase_name(MetricPhase p) {
+    static const char *const names[] = {"config", "sysctl_read", "sysctl", "service", "service_exec", "firewall"};
+    return p < MetricPhase::Count ? names[static_cast<int>(p)] : "other";
+}
+
+/** @brief Phase for a planned check name ("sysctl", "service", "service:exec", "firewall"). */
+inline MetricPhase metric_phase_for_check(std::string_view check) {
+    if (check == "sysctl") return MetricPhase::Sysctl;
+    if (check == "service") return MetricPhase::Service;
+    if (check == "service:exec") return MetricPhase::ServiceExec;
+    if (check == "firewall") return MetricPhase::Firewall;
+    return MetricPhase::Count;
+}
+
+/** @brief Fixed-bucket histogram; observe() is lock-free and may be called from any thread. */
+class LatencyHistogram {
+public:
+    static constexpr size_t bucket_count = 16;
+    /** @brief Upper bounds in seconds (10 us .. 10 s); a final +Inf bucket is implied. */
+    static constexpr double bounds[bucket_count] = {0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005,
+                                                    0.001,   0.0025,   0.005,   0.01,   0.025,   0.05,
+                                                    0.1,     0.5,      1,       10};
+
+    void observe(double seconds) {
+        size_t b = 0;
+        while (b < bucket_count && seconds > bounds[b]) ++b;
+        counts_[b].fetch_add(1, std::memory_order_relaxed);
+        sum_ns_.fetch_add(static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+    }
+
+    /** @brief Observations in bucket @p b (non-cumulative; @p b == bucket_count is +Inf). */
+    uint64_t count(size_t b) const { return counts_[b].load(std::memory_order_relaxed); }
+    double sum_seconds() const { return static_cast<double>(sum_ns_.load(std::memory_order_relaxed)) / 1e9; }
+
+private:
+    std::atomic<uint64_t> counts_[bucket_count + 1] = {};
+    std::atomic<uint64_t> sum_ns_{0};
+};
+
+/** @brief Everything --metrics-out reports besides the per-check status. */
+struct RunMetrics {
+    std::atomic<bool> enabled{false};
+    LatencyHistogram phases[static_cast<int>(MetricPhase::Count)];
+    std::atomic<uint64_t> subprocesses{0};
+    std::atomic<uint64_t> bytes_read{0};
+};
+
+inline RunMetrics g_metrics;
+
+inline bool metrics_enabled() { return g_metrics.enabled.load(std::memory_order_relaxed); }
+inline void metrics_count_read(size_t bytes) { g_metrics.bytes_read.fetch_add(bytes, std::memory_order_relaxed); }
+inline void metrics_count_spawn() { g_metrics.subprocesses.fetch_add(1, std::memory_order_relaxed); }
+
+inline void metrics_observe(MetricPhase p, double seconds) {
+    if (p < MetricPhase::Count) g_metrics.phases[static_cast<int>(p)].observe(seconds);
+}
+
+/** @brief Adds the lifetime of the scope to @p phase while metrics are enabled. */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(MetricPhase phase) : phase_(phase), on_(metrics_enabled()) {
+        if (on_) start_ = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (on_) metrics_observe(phase_, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    MetricPhase phase_;
+    bool on_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+namespace metrics_detail {
+
+inline void label_value(std::string &out, std::string_view v) {
+    for (char c : v) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '"') out += "\\\"";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+}
+
+inline void number(std::string &out, const char *fmt, double v) {
+    char buf[40];
+    int n = std::snprintf(buf, sizeof(buf), fmt, v);
+    if (n > 0) out.append(buf, static_cast<size_t>(n));
+}
+
+} // namespace metrics_detail
+
+/**
+ * @brief Render all metrics in the Prometheus text exposition format.
+ * @param statuses Finding id and pass/fail of the latest result of every check.
+ */
+inline std::string metrics_render(const std::vector<std::pair<std::string, bool>> &statuses, int exit_code,
+                                  double timestamp) {
+    using namespace metrics_detail;
+    std::string out;
+    out += "# HELP os_controlsystem_check_status Latest result of each check finding (1 = pass, 0 = fail).\n"
+           "# TYPE os_controlsystem_check_status gauge\n";
+    for (const auto &s : statuses) {
+        out += "os_controlsystem_check_status{check=\"";
+        label_value(out, s.first);
+        out += s.second ? "\"} 1\n" : "\"} 0\n";
+    }
+
+    out += "# HELP os_controlsystem_check_duration_seconds Latency of config load, each sysctl read and each check.\n"
+           "# TYPE os_controlsystem_check_duration_seconds histogram\n";
+    for (int p = 0; p < static_cast<int>(MetricPhase::Count); ++p) {
+        const LatencyHistogram &h = g_metrics.phases[p];
+        std::string prefix = std::string("os_controlsystem_check_duration_seconds_bucket{category=\"") +
+                             metric_phase_name(static_cast<MetricPhase>(p)) + "\",le=\"";
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= LatencyHistogram::bucket_count; ++b) {
+            cumulative += h.count(b);
+            out += prefix;
+            if (b < LatencyHistogram::bucket_count) number(out, "%g", LatencyHistogram::bounds[b]);
+            else out += "+Inf";
+            out += "\"} " + std::to_string(cumulative) + "\n";
+        }
+        std::string labels = std::string("{category=\"") + metric_phase_name(static_cast<MetricPhase>(p)) + "\"} ";
+        out += "os_controlsystem_check_duration_seconds_sum" + labels;
+        number(out, "%.9f", h.sum_seconds());
+        out += "\nos_controlsystem_check_duration_seconds_count" + labels + std::to_string(cumulative) + "\n";
+    }
+
+    out += "# HELP os_controlsystem_subprocesses_total Processes spawned by the checks.\n"
+           "# TYPE os_controlsystem_subprocesses_total counter\n"
+           "os_controlsystem_subprocesses_total " + std::to_string(g_metrics.subprocesses.load()) + "\n"
+           "# HELP os_controlsystem_read_bytes_total Bytes read from sysctl, unit, rule and command output.\n"
+           "# TYPE os_controlsystem_read_bytes_total counter\n"
+           "os_controlsystem_read_bytes_total " + std::to_string(g_metrics.bytes_read.load()) + "\n"
+           "# HELP os_controlsystem_exit_code Exit code of the latest run (bit mask, 0 = all passed).\n"
+           "# TYPE os_controlsystem_exit_code gauge\n"
+           "os_controlsystem_exit_code " + std::to_string(exit_code) + "\n"
+           "# HELP os_controlsystem_last_run_timestamp_seconds Time the latest results were written.\n"
+           "# TYPE os_controlsystem_last_run_timestamp_seconds gauge\n"
+           "os_controlsystem_last_run_timestamp_seconds ";
+    number(out, "%.3f", timestamp);
+    out += "\n";
+    return out;
+}
+
+/** @brief Write @p text to @p path via a temporary file and rename(), so scrapers never see a partial file. */
+inline bool metrics_write_textfile(const std::string &path, const std::string &text, std::string &err) {
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) { err = tmp + ": " + std::strerror(errno); return false; }
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        err = path + ": " + std::strerror(errno);
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif /* OS_METRICS_H */
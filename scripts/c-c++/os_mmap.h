@@ -0,0 +1,117 @@
+#ifndef OS_MMAP_H
+#define OS_MMAP_H
+
+/**
+ * @file os_mmap.h
+ * @brief Read-only memory-mapped file.
+ *
+ * Maps a whole file with mmap() on POSIX systems; elsewhere (or for files
+ * that cannot be mapped, such as pipes) the contents are read into an owned
+ * buffer instead, so callers always get a contiguous std::string_view.
+ *
+ * A mapping faults (SIGBUS) if the file is truncated while it is in use, as
+ * editors do when saving in place; callers that re-read files others edit
+ * pass `read_below` to get small files copied instead.
+ */
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <iterator>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { reset(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&o) noexcept { *this = std::move(o); }
+    MappedFile &operator=(MappedFile &&o) noexcept {
+        if (this != &o) {
+            reset();
+            map_ = o.map_; size_ = o.size_; owned_ = std::move(o.owned_);
+            o.map_ = nullptr; o.size_ = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Map @p path.
+     * @param err Filled with a readable reason on failure.
+     * @param read_below Regular files smaller than this are read into an
+     *                   owned buffer instead of being mapped.
+     * @return false if the file cannot be opened or read.
+     */
+    bool open(const std::string &path, std::string &err, size_t read_below = 0) {
+        reset();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { err = path + ": " + std::strerror(errno); return false; }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && static_cast<size_t>(st.st_size) < read_below) {
+            // A file truncated meanwhile just reads short.
+            owned_.resize(static_cast<size_t>(st.st_size));
+            size_t got = 0;
+            while (got < owned_.size()) {
+                ssize_t n = pread(fd, &owned_[got], owned_.size() - got, static_cast<off_t>(got));
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) { err = path + ": " + std::strerror(errno); close(fd); owned_.clear(); return false; }
+                if (n == 0) break;
+                got += static_cast<size_t>(n);
+            }
+            owned_.resize(got);
+            close(fd);
+            return true;
+        }
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ > 0) {
+                void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    map_ = p;
+                    close(fd);
+                    return true;
+                }
+            }
+            size_ = 0;
+            if (st.st_size == 0) { close(fd); return true; }
+        }
+        close(fd);
+#endif
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) { err = path + ": " + std::strerror(errno); return false; }
+        owned_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    std::string_view data() const {
+        if (map_) return std::string_view(static_cast<const char *>(map_), size_);
+        return owned_;
+    }
+
+    void reset() {
+#ifndef _WIN32
+        if (map_) munmap(map_, size_);
+#endif
+        map_ = nullptr;
+        size_ = 0;
+        owned_.clear();
+    }
+
+private:
+    void *map_ = nullptr;
+    size_t size_ = 0;
+    std::string owned_;
+};
+
+#endif /* OS_MMAP_H */
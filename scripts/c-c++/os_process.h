@@ -0,0 +1,356 @@
+#ifndef OS_PROCESS_H
+#define OS_PROCESS_H
+
+/**
+ * @file os_process.h
+ * @brief Bounded-time subprocess runner (posix_spawn + epoll, no shell).
+ *
+ * Commands are argv vectors started with posix_spawnp(), so there is no
+ * /bin/sh in between and no quoting to get wrong. Each child gets its own
+ * process group and non-blocking stdout/stderr pipes; process_run_all()
+ * multiplexes the pipes of all children with one epoll set and collects
+ * output into growable buffers. A child that outlives its deadline gets
+ * SIGTERM on its whole process group, then SIGKILL after a grace period,
+ * so the wall-clock cost of a command is bounded by timeout + kill_grace.
+ *
+ * Linux uses the engine above; other platforms fall back to popen() with
+ * the same interface but without deadlines.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "os_metrics.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#elif !defined(_WIN32)
+#include <sys/wait.h>
+#endif
+
+/** @brief A command to run. */
+struct ProcessSpec {
+    std::vector<std::string> argv;  /**< argv[0] is looked up in PATH. */
+    std::chrono::milliseconds timeout{10000};   /**< 0 = no deadline. */
+    std::chrono::milliseconds kill_grace{1000};  /**< SIGTERM -> SIGKILL delay. */
+    bool merge_stderr = false;  /**< Send stderr to ProcessResult::out (like `2>&1`). */
+    size_t max_output = 16u << 20;  /**< Per-stream cap; the rest is read and dropped. */
+};
+
+enum class ProcessStatus {
+    Exited,      /**< Exited on its own; see exit_code. */
+    Signaled,    /**< Killed by a signal it did not get from us; see signal. */
+    TimedOut,    /**< Deadline passed and we terminated it; see signal/exit_code. */
+    SpawnFailed  /**< Never ran; see error. */
+};
+
+/** @brief How a command ended and what it printed. */
+struct ProcessResult {
+    ProcessStatus status = ProcessStatus::SpawnFailed;
+    int exit_code = -1;  /**< Exit status if the child exited normally, else -1. */
+    int signal = 0;      /**< Terminating signal, 0 if it exited normally. */
+    int error = 0;       /**< errno of the failed spawn. */
+    std::string out;
+    std::string err;
+    bool truncated = false;  /**< Output exceeded ProcessSpec::max_output. */
+    std::chrono::microseconds elapsed{0};
+
+    bool ok() const { return status == ProcessStatus::Exited && exit_code == 0; }
+
+    /** @brief e.g. "exited with status 1", "killed by signal 9", "timed out after 10000 ms". */
+    std::string describe(const ProcessSpec &spec) const {
+        switch (status) {
+        case ProcessStatus::Exited: return "exited with status " + std::to_string(exit_code);
+        case ProcessStatus::Signaled: return "killed by signal " + std::to_string(signal);
+        case ProcessStatus::TimedOut: return "timed out after " + std::to_string(spec.timeout.count()) + " ms";
+        case ProcessStatus::SpawnFailed: break;
+        }
+        return std::string("cannot run: ") + std::strerror(error);
+    }
+};
+
+#ifdef __linux__
+
+namespace process_detail {
+
+using Clock = std::chrono::steady_clock;
+
+struct Child {
+    const ProcessSpec *spec = nullptr;
+    ProcessResult *res = nullptr;
+    pid_t pid = -1;
+    int fd[2] = {-1, -1};  // stdout, stderr
+    int pidfd = -1;
+    bool reaped = false;
+    int stage = 0;  // 0 = running, 1 = SIGTERM sent, 2 = SIGKILL sent, 3 = abandoned
+    Clock::time_point start, deadline, kill_at;
+};
+
+inline void close_stream(int ep, int &fd) {
+    if (fd < 0) return;
+    epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    fd = -1;
+}
+
+// Read everything currently available on stream @p s; closes it on EOF or error.
+inline void drain(int ep, Child &c, int s) {
+    char buf[65536];
+    std::string &dst = s == 0 ? c.res->out : c.res->err;
+    for (;;) {
+        ssize_t n = read(c.fd[s], buf, sizeof(buf));
+        if (n > 0) {
+            metrics_count_read(static_cast<size_t>(n));
+            size_t room = c.spec->max_output > dst.size() ? c.spec->max_output - dst.size() : 0;
+            if (static_cast<size_t>(n) > room) c.res->truncated = true;
+            dst.append(buf, std::min(room, static_cast<size_t>(n)));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        close_stream(ep, c.fd[s]);
+        return;
+    }
+}
+
+inline int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+inline bool spawn(int ep, size_t index, Child &c) {
+    ProcessResult &r = *c.res;
+    c.start = Clock::now();
+    if (c.spec->argv.empty()) { r.error = EINVAL; return false; }
+
+    int pipes[2][2] = {{-1, -1}, {-1, -1}};
+    int streams = c.spec->merge_stderr ? 1 : 2;
+    for (int s = 0; s < streams; ++s) {
+        // Only our end is non-blocking; the child gets an ordinary blocking stdout.
+        if (pipe2(pipes[s], O_CLOEXEC) != 0 || fcntl(pipes[s][0], F_SETFL, O_NONBLOCK) != 0) {
+            r.error = errno;
+            for (auto &p : pipes) for (int fd : p) if (fd >= 0) close(fd);
+            return false;
+        }
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, pipes[0][1], 1);
+    posix_spawn_file_actions_adddup2(&fa, pipes[streams - 1][1], 2);
+
+    // Own process group so a deadline kills helpers the command started too;
+    // reset the signal state inherited from watch mode.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t none, all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &all);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<char *> argv;
+    for (const auto &a : c.spec->argv) argv.push_back(const_cast<char *>(a.c_str()));
+    argv.push_back(nullptr);
+    int rc = posix_spawnp(&c.pid, argv[0], &fa, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+
+    for (int s = 0; s < streams; ++s) close(pipes[s][1]);
+    if (rc != 0) {
+        r.error = rc;
+        for (int s = 0; s < streams; ++s) close(pipes[s][0]);
+        return false;
+    }
+    metrics_count_spawn();
+
+    for (int s = 0; s < streams; ++s) {
+        c.fd[s] = pipes[s][0];
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = index << 2 | static_cast<uint64_t>(s);
+        epoll_ctl(ep, EPOLL_CTL_ADD, c.fd[s], &ev);
+    }
+    c.pidfd = open_pidfd(c.pid);
+    if (c.pidfd >= 0) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = index << 2 | 2;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, c.pidfd, &ev) != 0) { close(c.pidfd); c.pidfd = -1; }
+    }
+    c.deadline = c.spec->timeout.count() > 0 ? c.start + c.spec->timeout : Clock::time_point::max();
+    return true;
+}
+
+// Reap @p c if it has exited; returns true once it has.
+inline bool try_reap(int ep, Child &c) {
+    int status = 0;
+    pid_t w = -2;  // abandoned: SIGKILL did not take (uninterruptible sleep)
+    if (c.stage < 3) {
+        do w = waitpid(c.pid, &status, WNOHANG);
+        while (w < 0 && errno == EINTR);
+        if (w == 0) return false;
+    }
+
+    ProcessResult &r = *c.res;
+    if (w < 0) {
+        r.status = ProcessStatus::SpawnFailed;
+        r.error = errno;
+    } else if (w == -2) {
+        r.status = ProcessStatus::TimedOut;
+        r.signal = SIGKILL;
+    } else if (WIFEXITED(status)) {
+        r.exit_code = WEXITSTATUS(status);
+        r.status = c.stage ? ProcessStatus::TimedOut : ProcessStatus::Exited;
+    } else {
+        r.signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+        r.status = c.stage ? ProcessStatus::TimedOut : ProcessStatus::Signaled;
+    }
+    // Whatever is buffered now is all we take: a grandchild that escaped the
+    // process group may keep the pipe open forever.
+    for (int s = 0; s < 2; ++s) {
+        if (c.fd[s] >= 0) drain(ep, c, s);
+        close_stream(ep, c.fd[s]);
+    }
+    close_stream(ep, c.pidfd);
+    c.reaped = true;
+    r.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - c.start);
+    return true;
+}
+
+} // namespace process_detail
+
+/**
+ * @brief Run all @p specs concurrently and wait until every one has ended.
+ * @return One result per spec, in the same order. Never blocks longer than the
+ *         largest timeout + kill_grace (plus the time to drain output).
+ */
+inline std::vector<ProcessResult> process_run_all(const std::vector<ProcessSpec> &specs) {
+    using namespace process_detail;
+    std::vector<ProcessResult> results(specs.size());
+    std::vector<Child> children(specs.size());
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) {
+        for (auto &r : results) r.error = errno;
+        return results;
+    }
+
+    size_t running = 0;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        children[i].spec = &specs[i];
+        children[i].res = &results[i];
+        if (spawn(ep, i, children[i])) ++running;
+        else children[i].reaped = true;
+    }
+
+    epoll_event events[32];
+    while (running > 0) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point wake = Clock::time_point::max();
+        bool tick = false;
+        for (auto &c : children) {
+            if (c.reaped) continue;
+            if (try_reap(ep, c)) { --running; continue; }
+            if (c.stage == 0 && now >= c.deadline) {
+                kill(-c.pid, SIGTERM);
+                c.stage = 1;
+                c.kill_at = now + c.spec->kill_grace;
+            }
+            if (c.stage == 1 && now >= c.kill_at) {
+                kill(-c.pid, SIGKILL);
+                c.stage = 2;
+                c.kill_at = now + c.spec->kill_grace;
+            }
+            if (c.stage == 2 && now >= c.kill_at) {
+                c.stage = 3;
+                try_reap(ep, c);
+                --running;
+                continue;
+            }
+            wake = std::min(wake, c.stage == 0 ? c.deadline : c.kill_at);
+            // Without a pidfd, exit is only noticed by polling once the pipes are gone.
+            if (c.pidfd < 0 && c.fd[0] < 0 && c.fd[1] < 0) tick = true;
+        }
+        if (running == 0) break;
+
+        int timeout_ms = -1;
+        if (wake != Clock::time_point::max())
+            timeout_ms = static_cast<int>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count() + 1);
+        if (tick && (timeout_ms < 0 || timeout_ms > 5)) timeout_ms = 5;
+
+        int n = epoll_wait(ep, events, 32, timeout_ms);
+        for (int e = 0; e < n; ++e) {
+            Child &c = children[events[e].data.u64 >> 2];
+            int s = static_cast<int>(events[e].data.u64 & 3);
+            if (s < 2 && c.fd[s] >= 0) drain(ep, c, s);
+        }
+    }
+    close(ep);
+    return results;
+}
+
+#else
+
+inline std::vector<ProcessResult> process_run_all(const std::vector<ProcessSpec> &specs) {
+    std::vector<ProcessResult> results(specs.size());
+    for (size_t i = 0; i < specs.size(); ++i) {
+        ProcessResult &r = results[i];
+        auto start = std::chrono::steady_clock::now();
+        if (specs[i].argv.empty()) { r.error = EINVAL; continue; }
+        std::string cmd;
+        for (const auto &a : specs[i].argv) cmd += (cmd.empty() ? "\"" : " \"") + a + "\"";
+        if (specs[i].merge_stderr) cmd += " 2>&1";
+#ifdef _WIN32
+        FILE *pipe = _popen(cmd.c_str(), "r");
+#else
+        FILE *pipe = popen(cmd.c_str(), "r");
+#endif
+        if (!pipe) { r.error = errno; continue; }
+        metrics_count_spawn();
+        char buf[4096];
+        size_t n;
+        while ((n = std::fread(buf, 1, sizeof(buf), pipe)) > 0) {
+            metrics_count_read(n);
+            r.out.append(buf, n);
+        }
+#ifdef _WIN32
+        r.exit_code = _pclose(pipe);
+#else
+        int rc = pclose(pipe);
+        r.exit_code = WIFEXITED(rc) ? WEXITSTATUS(rc) : -1;
+#endif
+        r.status = ProcessStatus::Exited;
+        r.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
+    return results;
+}
+
+#endif /* __linux__ */
+
+/** @brief Run a single command; see process_run_all(). */
+inline ProcessResult process_run(const ProcessSpec &spec) {
+    return std::move(process_run_all({spec}).front());
+}
+
+#endif /* OS_PROCESS_H */
@@ -0,0 +1,259 @@
+#ifndef OS_REMEDIATE_H
+#define OS_REMEDIATE_H
+
+/**
+ * @file os_remediate.h
+ * @brief Transactional sysctl writes for `os_controlsystem --remediate`.
+ *
+ * sysctl_apply() writes a batch of keys straight to /proc/sys (or any other
+ * root given with --proc-root). The previous values go to an undo journal
+ * before the first write; if a write fails or a read-back does not verify,
+ * every key written so far is restored and the batch is reported as rolled
+ * back. A kept journal can be replayed later with sysctl_undo().
+ *
+ * Journal format: one change per line, `key<TAB>before<TAB>after`, with tab,
+ * newline and backslash escaped as `\t`, `\n` and `\\`.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "os_sysctl.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/** @brief One key and the values before and after remediation. */
+struct SysctlChange {
+    std::string key;
+    std::string before;
+    std::string after;
+};
+
+/** @brief What happened to a batch. */
+struct SysctlApplyResult {
+    std::vector<SysctlChange> applied;  /**< Committed changes (empty after a rollback). */
+    std::string error;                  /**< Why the batch was rolled back; empty on success. */
+    bool rolled_back = false;
+    std::vector<std::string> rollback_errors;  /**< Keys that could not be restored, with reason. */
+
+    bool ok() const { return error.empty(); }
+};
+
+namespace remediate_detail {
+
+inline void escape(std::string &out, std::string_view v) {
+    for (char c : v) {
+        if (c == '\t') out += "\\t";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\\') out += "\\\\";
+        else out += c;
+    }
+}
+
+inline std::string unescape(std::string_view v) {
+    std::string out;
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i] != '\\' || i + 1 == v.size()) { out += v[i]; continue; }
+        char c = v[++i];
+        out += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+    }
+    return out;
+}
+
+// Whitespace-insensitive comparison: the kernel prints tuples tab-separated.
+inline bool same_value(std::string_view a, std::string_view b) {
+    auto next_word = [](std::string_view &s) {
+        auto space = [](char c) { return c == ' ' || c == '\t' || c == '\n'; };
+        size_t i = 0;
+        while (i < s.size() && space(s[i])) ++i;
+        size_t j = i;
+        while (j < s.size() && !space(s[j])) ++j;
+        std::string_view w = s.substr(i, j - i);
+        s.remove_prefix(j);
+        return w;
+    };
+    for (;;) {
+        std::string_view x = next_word(a), y = next_word(b);
+        if (x != y) return false;
+        if (x.empty()) return true;
+    }
+}
+
+/**
+ * @brief Write @p value to @p key below @p root; returns 0 or an errno.
+ * @param touched Set if the key was opened, i.e. a failed write may have changed it.
+ */
+inline int write_key(const std::string &root, const std::string &key, const std::string &value,
+                     bool *touched = nullptr) {
+#ifdef _WIN32
+    (void)root; (void)key; (void)value; (void)touched;
+    return ENOSYS;
+#else
+    std::string path = root + "/" + sysctl_key_to_path(key);
+    // O_TRUNC is a no-op on /proc/sys but makes scratch directories behave the same.
+    int fd = open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0) return errno;
+    if (touched) *touched = true;
+    // /proc/sys takes the whole value in a single write.
+    std::string line = value + "\n";
+    ssize_t n;
+    do n = write(fd, line.data(), line.size());
+    while (n < 0 && errno == EINTR);
+    int e = n < 0 ? errno : static_cast<size_t>(n) != line.size() ? EIO : 0;
+    if (close(fd) != 0 && e == 0) e = errno;
+    return e;
+#endif
+}
+
+} // namespace remediate_detail
+
+/** @brief Write @p changes to @p path (temporary file, fsync, rename). */
+inline bool sysctl_journal_write(const std::string &path, const std::vector<SysctlChange> &changes, std::string &err) {
+    std::string text;
+    for (const auto &c : changes) {
+        remediate_detail::escape(text, c.key);
+        text += '\t';
+        remediate_detail::escape(text, c.before);
+        text += '\t';
+        remediate_detail::escape(text, c.after);
+        text += '\n';
+    }
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) { err = tmp + ": " + std::strerror(errno); return false; }
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size() && std::fflush(f) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        err = path + ": " + std::strerror(errno);
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** @brief Load a journal written by sysctl_journal_write(). */
+inline bool sysctl_journal_read(const std::string &path, std::vector<SysctlChange> &changes, std::string &err) {
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) { err = path + ": " + std::strerror(errno); return false; }
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+    std::fclose(f);
+
+    changes.clear();
+    size_t line_no = 0, pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string_view line(text.data() + pos, end - pos);
+        pos = end + 1;
+        ++line_no;
+        if (line.empty()) continue;
+        size_t t1 = line.find('\t');
+        size_t t2 = t1 == std::string_view::npos ? t1 : line.find('\t', t1 + 1);
+        if (t2 == std::string_view::npos) {
+            err = path + ":" + std::to_string(line_no) + ": expected key, before and after separated by tabs";
+            return false;
+        }
+        changes.push_back(SysctlChange{remediate_detail::unescape(line.substr(0, t1)),
+                                       remediate_detail::unescape(line.substr(t1 + 1, t2 - t1 - 1)),
+                                       remediate_detail::unescape(line.substr(t2 + 1))});
+    }
+    return true;
+}
+
+namespace remediate_detail {
+
+// Write c.before back for changes[0..count) in reverse order and verify each.
+inline void restore(const std::string &root, const std::vector<SysctlChange> &changes, size_t count,
+                    std::vector<std::string> &errors) {
+    SysctlReader reader(root);
+    while (count-- > 0) {
+        const SysctlChange &c = changes[count];
+        if (int e = write_key(root, c.key, c.before)) {
+            errors.push_back(c.key + ": " + std::strerror(e));
+            continue;
+        }
+        SysctlValue v = reader.read(c.key);
+        if (v.status != SysctlStatus::Ok || !same_value(v.value, c.before))
+            errors.push_back(c.key + ": reads back as '" + v.value + "' instead of '" + c.before + "'");
+    }
+}
+
+} // namespace remediate_detail
+
+/**
+ * @brief Apply @p changes as one batch.
+ * @param verify Called as verify(index, value_read_back) after all writes; false rolls the batch back.
+ * @param journal Undo journal path, written before the first write ("" = keep it in memory only).
+ *                Removed again after a successful rollback.
+ */
+template <typename Verify>
+SysctlApplyResult sysctl_apply(const std::string &root, const std::vector<SysctlChange> &changes, Verify verify,
+                               const std::string &journal = std::string()) {
+    SysctlApplyResult res;
+    if (changes.empty()) return res;
+    if (!journal.empty() && !sysctl_journal_write(journal, changes, res.error)) {
+        res.error = "undo journal " + res.error;
+        return res;
+    }
+
+    size_t written = 0;
+    for (; written < changes.size(); ++written) {
+        const SysctlChange &c = changes[written];
+        bool touched = false;
+        if (int e = remediate_detail::write_key(root, c.key, c.after, &touched)) {
+            res.error = c.key + ": write failed: " + std::strerror(e);
+            if (touched) ++written;  // multi-field keys may have been partially applied
+            break;
+        }
+    }
+    if (res.ok()) {
+        SysctlReader reader(root);
+        for (size_t i = 0; i < changes.size() && res.ok(); ++i) {
+            SysctlValue v = reader.read(changes[i].key);
+            if (v.status != SysctlStatus::Ok)
+                res.error = changes[i].key + ": verification read failed: " + sysctl_status_name(v.status);
+            else if (!verify(i, v.value))
+                res.error = changes[i].key + ": reads back as '" + v.value + "' after writing '" + changes[i].after + "'";
+        }
+    }
+    if (res.ok()) {
+        res.applied = changes;
+        return res;
+    }
+
+    remediate_detail::restore(root, changes, written, res.rollback_errors);
+    res.rolled_back = true;
+    if (!journal.empty() && res.rollback_errors.empty()) std::remove(journal.c_str());
+    return res;
+}
+
+/**
+ * @brief Restore the "before" values recorded in @p journal (undo an earlier --remediate).
+ * @param errors Keys that could not be restored, with reason.
+ * @return Number of keys restored.
+ */
+inline size_t sysctl_undo(const std::string &root, const std::string &journal, std::vector<std::string> &errors) {
+    std::vector<SysctlChange> changes;
+    std::string err;
+    if (!sysctl_journal_read(journal, changes, err)) {
+        errors.push_back(err);
+        return 0;
+    }
+    remediate_detail::restore(root, changes, changes.size(), errors);
+    return changes.size() - errors.size();
+}
+
+#endif /* OS_REMEDIATE_H */
@@ -0,0 +1,314 @@
+#ifndef OS_REPORT_H
+#define OS_REPORT_H
+
+/**
+ * @file os_report.h
+ * @brief Result reporters for os_controlsystem: text, JSON lines and JUnit XML.
+ *
+ * CI used to scrape the human-readable output with a Python script; the
+ * structured formats are now produced directly. Records are appended to a
+ * ReportWriter as each check completes and reach the output in large writes,
+ * so hundreds of hosts x thousands of keys do not turn into one syscall per
+ * line.
+ *
+ * - text:  the classic `[sysctl:key] OK` lines (unchanged).
+ * - jsonl: one object per finding, then one per host and a final summary.
+ * - junit: `<testsuites>` with one `<testsuite>` per check and host, each
+ *          written complete (with exact counts) the moment the check ends.
+ */
+
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** @brief One finding as handed to a reporter. */
+struct ReportFinding {
+    std::string_view id;    /**< e.g. "sysctl:fs.file-max" */
+    bool ok;
+    std::string_view text;  /**< Human-readable line, as printed in text mode. */
+};
+
+/** @brief Append-only output buffer flushed in large writes. */
+class ReportWriter {
+public:
+    explicit ReportWriter(std::FILE *out = stdout, size_t capacity = 64 * 1024) : out_(out), capacity_(capacity) {
+        buf_.reserve(capacity_);
+    }
+    ~ReportWriter() { flush(); }
+
+    ReportWriter(const ReportWriter &) = delete;
+    ReportWriter &operator=(const ReportWriter &) = delete;
+
+    void write(std::string_view s) {
+        buf_.append(s.data(), s.size());
+        if (buf_.size() >= capacity_) flush();
+    }
+    void put(char c) {
+        buf_.push_back(c);
+        if (buf_.size() >= capacity_) flush();
+    }
+
+    void flush() {
+        if (!buf_.empty()) std::fwrite(buf_.data(), 1, buf_.size(), out_);
+        buf_.clear();
+        std::fflush(out_);
+    }
+
+    /** @brief Append @p s as the body of a JSON string (no quotes). */
+    void json_escaped(std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        for (char c : s) {
+            unsigned char u = static_cast<unsigned char>(c);
+            switch (c) {
+            case '"': write("\\\""); break;
+            case '\\': write("\\\\"); break;
+            case '\n': write("\\n"); break;
+            case '\r': write("\\r"); break;
+            case '\t': write("\\t"); break;
+            default:
+                if (u < 0x20) {
+                    write("\\u00");
+                    put(hex[u >> 4]);
+                    put(hex[u & 15]);
+                } else {
+                    put(c);
+                }
+            }
+        }
+    }
+
+    /** @brief Append @p s escaped for XML text or attribute values. */
+    void xml_escaped(std::string_view s) {
+        for (char c : s) {
+            unsigned char u = static_cast<unsigned char>(c);
+            switch (c) {
+            case '<': write("&lt;"); break;
+            case '>': write("&gt;"); break;
+            case '&': write("&amp;"); break;
+            case '"': write("&quot;"); break;
+            case '\n': write("&#10;"); break;
+            default:
+                // Other control characters cannot appear in XML 1.0, even escaped.
+                put(u < 0x20 && c != '\t' && c != '\r' ? '?' : c);
+            }
+        }
+    }
+
+    void number(double v) {
+        char tmp[32];
+        int n = std::snprintf(tmp, sizeof(tmp), "%.6f", v);
+        if (n > 0) buf_.append(tmp, static_cast<size_t>(n));
+    }
+
+private:
+    std::FILE *out_;
+    size_t capacity_;
+    std::string buf_;
+};
+
+/**
+ * @brief Receives results in output order. Not thread-safe; callers serialise.
+ *
+ * @p source is "live" for the local machine or the snapshot path.
+ */
+class Reporter {
+public:
+    explicit Reporter(ReportWriter &w) : w_(w) {}
+    virtual ~Reporter() = default;
+
+    virtual void begin_host(const std::string &host, const std::string &source) = 0;
+    /** @brief All findings of one check, with its wall-clock duration. */
+    virtual void check(const std::string &host, std::string_view check, const std::vector<ReportFinding> &findings,
+                       double duration_ms) = 0;
+    virtual void end_host(const std::string &host, const std::string &source, int exit_code, double duration_ms) = 0;
+    /** @brief A source that could not be evaluated at all (e.g. corrupt snapshot). */
+    virtual void error(const std::string &source, const std::string &message) = 0;
+    virtual void finish(size_t hosts, size_t failed, int exit_code) = 0;
+
+    void flush() { w_.flush(); }
+
+protected:
+    ReportWriter &w_;
+};
+
+class TextReporter : public Reporter {
+public:
+    using Reporter::Reporter;
+
+    void begin_host(const std::string &host, const std::string &source) override {
+        if (source == "live") return;
+        w_.write("=== Host: ");
+        w_.write(host);
+        w_.write(" (");
+        w_.write(source);
+        w_.write(") ===\n");
+    }
+    void check(const std::string &, std::string_view, const std::vector<ReportFinding> &findings, double) override {
+        for (const auto &f : findings) {
+            w_.write(f.text);
+            w_.put('\n');
+        }
+    }
+    void end_host(const std::string &host, const std::string &source, int exit_code, double) override {
+        if (source == "live") return;
+        w_.write("[host:");
+        w_.write(host);
+        w_.write(exit_code == 0 ? "] PASS (exit code: " : "] FAIL (exit code: ");
+        w_.write(std::to_string(exit_code));
+        w_.write(")\n");
+    }
+    void error(const std::string &, const std::string &message) override {
+        w_.write("[snapshot] ERROR ");
+        w_.write(message);
+        w_.put('\n');
+    }
+    void finish(size_t, size_t, int) override {}
+};
+
+class JsonlReporter : public Reporter {
+public:
+    using Reporter::Reporter;
+
+    void begin_host(const std::string &, const std::string &) override {}
+
+    void check(const std::string &host, std::string_view check, const std::vector<ReportFinding> &findings,
+               double duration_ms) override {
+        for (const auto &f : findings) {
+            field_open("finding", "host", host);
+            str_field("check", check);
+            str_field("id", f.id);
+            w_.write(f.ok ? ",\"ok\":true" : ",\"ok\":false");
+            str_field("message", f.text);
+            w_.write(",\"check_duration_ms\":");
+            w_.number(duration_ms);
+            w_.write("}\n");
+        }
+    }
+
+    void end_host(const std::string &host, const std::string &source, int exit_code, double duration_ms) override {
+        field_open("host", "host", host);
+        str_field("source", source);
+        w_.write(",\"exit_code\":");
+        w_.write(std::to_string(exit_code));
+        w_.write(",\"duration_ms\":");
+        w_.number(duration_ms);
+        w_.write("}\n");
+    }
+
+    void error(const std::string &source, const std::string &message) override {
+        field_open("error", "source", source);
+        str_field("message", message);
+        w_.write("}\n");
+    }
+
+    void finish(size_t hosts, size_t failed, int exit_code) override {
+        w_.write("{\"type\":\"summary\",\"hosts\":");
+        w_.write(std::to_string(hosts));
+        w_.write(",\"failed\":");
+        w_.write(std::to_string(failed));
+        w_.write(",\"exit_code\":");
+        w_.write(std::to_string(exit_code));
+        w_.write("}\n");
+        w_.flush();
+    }
+
+private:
+    void field_open(const char *type, const char *key, std::string_view value) {
+        w_.write("{\"type\":\"");
+        w_.write(type);
+        w_.write("\"");
+        str_field(key, value);
+    }
+    void str_field(const char *key, std::string_view value) {
+        w_.write(",\"");
+        w_.write(key);
+        w_.write("\":\"");
+        w_.json_escaped(value);
+        w_.put('"');
+    }
+};
+
+class JUnitReporter : public Reporter {
+public:
+    explicit JUnitReporter(ReportWriter &w) : Reporter(w) {
+        char ts[32];
+        std::time_t t = std::time(nullptr);
+        std::strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&t));
+        timestamp_ = ts;
+        w_.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites name=\"os_controlsystem\">\n");
+    }
+
+    void begin_host(const std::string &, const std::string &) override {}
+
+    void check(const std::string &host, std::string_view check, const std::vector<ReportFinding> &findings,
+               double duration_ms) override {
+        size_t failures = 0;
+        for (const auto &f : findings) failures += f.ok ? 0 : 1;
+        w_.write("  <testsuite name=\"");
+        w_.xml_escaped(check);
+        w_.write("\" hostname=\"");
+        w_.xml_escaped(host);
+        w_.write("\" tests=\"");
+        w_.write(std::to_string(findings.size()));
+        w_.write("\" failures=\"");
+        w_.write(std::to_string(failures));
+        w_.write("\" errors=\"0\" time=\"");
+        w_.number(duration_ms / 1000.0);
+        w_.write("\" timestamp=\"");
+        w_.write(timestamp_);
+        w_.write("\">\n");
+        // A check evaluates its findings in one pass; each case gets an equal share of the time.
+        double share = findings.empty() ? 0.0 : duration_ms / 1000.0 / static_cast<double>(findings.size());
+        for (const auto &f : findings) {
+            w_.write("    <testcase classname=\"os_controlsystem.");
+            w_.xml_escaped(host);
+            w_.write("\" name=\"");
+            w_.xml_escaped(f.id);
+            w_.write("\" time=\"");
+            w_.number(share);
+            w_.write("\">");
+            if (!f.ok) {
+                w_.write("<failure message=\"");
+                w_.xml_escaped(f.text);
+                w_.write("\"/>");
+            }
+            w_.write("<system-out>");
+            w_.xml_escaped(f.text);
+            w_.write("</system-out></testcase>\n");
+        }
+        w_.write("  </testsuite>\n");
+    }
+
+    void end_host(const std::string &, const std::string &, int, double) override {}
+
+    void error(const std::string &source, const std::string &message) override {
+        w_.write("  <testsuite name=\"snapshot\" tests=\"1\" failures=\"0\" errors=\"1\" time=\"0\" timestamp=\"");
+        w_.write(timestamp_);
+        w_.write("\">\n    <testcase classname=\"os_controlsystem.snapshot\" name=\"");
+        w_.xml_escaped(source);
+        w_.write("\"><error message=\"");
+        w_.xml_escaped(message);
+        w_.write("\"/></testcase>\n  </testsuite>\n");
+    }
+
+    void finish(size_t, size_t, int) override {
+        w_.write("</testsuites>\n");
+        w_.flush();
+    }
+
+private:
+    std::string timestamp_;
+};
+
+/** @brief Reporter for @p format ("text", "jsonl", "junit"); nullptr if unknown. */
+inline std::unique_ptr<Reporter> make_reporter(const std::string &format, ReportWriter &w) {
+    if (format == "text") return std::unique_ptr<Reporter>(new TextReporter(w));
+    if (format == "jsonl") return std::unique_ptr<Reporter>(new JsonlReporter(w));
+    if (format == "junit") return std::unique_ptr<Reporter>(new JUnitReporter(w));
+    return nullptr;
+}
+
+#endif /* OS_REPORT_H */
@@ -0,0 +1,281 @@
+#ifndef OS_ROOTFS_H
+#define OS_ROOTFS_H
+
+/**
+ * @file os_rootfs.h
+ * @brief Offline HostSource for an extracted root filesystem (`--root DIR`).
+ *
+ * Every path is resolved below a directory descriptor for the root, one
+ * component at a time with openat(O_NOFOLLOW), so the host's own files are
+ * never read by accident. Symlinks are followed the way they would be inside
+ * the image: absolute targets restart at the root, relative ones continue
+ * from the link's directory. A `..` that would climb above the root is an
+ * escape and fails with EXDEV.
+ *
+ * Nothing is running in an image, so the live inputs are derived from
+ * configuration: sysctl values from sysctl.conf and sysctl.d, service state
+ * from `*.wants/` enablement links, no listening ports and no ufw.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "os_host.h"
+#include "os_metrics.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+/** @brief Sandboxed, read-only view of the files below one root directory. */
+class RootFs {
+public:
+    RootFs() = default;
+    ~RootFs() { if (root_ >= 0) close(root_); }
+
+    RootFs(const RootFs &) = delete;
+    RootFs &operator=(const RootFs &) = delete;
+
+    bool open(const std::string &dir, std::string &err) {
+        root_ = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (root_ < 0) { err = dir + ": " + std::strerror(errno); return false; }
+        return true;
+    }
+
+    /**
+     * @brief Open @p path (absolute within the root) with @p flags.
+     * @return A descriptor, or -1 with errno set (EXDEV if resolution left the root).
+     */
+    int open_at(std::string_view path, int flags) const {
+        std::vector<int> dirs;  // descriptors of the directories walked so far, below the root
+        auto top = [&] { return dirs.empty() ? root_ : dirs.back(); };
+        auto fail = [&](int e) {
+            for (int fd : dirs) close(fd);
+            errno = e;
+            return -1;
+        };
+
+        std::vector<std::string> pending;  // components still to walk, in reverse order
+        push_components(pending, path);
+        int links = 0;
+        while (!pending.empty()) {
+            std::string name = std::move(pending.back());
+            pending.pop_back();
+            if (name == "..") {
+                if (dirs.empty()) return fail(EXDEV);
+                close(dirs.back());
+                dirs.pop_back();
+                continue;
+            }
+            struct stat st;
+            if (fstatat(top(), name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) return fail(errno);
+            if (S_ISLNK(st.st_mode)) {
+                if (++links > 40) return fail(ELOOP);
+                char target[4096];
+                ssize_t n = readlinkat(top(), name.c_str(), target, sizeof(target));
+                if (n < 0) return fail(errno);
+                if (n == static_cast<ssize_t>(sizeof(target))) return fail(ENAMETOOLONG);
+                std::string_view t(target, static_cast<size_t>(n));
+                if (!t.empty() && t.front() == '/') {
+                    for (int fd : dirs) close(fd);
+                    dirs.clear();
+                }
+                push_components(pending, t);
+                continue;
+            }
+            if (pending.empty()) {
+                int fd = openat(top(), name.c_str(), flags | O_NOFOLLOW | O_CLOEXEC);
+                int e = errno;
+                for (int d : dirs) close(d);
+                errno = e;
+                return fd;
+            }
+            if (!S_ISDIR(st.st_mode)) return fail(ENOTDIR);
+            int fd = openat(top(), name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0) return fail(errno);
+            dirs.push_back(fd);
+        }
+        // The path named the root itself (or resolved back to a directory on the stack).
+        int fd = openat(top(), ".", flags | O_CLOEXEC);
+        int e = errno;
+        for (int d : dirs) close(d);
+        errno = e;
+        return fd;
+    }
+
+    bool read_file(std::string_view path, std::string &out) const {
+        int fd = open_at(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) { close(fd); return false; }
+        out.clear();
+        out.reserve(static_cast<size_t>(st.st_size));
+        char buf[65536];
+        for (;;) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            out.append(buf, static_cast<size_t>(n));
+        }
+        close(fd);
+        metrics_count_read(out.size());
+        return true;
+    }
+
+    std::vector<std::string> list_dir(std::string_view path) const {
+        std::vector<std::string> names;
+        int fd = open_at(path, O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return names;
+        DIR *d = fdopendir(fd);
+        if (!d) { close(fd); return names; }
+        while (struct dirent *e = readdir(d)) {
+            if (std::strcmp(e->d_name, ".") != 0 && std::strcmp(e->d_name, "..") != 0) names.emplace_back(e->d_name);
+        }
+        closedir(d);
+        return names;
+    }
+
+private:
+    static void push_components(std::vector<std::string> &pending, std::string_view path) {
+        size_t end = path.size();
+        while (end > 0) {
+            size_t slash = path.rfind('/', end - 1);
+            size_t start = slash == std::string_view::npos ? 0 : slash + 1;
+            if (end > start && path.substr(start, end - start) != ".")
+                pending.emplace_back(path.substr(start, end - start));
+            if (slash == std::string_view::npos) break;
+            end = slash;
+        }
+    }
+
+    int root_ = -1;
+};
+
+/**
+ * @brief sysctl values an image would apply at boot (`sysctl --system` order).
+ *
+ * Files in /etc, /run, /usr/local/lib, /usr/lib and /lib `sysctl.d` are merged
+ * by name (the earlier directory wins), applied in name order, and
+ * /etc/sysctl.conf last. Later assignments override earlier ones.
+ */
+template <typename Fs>
+std::map<std::string, std::string> sysctl_conf_values(const Fs &fs) {
+    static const char *const dirs[] = {"/etc/sysctl.d", "/run/sysctl.d", "/usr/local/lib/sysctl.d",
+                                       "/usr/lib/sysctl.d", "/lib/sysctl.d"};
+    std::map<std::string, std::string> files;  // name -> path of the winning copy
+    for (const char *dir : dirs) {
+        for (const auto &name : fs.list_dir(dir)) {
+            if (name.size() > 5 && name.compare(name.size() - 5, 5, ".conf") == 0)
+                files.emplace(name, std::string(dir) + "/" + name);
+        }
+    }
+    std::vector<std::string> paths;
+    for (const auto &kv : files) paths.push_back(kv.second);
+    paths.push_back("/etc/sysctl.conf");
+
+    std::map<std::string, std::string> values;
+    std::string text;
+    for (const auto &path : paths) {
+        if (!fs.read_file(path, text)) continue;
+        std::string_view rest(text);
+        while (!rest.empty()) {
+            size_t nl = rest.find('\n');
+            std::string_view line = rest.substr(0, nl);
+            rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+            auto trim = [](std::string_view s) {
+                while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+                while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+                return s;
+            };
+            line = trim(line);
+            if (line.empty() || line.front() == '#' || line.front() == ';') continue;
+            size_t eq = line.find('=');
+            if (eq == std::string_view::npos) continue;
+            std::string_view key = trim(line.substr(0, eq));
+            if (!key.empty() && key.front() == '-') key.remove_prefix(1);  // "-key = v": ignore write errors
+            // "net/ipv4/ip_forward" is the same key as "net.ipv4.ip_forward".
+            std::string k(key);
+            if (k.find_first_of("./") != std::string::npos && k[k.find_first_of("./")] == '/') {
+                for (auto &c : k) c = c == '/' ? '.' : c == '.' ? '/' : c;
+            }
+            values[k] = std::string(trim(line.substr(eq + 1)));
+        }
+    }
+    return values;
+}
+
+/** @brief HostSource for an image or chroot below @p root; see the file comment. */
+class RootfsHostSource : public HostSource {
+public:
+    bool open(const std::string &root, std::string &err) {
+        root_ = root;
+        return fs_.open(root, err);
+    }
+
+    std::string name() const override { return root_; }
+
+    std::vector<SysctlValue> read_sysctl(const std::vector<std::string> &keys) override {
+        if (!loaded_) {
+            sysctl_ = sysctl_conf_values(fs_);
+            loaded_ = true;
+        }
+        std::vector<SysctlValue> out(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            auto it = sysctl_.find(keys[i]);
+            if (it == sysctl_.end()) {
+                out[i].status = SysctlStatus::Missing;
+                out[i].err = ENOENT;
+            } else {
+                out[i].status = SysctlStatus::Ok;
+                out[i].value = it->second;
+            }
+        }
+        return out;
+    }
+
+    bool read_file(const std::string &path, std::string &out) override { return fs_.read_file(path, out); }
+
+    std::vector<std::string> list_dir(const std::string &dir) override { return fs_.list_dir(dir); }
+
+    // An image runs nothing; a unit counts as up if some target wants it.
+    ServiceState service_state(const std::string &name) override {
+        for (const auto &dir : systemd_unit_dirs()) {
+            for (const auto &entry : fs_.list_dir(dir)) {
+                std::string_view e(entry);
+                bool deps = (e.size() > 6 && e.substr(e.size() - 6) == ".wants") ||
+                            (e.size() > 9 && e.substr(e.size() - 9) == ".requires");
+                if (!deps) continue;
+                struct stat st;
+                int fd = fs_.open_at(dir + "/" + entry + "/" + name, O_RDONLY);
+                if (fd < 0) continue;
+                bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+                close(fd);
+                if (ok) return ServiceState{true, "enabled in " + dir + "/" + entry};
+            }
+        }
+        return ServiceState{false, "not enabled (no *.wants/ link in the image)"};
+    }
+
+    CommandResult firewall_status() override { return CommandResult{-1, "offline root: no saved firewall rules"}; }
+
+    std::vector<ListeningPort> listening_ports() override { return {}; }
+
+private:
+    std::string root_;
+    RootFs fs_;
+    bool loaded_ = false;
+    std::map<std::string, std::string> sysctl_;
+};
+
+#endif /* !_WIN32 */
+
+#endif /* OS_ROOTFS_H */
@@ -0,0 +1,180 @@
+#ifndef OS_SCHEDULER_H
+#define OS_SCHEDULER_H
+
+/**
+ * @file os_scheduler.h
+ * @brief Small work-stealing task scheduler for independent checks.
+ *
+ * Tasks are added up front (optionally depending on earlier tasks) and then
+ * executed by run(), which blocks until every task has finished. Each worker
+ * owns a deque: it pops its own work LIFO and steals FIFO from the others
+ * when idle. A task becomes ready once all of its dependencies completed and
+ * is pushed onto the deque of the worker that finished the last one.
+ *
+ * Tasks must not throw; results are communicated through state captured by
+ * the task (typically a per-task result slot).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler {
+public:
+    using TaskId = size_t;
+
+    /** @param threads Worker count; 0 means std::thread::hardware_concurrency(). */
+    explicit TaskScheduler(unsigned threads = 0) : threads_(threads) {
+        if (threads_ == 0) threads_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /**
+     * @brief Register a task.
+     * @param fn Work to run.
+     * @param deps Tasks that must finish before @p fn starts (must already exist).
+     * @return Id usable as a dependency of later tasks.
+     */
+    TaskId add(std::function<void()> fn, const std::vector<TaskId> &deps = {}) {
+        TaskId id = tasks_.size();
+        tasks_.push_back(std::make_unique<Task>());
+        tasks_.back()->fn = std::move(fn);
+        tasks_.back()->pending.store(deps.size());
+        for (TaskId d : deps) tasks_[d]->successors.push_back(id);
+        return id;
+    }
+
+    size_t size() const { return tasks_.size(); }
+
+    /** @brief Execute every registered task and wait for completion. */
+    void run() {
+        if (tasks_.empty()) return;
+        unsigned n = static_cast<unsigned>(std::min<size_t>(threads_, tasks_.size()));
+        queues_.clear();
+        for (unsigned i = 0; i < n; ++i) queues_.push_back(std::make_unique<Queue>());
+        remaining_.store(tasks_.size());
+
+        unsigned next = 0;
+        for (TaskId id = 0; id < tasks_.size(); ++id) {
+            if (tasks_[id]->pending.load() == 0) {
+                queues_[next]->items.push_back(id);
+                next = (next + 1) % n;
+            }
+        }
+
+        // The calling thread acts as worker 0.
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < n; ++i) workers.emplace_back([this, i] { work(i); });
+        work(0);
+        for (auto &t : workers) t.join();
+        tasks_.clear();
+    }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        std::atomic<size_t> pending{0};
+        std::vector<TaskId> successors;
+    };
+
+    struct Queue {
+        std::mutex mu;
+        std::deque<TaskId> items;
+    };
+
+    bool pop_local(unsigned self, TaskId &out) {
+        Queue &q = *queues_[self];
+        std::lock_guard<std::mutex> lk(q.mu);
+        if (q.items.empty()) return false;
+        out = q.items.back();
+        q.items.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned self, TaskId &out) {
+        for (size_t k = 1; k < queues_.size(); ++k) {
+            Queue &q = *queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> lk(q.mu);
+            if (q.items.empty()) continue;
+            out = q.items.front();
+            q.items.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void complete(unsigned self, TaskId id) {
+        bool pushed = false;
+        for (TaskId s : tasks_[id]->successors) {
+            if (tasks_[s]->pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lk(queues_[self]->mu);
+                queues_[self]->items.push_back(s);
+                pushed = true;
+            }
+        }
+        bool last = remaining_.fetch_sub(1) == 1;
+        if (pushed || last) {
+            std::lock_guard<std::mutex> lk(idle_mu_);
+            epoch_.fetch_add(1);
+            idle_cv_.notify_all();
+        }
+    }
+
+    void work(unsigned self) {
+        for (;;) {
+            // Any push after this snapshot bumps the epoch, so it cannot be
+            // missed between the failed pop/steal below and the wait.
+            size_t seen = epoch_.load();
+            TaskId id;
+            if (pop_local(self, id) || steal(self, id)) {
+                tasks_[id]->fn();
+                complete(self, id);
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(idle_mu_);
+            idle_cv_.wait(lk, [&] { return epoch_.load() != seen || remaining_.load() == 0; });
+            if (remaining_.load() == 0) return;
+        }
+    }
+
+    unsigned threads_;
+    std::vector<std::unique_ptr<Task>> tasks_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic<size_t> remaining_{0};
+    std::atomic<size_t> epoch_{0};  // bumped under idle_mu_ whenever work is pushed or the run ends
+    std::mutex idle_mu_;
+    std::condition_variable idle_cv_;
+};
+
+/**
+ * @brief Releases results in index order while tasks finish in any order.
+ *
+ * complete(i) marks slot i done and calls emit(j) for every slot j from the
+ * first unreleased one up to the next gap, under a lock, so emit() calls are
+ * serialised and in order. Lets a reporter stream output as soon as a prefix
+ * of the checks is done instead of after the slowest one.
+ */
+class OrderedCompletion {
+public:
+    OrderedCompletion(size_t n, std::function<void(size_t)> emit) : done_(n, false), emit_(std::move(emit)) {}
+
+    void complete(size_t i) {
+        std::lock_guard<std::mutex> lk(mu_);
+        done_[i] = true;
+        while (next_ < done_.size() && done_[next_]) emit_(next_++);
+    }
+
+private:
+    std::mutex mu_;
+    std::vector<bool> done_;
+    size_t next_ = 0;
+    std::function<void(size_t)> emit_;
+};
+
+#endif /* OS_SCHEDULER_H */
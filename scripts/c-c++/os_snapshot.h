@@ -0,0 +1,369 @@
+#ifndef OS_SNAPSHOT_H
+#define OS_SNAPSHOT_H
+
+/**
+ * @file os_snapshot.h
+ * @brief Compact binary snapshot of the host state used by the checks.
+ *
+ * `os_controlsystem --capture FILE` serialises everything the checks look at
+ * (sysctl values, unit/drop-in/config files, service state, inspection command
+ * output, listening ports) into one file. `--evaluate-snapshot DIR` maps such files and runs the
+ * normal checks against them through SnapshotHostSource, without touching the
+ * live system.
+ *
+ * Layout (integers little-endian, `varint` = unsigned LEB128,
+ * `str` = varint length + bytes):
+ *
+ *     "OSTSNAP1" | u32 version | u64 captured_at (unix seconds) | str hostname
+ *     section* : u8 type | varint payload_len | payload
+ *
+ *     SYSCTL  (1): varint n, n x { str key, u8 status, varint err, str value }  sorted by key
+ *     FILE    (2): varint n, n x { str path, str content }                      sorted by path
+ *     COMMAND (3): varint n, n x { str name, varint zigzag(exit), str output }  sorted by name
+ *                  ("service-state <unit>" records exit 0 when the unit was active, 4 when
+ *                  its state could not be determined)
+ *     PORTS   (4): varint n, n x { str proto, varint port }
+ *
+ * Unknown section types are skipped so newer writers stay readable.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "os_host.h"
+#include "os_mmap.h"
+
+namespace snapshot_detail {
+
+constexpr char magic[8] = {'O', 'S', 'T', 'S', 'N', 'A', 'P', '1'};
+constexpr uint32_t version = 1;
+
+enum Section : uint8_t { SEC_SYSCTL = 1, SEC_FILE = 2, SEC_COMMAND = 3, SEC_PORTS = 4 };
+
+inline void put_varint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+inline void put_fixed(std::string &out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out += static_cast<char>((v >> (8 * i)) & 0xFF);
+}
+
+inline void put_str(std::string &out, std::string_view s) {
+    put_varint(out, s.size());
+    out.append(s.data(), s.size());
+}
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// Bounds-checked cursor over a mapped snapshot; any overrun sets `bad`.
+struct Cursor {
+    std::string_view buf;
+    size_t pos = 0;
+    bool bad = false;
+
+    bool done() const { return bad || pos >= buf.size(); }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= buf.size()) break;
+            uint8_t b = static_cast<uint8_t>(buf[pos++]);
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        bad = true;
+        return 0;
+    }
+
+    uint64_t fixed(int bytes) {
+        if (pos > buf.size() || buf.size() - pos < static_cast<size_t>(bytes)) { bad = true; return 0; }
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(static_cast<uint8_t>(buf[pos + i])) << (8 * i);
+        pos += bytes;
+        return v;
+    }
+
+    std::string_view str() {
+        uint64_t n = varint();
+        if (bad || n > buf.size() - pos) { bad = true; return std::string_view(); }
+        std::string_view s = buf.substr(pos, n);
+        pos += n;
+        return s;
+    }
+};
+
+} // namespace snapshot_detail
+
+/** @brief Builds a snapshot in memory and writes it atomically. */
+class SnapshotWriter {
+public:
+    void set_host(std::string hostname, uint64_t captured_at) {
+        hostname_ = std::move(hostname);
+        captured_at_ = captured_at;
+    }
+    void add_sysctl(std::string key, const SysctlValue &v) { sysctl_.emplace_back(std::move(key), v); }
+    void add_file(std::string path, std::string content) { files_.emplace_back(std::move(path), std::move(content)); }
+    void add_command(std::string name, CommandResult r) { commands_.emplace_back(std::move(name), std::move(r)); }
+    void add_port(const ListeningPort &p) { ports_.push_back(p); }
+
+    /** @brief Serialise all collected state. */
+    std::string encode() {
+        using namespace snapshot_detail;
+        auto by_name = [](const auto &a, const auto &b) { return a.first < b.first; };
+        std::sort(sysctl_.begin(), sysctl_.end(), by_name);
+        std::sort(files_.begin(), files_.end(), by_name);
+        std::sort(commands_.begin(), commands_.end(), by_name);
+
+        std::string out(magic, sizeof(magic));
+        put_fixed(out, version, 4);
+        put_fixed(out, captured_at_, 8);
+        put_str(out, hostname_);
+
+        std::string body;
+        put_varint(body, sysctl_.size());
+        for (const auto &kv : sysctl_) {
+            put_str(body, kv.first);
+            body += static_cast<char>(kv.second.status);
+            put_varint(body, static_cast<uint64_t>(kv.second.err));
+            put_str(body, kv.second.value);
+        }
+        section(out, SEC_SYSCTL, body);
+
+        body.clear();
+        put_varint(body, files_.size());
+        for (const auto &kv : files_) { put_str(body, kv.first); put_str(body, kv.second); }
+        section(out, SEC_FILE, body);
+
+        body.clear();
+        put_varint(body, commands_.size());
+        for (const auto &kv : commands_) {
+            put_str(body, kv.first);
+            put_varint(body, zigzag(kv.second.exit_code));
+            put_str(body, kv.second.output);
+        }
+        section(out, SEC_COMMAND, body);
+
+        body.clear();
+        put_varint(body, ports_.size());
+        for (const auto &p : ports_) { put_str(body, p.proto); put_varint(body, p.port); }
+        section(out, SEC_PORTS, body);
+        return out;
+    }
+
+    /** @brief Write to @p path via a temporary file and rename(). */
+    bool write(const std::string &path, std::string &err) {
+        std::string data = encode();
+        std::string tmp = path + ".tmp";
+        FILE *f = std::fopen(tmp.c_str(), "wb");
+        if (!f) { err = tmp + ": " + std::strerror(errno); return false; }
+        bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            err = path + ": " + std::strerror(errno);
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static void section(std::string &out, uint8_t type, const std::string &body) {
+        out += static_cast<char>(type);
+        snapshot_detail::put_varint(out, body.size());
+        out += body;
+    }
+
+    std::string hostname_;
+    uint64_t captured_at_ = 0;
+    std::vector<std::pair<std::string, SysctlValue>> sysctl_;
+    std::vector<std::pair<std::string, std::string>> files_;
+    std::vector<std::pair<std::string, CommandResult>> commands_;
+    std::vector<ListeningPort> ports_;
+};
+
+/**
+ * @brief Memory-mapped, read-only snapshot exposed as a HostSource.
+ *
+ * Entries are indexed as views into the mapping; lookups are binary searches,
+ * so open() rejects sections that are not sorted.
+ */
+class SnapshotHostSource : public HostSource {
+public:
+    /** @brief Map and index @p path; @p err explains a failure. */
+    bool open(const std::string &path, std::string &err) {
+        using namespace snapshot_detail;
+        if (!file_.open(path, err)) return false;
+        Cursor c{file_.data()};
+        if (c.buf.size() < sizeof(magic) || c.buf.substr(0, sizeof(magic)) != std::string_view(magic, sizeof(magic))) {
+            err = path + ": not an os_controlsystem snapshot";
+            return false;
+        }
+        c.pos = sizeof(magic);
+        uint64_t ver = c.fixed(4);
+        captured_at_ = c.fixed(8);
+        hostname_ = std::string(c.str());
+        if (!c.bad && ver != version) {
+            err = path + ": unsupported snapshot version " + std::to_string(ver);
+            return false;
+        }
+        while (!c.done()) {
+            uint8_t type = static_cast<uint8_t>(c.buf[c.pos++]);
+            std::string_view payload = c.str();
+            if (c.bad) break;
+            if (type < SEC_SYSCTL || type > SEC_PORTS) continue;  // unknown section: skip it
+            Cursor s{payload};
+            uint64_t n = s.varint();
+            for (uint64_t i = 0; i < n && !s.bad; ++i) {
+                switch (type) {
+                case SEC_SYSCTL: {
+                    Entry e{s.str(), {}, 0, 0};
+                    e.status = s.fixed(1);
+                    if (e.status > static_cast<uint64_t>(SysctlStatus::Error)) s.bad = true;
+                    e.num = static_cast<int64_t>(s.varint());
+                    e.data = s.str();
+                    sysctl_.push_back(e);
+                    break;
+                }
+                case SEC_FILE: {
+                    Entry e{s.str(), {}, 0, 0};
+                    e.data = s.str();
+                    files_.push_back(e);
+                    break;
+                }
+                case SEC_COMMAND: {
+                    Entry e{s.str(), {}, 0, 0};
+                    e.num = unzigzag(s.varint());
+                    e.data = s.str();
+                    commands_.push_back(e);
+                    break;
+                }
+                case SEC_PORTS: {
+                    ListeningPort p;
+                    p.proto = std::string(s.str());
+                    p.port = static_cast<uint16_t>(s.varint());
+                    ports_.push_back(p);
+                    break;
+                }
+                }
+            }
+            if (s.bad) c.bad = true;
+        }
+        if (c.bad) {
+            err = path + ": truncated or corrupt snapshot";
+            return false;
+        }
+        // Lookups are binary searches: a section out of order would silently miss entries.
+        auto by_name = [](const Entry &a, const Entry &b) { return a.name < b.name; };
+        for (const auto *v : {&sysctl_, &files_, &commands_}) {
+            if (!std::is_sorted(v->begin(), v->end(), by_name)) {
+                err = path + ": corrupt snapshot (entries not sorted)";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t captured_at() const { return captured_at_; }
+
+    std::string name() const override { return hostname_; }
+
+    std::vector<SysctlValue> read_sysctl(const std::vector<std::string> &keys) override {
+        std::vector<SysctlValue> out(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const Entry *e = lookup(sysctl_, keys[i]);
+            if (!e) {
+                out[i].status = SysctlStatus::Missing;
+                out[i].err = ENOENT;
+                continue;
+            }
+            out[i].status = static_cast<SysctlStatus>(e->status);
+            out[i].err = static_cast<int>(e->num);
+            out[i].value = std::string(e->data);
+        }
+        return out;
+    }
+
+    bool read_file(const std::string &path, std::string &out) override {
+        const Entry *e = lookup(files_, path);
+        if (!e) return false;
+        out.assign(e->data.data(), e->data.size());
+        return true;
+    }
+
+    std::vector<std::string> list_dir(const std::string &dir) override {
+        std::vector<std::string> names;
+        std::string prefix = dir + "/";
+        auto it = std::lower_bound(files_.begin(), files_.end(), std::string_view(prefix),
+                                   [](const Entry &e, std::string_view n) { return e.name < n; });
+        for (; it != files_.end() && it->name.substr(0, prefix.size()) == prefix; ++it) {
+            std::string_view rest = it->name.substr(prefix.size());
+            if (!rest.empty() && rest.find('/') == std::string_view::npos) names.emplace_back(rest);
+        }
+        return names;
+    }
+
+    ServiceState service_state(const std::string &name) override {
+        CommandResult r = command(service_state_command(name));
+        ServiceState st;
+        st.active = r.exit_code == 0;
+        st.determinable = r.exit_code != 4;  // systemctl's "status unknown"
+        st.detail = r.exit_code < 0 ? "state not captured" : r.output;
+        return st;
+    }
+
+    CommandResult firewall_status() override { return command(firewall_command()); }
+
+    /** @brief COMMAND entry names used for HostSource::service_state / firewall_status. */
+    static std::string service_state_command(const std::string &unit) { return "service-state " + unit; }
+    static std::string firewall_command() { return "ufw status verbose"; }
+
+    std::vector<ListeningPort> listening_ports() override { return ports_; }
+
+private:
+    struct Entry {
+        std::string_view name;
+        std::string_view data;
+        uint64_t status;
+        int64_t num;
+    };
+
+    static const Entry *lookup(const std::vector<Entry> &v, std::string_view name) {
+        auto it = std::lower_bound(v.begin(), v.end(), name,
+                                   [](const Entry &e, std::string_view n) { return e.name < n; });
+        return (it != v.end() && it->name == name) ? &*it : nullptr;
+    }
+
+    CommandResult command(const std::string &name) const {
+        CommandResult r;
+        const Entry *e = lookup(commands_, name);
+        if (!e) {
+            r.output = "not captured in snapshot";
+            return r;
+        }
+        r.exit_code = static_cast<int>(e->num);
+        r.output = std::string(e->data);
+        return r;
+    }
+
+    MappedFile file_;
+    std::string hostname_;
+    uint64_t captured_at_ = 0;
+    std::vector<Entry> sysctl_, files_, commands_;
+    std::vector<ListeningPort> ports_;
+};
+
+#endif /* OS_SNAPSHOT_H */
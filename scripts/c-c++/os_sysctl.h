@@ -0,0 +1,228 @@
+#ifndef OS_SYSCTL_H
+#define OS_SYSCTL_H
+
+/**
+ * @file os_sysctl.h
+ * @brief Fork-free sysctl reader backed by /proc/sys.
+ *
+ * Maps dotted sysctl keys (e.g. `net.ipv4.ip_forward`) to paths below
+ * /proc/sys and reads their values with openat()/pread() through a cache
+ * of directory descriptors, so checking hundreds of keys costs a handful
+ * of syscalls per key and never spawns `sysctl -n`.
+ *
+ * Key syntax follows sysctl(8): `.` separates components and `/` stands for
+ * a literal dot inside a component, so `net.ipv4.conf.eth0/100.forwarding`
+ * resolves to `net/ipv4/conf/eth0.100/forwarding`. Keys whose first
+ * separator is `/` are taken as plain paths.
+ *
+ * Header-only so os_controlsystem keeps building as a single translation unit.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cerrno>
+
+#include "os_metrics.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** @brief Outcome of reading a single sysctl key. */
+enum class SysctlStatus {
+    Ok,       /**< Value read successfully. */
+    Missing,  /**< Key does not exist on this kernel (ENOENT/ENOTDIR). */
+    Denied,   /**< Key exists but is not readable (EACCES/EPERM). */
+    Error     /**< Any other I/O error; see SysctlValue::err. */
+};
+
+/** @brief Value (or failure) for one sysctl key. */
+struct SysctlValue {
+    SysctlStatus status = SysctlStatus::Error;
+    std::string value;  /**< Trailing newline/whitespace trimmed. */
+    int err = 0;        /**< errno of the failing call, 0 on success. */
+};
+
+/**
+ * @brief Convert a sysctl key into a path relative to /proc/sys.
+ * @param key Dotted key, or a slash-separated path.
+ * @return Relative path, e.g. "kernel/randomize_va_space".
+ */
+inline std::string sysctl_key_to_path(const std::string &key) {
+    std::string path = key;
+    auto first_sep = key.find_first_of("./");
+    if (first_sep == std::string::npos || key[first_sep] == '/') return path;
+    for (auto &c : path) {
+        if (c == '.') c = '/';
+        else if (c == '/') c = '.';
+    }
+    return path;
+}
+
+/** @brief Readable name of a SysctlStatus, as printed in check output. */
+inline const char *sysctl_status_name(SysctlStatus s) {
+    switch (s) {
+    case SysctlStatus::Ok: return "OK";
+    case SysctlStatus::Missing: return "MISSING";
+    case SysctlStatus::Denied: return "DENIED";
+    default: return "ERROR";
+    }
+}
+
+#ifndef _WIN32
+inline void sysctl_list_dir(int dfd, const std::string &prefix, std::vector<std::string> &out) {
+    DIR *d = fdopendir(dfd);
+    if (!d) { close(dfd); return; }
+    while (struct dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name == "." || name == "..") continue;
+        for (auto &c : name) if (c == '.') c = '/';
+        std::string key = prefix.empty() ? name : prefix + "." + name;
+        struct stat st;
+        if (fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            int sub = openat(dirfd(d), e->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (sub >= 0) sysctl_list_dir(sub, key, out);
+        } else if (S_ISREG(st.st_mode)) {
+            out.push_back(key);
+        }
+    }
+    closedir(d);
+}
+#endif
+
+/**
+ * @brief List every key below @p root (like `sysctl -a`), in dotted form.
+ * @return Keys sorted lexicographically; empty if @p root cannot be opened.
+ */
+inline std::vector<std::string> sysctl_list_keys(const std::string &root = "/proc/sys") {
+    std::vector<std::string> keys;
+#ifndef _WIN32
+    int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) sysctl_list_dir(fd, std::string(), keys);
+    std::sort(keys.begin(), keys.end());
+#else
+    (void)root;
+#endif
+    return keys;
+}
+
+/**
+ * @brief Reads sysctl values below a /proc/sys style root.
+ *
+ * Directory descriptors are opened once per parent directory and kept until
+ * the reader is destroyed. Not thread-safe; use one reader per thread.
+ */
+class SysctlReader {
+public:
+    /** @param root Directory holding the sysctl tree (default "/proc/sys"). */
+    explicit SysctlReader(std::string root = "/proc/sys") : root_(std::move(root)) {}
+    ~SysctlReader() { close_all(); }
+
+    SysctlReader(const SysctlReader &) = delete;
+    SysctlReader &operator=(const SysctlReader &) = delete;
+
+    const std::string &root() const { return root_; }
+
+    /** @brief Read one key. */
+    SysctlValue read(const std::string &key) {
+        SysctlValue out;
+#ifdef _WIN32
+        (void)key;
+        out.err = ENOSYS;
+#else
+        std::string rel = sysctl_key_to_path(key);
+        while (!rel.empty() && rel.front() == '/') rel.erase(0, 1);
+        auto slash = rel.rfind('/');
+        std::string dir = slash == std::string::npos ? std::string() : rel.substr(0, slash);
+        std::string leaf = slash == std::string::npos ? rel : rel.substr(slash + 1);
+        if (leaf.empty()) return fail(out, ENOENT);
+
+        int dfd = dir_fd(dir);
+        if (dfd < 0) return fail(out, errno);
+        int fd = openat(dfd, leaf.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return fail(out, errno);
+
+        char buf[4096];
+        off_t off = 0;
+        for (;;) {
+            ssize_t n = pread(fd, buf, sizeof(buf), off);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                int e = errno;
+                close(fd);
+                return fail(out, e);
+            }
+            if (n == 0) break;
+            out.value.append(buf, static_cast<size_t>(n));
+            off += n;
+        }
+        close(fd);
+        metrics_count_read(static_cast<size_t>(off));
+        while (!out.value.empty() && (out.value.back() == '\n' || out.value.back() == '\r' || out.value.back() == ' '))
+            out.value.pop_back();
+        out.status = SysctlStatus::Ok;
+#endif
+        return out;
+    }
+
+    /** @brief Read every key in @p keys; results are index-aligned with the input. */
+    std::vector<SysctlValue> read_all(const std::vector<std::string> &keys) {
+        std::vector<SysctlValue> out;
+        out.reserve(keys.size());
+        for (const auto &k : keys) out.push_back(read(k));
+        return out;
+    }
+
+private:
+    static SysctlValue &fail(SysctlValue &v, int e) {
+        v.err = e;
+        v.value.clear();
+        if (e == ENOENT || e == ENOTDIR) v.status = SysctlStatus::Missing;
+        else if (e == EACCES || e == EPERM) v.status = SysctlStatus::Denied;
+        else v.status = SysctlStatus::Error;
+        return v;
+    }
+
+#ifndef _WIN32
+    // Returns a cached O_DIRECTORY descriptor for @p dir ("" is the root itself).
+    int dir_fd(const std::string &dir) {
+        auto it = dirs_.find(dir);
+        if (it != dirs_.end()) {
+            if (it->second >= 0) return it->second;
+            errno = -it->second;
+            return -1;
+        }
+        int fd;
+        if (dir.empty()) {
+            fd = open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        } else {
+            int rfd = dir_fd(std::string());
+            fd = rfd < 0 ? -1 : openat(rfd, dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        // Negative entries remember the errno so missing subtrees are not re-probed.
+        int saved = errno;
+        dirs_.emplace(dir, fd >= 0 ? fd : -saved);
+        errno = saved;
+        return fd >= 0 ? fd : -1;
+    }
+#endif
+
+    void close_all() {
+#ifndef _WIN32
+        for (auto &kv : dirs_)
+            if (kv.second >= 0) close(kv.second);
+#endif
+        dirs_.clear();
+    }
+
+    std::string root_;
+    std::unordered_map<std::string, int> dirs_;
+};
+
+#endif /* OS_SYSCTL_H */
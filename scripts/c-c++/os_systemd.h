@@ -0,0 +1,358 @@
+#ifndef OS_SYSTEMD_H
+#define OS_SYSTEMD_H
+
+/**
+ * @file os_systemd.h
+ * @brief Native systemd unit inspection without spawning systemctl.
+ *
+ * - Unit files are parsed the way systemd does: `[Section]` headers, `#`/`;`
+ *   comments, lines ending in a backslash joined to the next one, and an
+ *   empty assignment (`ExecStart=`) resetting everything assigned before it.
+ * - Drop-ins (`<unit>.d/NAME.conf`) from every search directory are applied in
+ *   file-name order; a drop-in in a higher-priority directory masks one with
+ *   the same name in a lower-priority directory.
+ * - Active state is read from the unit's cgroup (`cgroup.events` on cgroup v2,
+ *   `cgroup.procs` on the v1 name=systemd hierarchy).
+ * - SystemdUnitCache keeps parsed units keyed by the stat() identity of every
+ *   file and directory that went into them, so repeated lookups cost a few
+ *   stat calls.
+ *
+ * The loader is a template over any source providing read_file()/list_dir(),
+ * so units resolve identically from the live system and from snapshots.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#include "os_metrics.h"
+
+/** @brief A unit after the main file and all drop-ins were applied. */
+struct SystemdUnit {
+    std::string name;
+    std::string path;                   /**< Main unit file. */
+    std::vector<std::string> dropins;   /**< Drop-in files, in application order. */
+    /** section -> key -> assigned values (an empty assignment clears the list). */
+    std::map<std::string, std::map<std::string, std::vector<std::string>>> sections;
+
+    /** @brief All values of @p key in @p section, or nullptr. */
+    const std::vector<std::string> *values(const std::string &section, const std::string &key) const {
+        auto s = sections.find(section);
+        if (s == sections.end()) return nullptr;
+        auto k = s->second.find(key);
+        return k == s->second.end() ? nullptr : &k->second;
+    }
+
+    /** @brief Last value of @p key in @p section, or "" if unset. */
+    std::string get(const std::string &section, const std::string &key) const {
+        const auto *v = values(section, key);
+        return (v && !v->empty()) ? v->back() : std::string();
+    }
+};
+
+/** @brief Whether a unit is running, with a short human-readable reason. */
+struct ServiceState {
+    bool active = false;
+    std::string detail;
+    bool determinable = true;   /**< false when neither the cgroup nor systemd's runtime state can tell. */
+};
+
+/** @brief Unit search path, highest priority first. */
+inline const std::vector<std::string> &systemd_unit_dirs() {
+    static const std::vector<std::string> dirs = {
+        "/etc/systemd/system", "/run/systemd/system", "/usr/lib/systemd/system", "/lib/systemd/system",
+    };
+    return dirs;
+}
+
+/** @brief Apply the assignments in @p text to @p unit. */
+inline void systemd_parse_unit_text(std::string_view text, SystemdUnit &unit) {
+    auto trim = [](std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+        return s;
+    };
+    std::string section;
+    std::string logical;
+    bool continued = false;
+    auto apply = [&](std::string_view l) {
+        l = trim(l);
+        if (l.size() >= 2 && l.front() == '[' && l.back() == ']') {
+            section = std::string(l.substr(1, l.size() - 2));
+            return;
+        }
+        auto eq = l.find('=');
+        if (l.empty() || section.empty() || eq == std::string_view::npos) return;
+        std::string key(trim(l.substr(0, eq)));
+        std::string_view val = trim(l.substr(eq + 1));
+        auto &list = unit.sections[section][key];
+        if (val.empty()) list.clear();
+        else list.emplace_back(val);
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) eol = text.size();
+        std::string_view line = trim(text.substr(pos, eol - pos));
+        pos = eol + 1;
+
+        // Comment lines are skipped, including inside a continuation (as systemd does).
+        if (!line.empty() && (line.front() == '#' || line.front() == ';')) continue;
+        if (line.empty() && !continued) continue;
+        if (!line.empty() && line.back() == '\\') {
+            logical.append(line.data(), line.size() - 1);
+            logical += ' ';
+            continued = true;
+            continue;
+        }
+        logical.append(line.data(), line.size());
+        apply(logical);
+        logical.clear();
+        continued = false;
+    }
+    if (!logical.empty()) apply(logical);
+}
+
+/**
+ * @brief Resolve and parse unit @p name (e.g. "os_typing.service") through @p fs.
+ * @tparam Fs Provides `bool read_file(const std::string&, std::string&)` and
+ *            `std::vector<std::string> list_dir(const std::string&)`.
+ * @return false if no unit file exists in any search directory.
+ */
+template <typename Fs>
+bool systemd_load_unit(Fs &fs, const std::string &name, SystemdUnit &out) {
+    out = SystemdUnit();
+    out.name = name;
+    std::string content;
+    for (const auto &dir : systemd_unit_dirs()) {
+        if (fs.read_file(dir + "/" + name, content)) {
+            out.path = dir + "/" + name;
+            break;
+        }
+    }
+    if (out.path.empty()) return false;
+    systemd_parse_unit_text(content, out);
+
+    std::map<std::string, std::string> dropins;  // file name -> path; first (highest priority) wins
+    for (const auto &dir : systemd_unit_dirs()) {
+        std::string ddir = dir + "/" + name + ".d";
+        for (const auto &entry : fs.list_dir(ddir)) {
+            if (entry.size() > 5 && entry.compare(entry.size() - 5, 5, ".conf") == 0)
+                dropins.emplace(entry, ddir + "/" + entry);
+        }
+    }
+    for (const auto &kv : dropins) {
+        if (!fs.read_file(kv.second, content)) continue;
+        systemd_parse_unit_text(content, out);
+        out.dropins.push_back(kv.second);
+    }
+    return true;
+}
+
+/** @brief "a-b-c.slice" -> "a.slice/a-b.slice/a-b-c.slice" (cgroup path of a slice). */
+inline std::string systemd_slice_path(const std::string &slice) {
+    const std::string suffix = ".slice";
+    if (slice == "-.slice" || slice.size() <= suffix.size()) return std::string();
+    std::string base = slice.substr(0, slice.size() - suffix.size());
+    std::string path;
+    for (size_t dash = base.find('-'); dash != std::string::npos; dash = base.find('-', dash + 1))
+        path += base.substr(0, dash) + suffix + "/";
+    return path + slice;
+}
+
+/**
+ * @brief Determine whether unit @p name is running from its cgroup.
+ * @param slice Slice= of the unit ("" = system.slice).
+ * @param cgroup_root Mount point of the cgroup filesystem.
+ */
+inline ServiceState systemd_service_state(const std::string &name, const std::string &slice = std::string(),
+                                          const std::string &cgroup_root = "/sys/fs/cgroup") {
+    ServiceState st;
+    std::string rel = systemd_slice_path(slice.empty() ? "system.slice" : slice);
+    rel = rel.empty() ? name : rel + "/" + name;
+    struct Hierarchy { const char *sub; const char *file; bool events; };
+    static const Hierarchy hierarchies[] = {
+        {"", "cgroup.events", true},           // cgroup v2 (unified)
+        {"/unified", "cgroup.events", true},   // hybrid mode
+        {"/systemd", "cgroup.procs", false},   // cgroup v1 name=systemd
+    };
+    bool have_hierarchy = false;
+    for (const auto &h : hierarchies) {
+        std::string base = cgroup_root + h.sub;
+        struct stat sb;
+        if (stat((base + "/system.slice").c_str(), &sb) != 0) continue;
+        have_hierarchy = true;
+        std::string path = base + "/" + rel + "/" + h.file;
+        std::ifstream ifs(path);
+        if (!ifs) {
+            st.detail = "no cgroup " + base + "/" + rel;
+            return st;
+        }
+        std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        metrics_count_read(data.size());
+        if (h.events) st.active = data.find("populated 1") != std::string::npos;
+        else st.active = data.find_first_not_of(" \n") != std::string::npos;
+        st.detail = st.active ? "cgroup populated" : "cgroup " + base + "/" + rel + " is empty";
+        return st;
+    }
+    if (!have_hierarchy) st.detail = "no systemd cgroup hierarchy under " + cgroup_root;
+    return st;
+}
+
+/** @brief systemd's boolean spelling: 1/yes/y/true/t/on, case-insensitive. */
+inline bool systemd_parse_bool(std::string v) {
+    std::transform(v.begin(), v.end(), v.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return v == "1" || v == "yes" || v == "y" || v == "true" || v == "t" || v == "on";
+}
+
+/**
+ * @brief systemd_service_state() for a loaded @p unit (its Slice= and Type=).
+ *
+ * A Type=oneshot unit with RemainAfterExit=yes stays active after its
+ * process has exited, so an empty cgroup says nothing about it. systemd
+ * keeps the `invocation:<unit>` link in @p units_dir for as long as a unit
+ * is active, which decides it instead; without that directory the state is
+ * reported as not determinable.
+ */
+inline ServiceState systemd_service_state(const std::string &name, const SystemdUnit &unit,
+                                          const std::string &cgroup_root = "/sys/fs/cgroup",
+                                          const std::string &units_dir = "/run/systemd/units") {
+    ServiceState st = systemd_service_state(name, unit.get("Service", "Slice"), cgroup_root);
+    if (st.active || unit.get("Service", "Type") != "oneshot" ||
+        !systemd_parse_bool(unit.get("Service", "RemainAfterExit")))
+        return st;
+    struct stat sb;
+    std::string link = units_dir + "/invocation:" + name;
+#ifdef _WIN32
+    bool linked = false;
+#else
+    bool linked = lstat(link.c_str(), &sb) == 0;  // the link's target is an ID, not a path
+#endif
+    if (linked) {
+        st.active = true;
+        st.detail = "exited, remains active (" + link + ")";
+    } else if (errno == ENOENT && stat(units_dir.c_str(), &sb) == 0) {
+        st.detail = "exited, no " + link;
+    } else {
+        st.determinable = false;
+        st.detail = "state not determinable (Type=oneshot, RemainAfterExit=yes; " + st.detail + ", no " + units_dir + ")";
+    }
+    return st;
+}
+
+/** @brief Plain filesystem access for systemd_load_unit() on the live system. */
+struct SystemdLiveFs {
+    bool read_file(const std::string &path, std::string &out) {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) return false;
+        out.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        metrics_count_read(out.size());
+        return true;
+    }
+    std::vector<std::string> list_dir(const std::string &dir) {
+        std::vector<std::string> names;
+#ifndef _WIN32
+        if (DIR *d = opendir(dir.c_str())) {
+            while (struct dirent *e = readdir(d)) {
+                if (e->d_name[0] == '.' && (e->d_name[1] == 0 || (e->d_name[1] == '.' && e->d_name[2] == 0))) continue;
+                names.emplace_back(e->d_name);
+            }
+            closedir(d);
+        }
+#else
+        (void)dir;
+#endif
+        return names;
+    }
+};
+
+/**
+ * @brief Thread-safe cache of parsed units for the live system.
+ *
+ * An entry is reused while every unit-file candidate and drop-in directory in
+ * the search path still has the same existence, inode, size and mtime, so an
+ * added, removed, replaced or edited file invalidates it.
+ */
+class SystemdUnitCache {
+public:
+    /** @return false if the unit does not exist. */
+    bool load(const std::string &name, SystemdUnit &out) {
+        std::vector<Stamp> now = stamps(name);
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            auto it = cache_.find(name);
+            if (it != cache_.end() && it->second.stamps == now) {
+                out = it->second.unit;
+                return it->second.found;
+            }
+        }
+        SystemdLiveFs fs;
+        Entry e;
+        e.found = systemd_load_unit(fs, name, e.unit);
+        e.stamps = std::move(now);
+        for (const auto &p : e.unit.dropins) e.stamps.push_back(stamp(p));
+        out = e.unit;
+        std::lock_guard<std::mutex> lk(mu_);
+        cache_[name] = std::move(e);
+        return cache_[name].found;
+    }
+
+private:
+    struct Stamp {
+        bool exists = false;
+        unsigned long long ino = 0, size = 0;
+        long long mtime_sec = 0, mtime_nsec = 0;
+        bool operator==(const Stamp &o) const {
+            return exists == o.exists && ino == o.ino && size == o.size && mtime_sec == o.mtime_sec && mtime_nsec == o.mtime_nsec;
+        }
+    };
+    struct Entry {
+        bool found = false;
+        SystemdUnit unit;
+        std::vector<Stamp> stamps;
+    };
+
+    static Stamp stamp(const std::string &path) {
+        Stamp s;
+        struct stat sb;
+        if (stat(path.c_str(), &sb) != 0) return s;
+        s.exists = true;
+        s.ino = static_cast<unsigned long long>(sb.st_ino);
+        s.size = static_cast<unsigned long long>(sb.st_size);
+#if defined(__linux__)
+        s.mtime_sec = sb.st_mtim.tv_sec;
+        s.mtime_nsec = sb.st_mtim.tv_nsec;
+#else
+        s.mtime_sec = static_cast<long long>(sb.st_mtime);
+#endif
+        return s;
+    }
+
+    static std::vector<Stamp> stamps(const std::string &name) {
+        std::vector<Stamp> v;
+        for (const auto &dir : systemd_unit_dirs()) {
+            v.push_back(stamp(dir + "/" + name));
+            v.push_back(stamp(dir + "/" + name + ".d"));  // dir mtime changes when drop-ins come and go
+        }
+        return v;
+    }
+
+    std::mutex mu_;
+    std::unordered_map<std::string, Entry> cache_;
+};
+
+#endif /* OS_SYSTEMD_H */
@@ -0,0 +1,128 @@
+#ifndef OS_WATCH_H
+#define OS_WATCH_H
+
+/**
+ * @file os_watch.h
+ * @brief inotify wrapper used by `os_controlsystem --watch` (Linux only).
+ *
+ * Directories are watched rather than individual files so that editors and
+ * package managers that replace files atomically (write + rename) are seen.
+ * Each watch carries an optional entry-name filter and a bitmask of "input
+ * tags"; poll() returns the union of tags whose filters matched, which the
+ * caller maps to the checks that need re-evaluating. A watched directory that
+ * is deleted or moved away loses its watch; take_lost() tells the caller to
+ * set its watches up again.
+ */
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+class InotifyWatcher {
+public:
+    InotifyWatcher() = default;
+    ~InotifyWatcher() { if (fd_ >= 0) close(fd_); }
+
+    InotifyWatcher(const InotifyWatcher &) = delete;
+    InotifyWatcher &operator=(const InotifyWatcher &) = delete;
+
+    bool init(std::string &err) {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) { err = std::string("inotify_init1: ") + std::strerror(errno); return false; }
+        return true;
+    }
+
+    /**
+     * @brief Watch @p dir for changes to entries named @p name ("" = any entry).
+     * @param tags Bits reported by poll() when a matching event arrives.
+     * @return false (with @p err set) if the directory cannot be watched.
+     */
+    bool watch(const std::string &dir, const std::string &name, unsigned tags, std::string &err) {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE |
+                              IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+        int wd = inotify_add_watch(fd_, dir.c_str(), mask);
+        if (wd < 0) { err = dir + ": " + std::strerror(errno); return false; }
+        auto &w = watches_[wd];
+        w.dir = dir;
+        w.filters.push_back(Filter{name, tags});
+        return true;
+    }
+
+    /** @brief Remove every watch (before setting them up again). */
+    void clear() {
+        for (const auto &w : watches_) inotify_rm_watch(fd_, w.first);
+        watches_.clear();
+    }
+
+    /** @brief Whether a watch was dropped since the last call. */
+    bool take_lost() {
+        bool lost = lost_;
+        lost_ = false;
+        return lost;
+    }
+
+    int fd() const { return fd_; }
+
+    /**
+     * @brief Wait up to @p timeout_ms for events and drain them.
+     * @param changed If non-null, receives "dir/name" for each matching event.
+     * @return Union of tags of matching events; 0 on timeout or interruption.
+     */
+    unsigned poll(int timeout_ms, std::vector<std::string> *changed = nullptr) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        int r = ::poll(&pfd, 1, timeout_ms);
+        if (r <= 0) return 0;
+        unsigned tags = 0;
+        alignas(struct inotify_event) char buf[16384];
+        for (;;) {
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n <= 0) break;
+            for (char *p = buf; p < buf + n;) {
+                auto *ev = reinterpret_cast<struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                auto it = watches_.find(ev->wd);
+                if (it == watches_.end()) continue;
+                std::string entry = ev->len ? std::string(ev->name) : std::string();
+                for (const auto &f : it->second.filters) {
+                    // Events on the directory itself (deleted/moved) match every filter.
+                    if (!f.name.empty() && !entry.empty() && entry != f.name) continue;
+                    tags |= f.tags;
+                    if (changed) changed->push_back(entry.empty() ? it->second.dir : it->second.dir + "/" + entry);
+                }
+                // A moved directory keeps its watch under the old name; drop it like a deleted one.
+                if (ev->mask & IN_MOVE_SELF) inotify_rm_watch(fd_, ev->wd);
+                if (ev->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+                    watches_.erase(it);
+                    lost_ = true;
+                }
+            }
+        }
+        return tags;
+    }
+
+private:
+    struct Filter {
+        std::string name;
+        unsigned tags;
+    };
+    struct Watch {
+        std::string dir;
+        std::vector<Filter> filters;
+    };
+
+    int fd_ = -1;
+    bool lost_ = false;
+    std::unordered_map<int, Watch> watches_;
+};
+
+#endif /* __linux__ */
+
+#endif /* OS_WATCH_H */
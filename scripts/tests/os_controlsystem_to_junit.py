@@ -12,12 +12,17 @@ Usage:
   
 If --input is omitted, the script attempts to run ./os_controlsystem --checks all.
 
+Note: os_controlsystem can emit JUnit XML itself (`--format junit`), which is
+preferred in CI; this converter remains for logs captured in text format.
+
 @details
 Expected input line formats:
   - [sysctl:<key>] OK|MISMATCH expected=.. actual=..
   - [service:exec] OK|MISMATCH ...
   - [service:status] active|inactive
   - [firewall] active and port allowed | port NOT allowed ...
+  - [firewall:<proto>/<port>] OK allowed | NOT allowed: ...
+  - [firewall:policy] OK|MISMATCH expected=.. got=..
   
 Each check is converted to a JUnit testcase; OK results pass, MISMATCH/MISSING fail.
 """
@@ -70,6 +75,14 @@ def parse_output(text):
                 ok = False
             results['service:status'] = {'ok': ok, 'output': line}
             continue
+        # firewall per-port / policy
+        if line.startswith('[firewall:'):
+            end = line.find(']')
+            if end != -1:
+                key = line[len('[firewall:'):end]
+                ok = line[end + 1:].strip().startswith('OK')
+                results[f'firewall:{key}'] = {'ok': ok, 'output': line}
+                continue
         # firewall
         if line.startswith('[firewall]'):
             ok = True if 'active and port allowed' in line else False
@@ -26,9 +26,9 @@ SRC=scripts/c-c++/os_controlsystem.cpp
 if [ ! -x "$BIN" ]; then
   echo "os_controlsystem binary not found, attempting to compile..."
   if command -v g++ >/dev/null 2>&1; then
-    g++ -std=c++17 -O2 -o "$BIN" "$SRC"
+    g++ -std=c++17 -O2 -pthread -o "$BIN" "$SRC"
   elif command -v clang++ >/dev/null 2>&1; then
-    clang++ -std=c++17 -O2 -o "$BIN" "$SRC"
+    clang++ -std=c++17 -O2 -pthread -o "$BIN" "$SRC"
   else
     echo "No C++ compiler found (g++ or clang++). Cannot build os_controlsystem." >&2
     exit 2
@@ -1,81 +1,899 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/time.h>
 #include <time.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
-void class(int sockfd, char *argv[])
+#include "terminal_server.h"
+
+/**
+ * @file os_manager.c
+ * @brief Command-line client for `os_typing --serve`.
+ *
+ * Modes:
+ *   - class, chat: interactive; one line out, whatever arrives back is printed.
+ *   - framed: the server's framed protocol (terminal_server.h). Lines read
+ *     from stdin become requests with increasing IDs; up to WINDOW of them
+ *     are in flight at once, queued requests go out together with writev(),
+ *     and replies are reassembled from partial reads and printed in order.
+ *     Bulk command streams are no longer limited to one line per round trip.
+ *   - bench: open-loop load generator. Replays the commands in FILE over
+ *     CONNS framed connections at a fixed total RATE for SECONDS and reports
+ *     throughput and latency percentiles. Also works against a plain echo
+ *     server, which returns each request frame unchanged. Linux only.
+ */
+
+#define FRAMED_WINDOW   64
+#define READ_CHUNK      65536
+#define BENCH_CONNS     16
+#define BENCH_RATE      1000
+#define BENCH_SECONDS   10
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+void interactive(int sockfd)
 {
-    char buffer[1024];
-    int n;
+    char *line = NULL;
+    size_t cap = 0;
+    char buffer[READ_CHUNK];
+    ssize_t len, n;
     for (;;)
     {
-        bzero(buffer, 1024);
         printf("Client: ");
-        n = 0;
-        while ((buffer[n++] = getchar()) != '\n')
-            ;
-        write(sockfd, buffer, sizeof(buffer));
-        bzero(buffer, 1024);
-        read(sockfd, buffer, sizeof(buffer));
+        fflush(stdout);
+        if ((len = getline(&line, &cap, stdin)) < 0)
+            break;
+        if (line[len - 1] != '\n')
+        {
+            /* the server runs a line once it is terminated */
+            char *p = realloc(line, (size_t)len + 2);
+            if (!p)
+                break;
+            line = p;
+            cap = (size_t)len + 2;
+            line[len++] = '\n';
+            line[len] = '\0';
+        }
+        if (write(sockfd, line, (size_t)len) != len)
+        {
+            perror("ERROR writing to socket");
+            break;
+        }
+        n = read(sockfd, buffer, sizeof(buffer) - 1);
+        if (n <= 0)
+        {
+            printf("Server closed the connection\n");
+            break;
+        }
+        buffer[n] = '\0';
         printf("Server: %s", buffer);
-        if ((strncmp(buffer, "exit", 4)) == 0)
+        if (strncmp(line, "exit", 4) == 0)
         {
             printf("Client Exit...\n");
             break;
         }
     }
+    free(line);
+}
+
+/* ---- framed mode ---------------------------------------------------------- */
+
+struct request
+{
+    unsigned char hdr[TERM_FRAME_HEADER];
+    char *line;
+    size_t len;
+};
+
+struct client
+{
+    int sock;
+    size_t window;
+    char *in;               /* stdin bytes not turned into requests yet */
+    size_t inlen, incap;
+    int in_eof;
+    struct request *queue;  /* requests not completely written, oldest first */
+    size_t qhead, qlen, qcap;
+    size_t sent;            /* bytes of queue[qhead] already written */
+    size_t inflight;        /* queued or sent, not answered */
+    unsigned long next_id, expect_id;
+    char *rbuf;             /* reply bytes not consumed yet */
+    size_t rlen, rcap;
+    int hello;              /* the server acknowledged the framed protocol */
+    int status;             /* last failing reply status */
+};
+
+static int grow(char **buf, size_t *cap, size_t need)
+{
+    if (need <= *cap)
+        return 0;
+    size_t n = *cap ? *cap : READ_CHUNK;
+    while (n < need)
+        n *= 2;
+    char *p = realloc(*buf, n);
+    if (!p)
+        return -1;
+    *buf = p;
+    *cap = n;
+    return 0;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static unsigned long get32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return (unsigned long)u[0] << 24 | (unsigned long)u[1] << 16 | (unsigned long)u[2] << 8 | u[3];
+}
+
+/* Turns complete stdin lines into queued requests while the window has room. */
+static int queue_lines(struct client *c)
+{
+    size_t pos = 0;
+    while (c->inflight < c->window && pos < c->inlen)
+    {
+        char *nl = memchr(c->in + pos, '\n', c->inlen - pos);
+        if (!nl && !c->in_eof)
+            break;
+        size_t end = nl ? (size_t)(nl - c->in) : c->inlen;
+        size_t next = nl ? end + 1 : c->inlen;
+        if (end > pos && c->in[end - 1] == '\r')
+            --end;
+        if (c->qhead + c->qlen == c->qcap)
+        {
+            if (c->qhead)
+            {
+                memmove(c->queue, c->queue + c->qhead, c->qlen * sizeof(*c->queue));
+                c->qhead = 0;
+            }
+            else
+            {
+                size_t cap = c->qcap ? c->qcap * 2 : FRAMED_WINDOW;
+                struct request *q = realloc(c->queue, cap * sizeof(*q));
+                if (!q)
+                    return -1;
+                c->queue = q;
+                c->qcap = cap;
+            }
+        }
+        struct request *r = &c->queue[c->qhead + c->qlen];
+        r->len = end - pos;
+        r->line = malloc(r->len ? r->len : 1);
+        if (!r->line)
+            return -1;
+        memcpy(r->line, c->in + pos, r->len);
+        put32(r->hdr, r->len);
+        put32(r->hdr + 4, c->next_id++);
+        put32(r->hdr + 8, 0);
+        c->qlen++;
+        c->inflight++;
+        pos = next;
+    }
+    if (pos)
+    {
+        memmove(c->in, c->in + pos, c->inlen - pos);
+        c->inlen -= pos;
+    }
+    return 0;
+}
+
+/* Writes as many queued requests as the socket takes, one writev() per batch. */
+static int send_queued(struct client *c)
+{
+    while (c->qlen)
+    {
+        struct iovec iov[IOV_MAX];
+        int n = 0;
+        size_t skip = c->sent;
+        for (size_t i = 0; i < c->qlen && n + 2 <= IOV_MAX; ++i)
+        {
+            struct request *r = &c->queue[c->qhead + i];
+            if (skip < TERM_FRAME_HEADER)
+            {
+                iov[n].iov_base = r->hdr + skip;
+                iov[n++].iov_len = TERM_FRAME_HEADER - skip;
+                skip = 0;
+            }
+            else
+            {
+                skip -= TERM_FRAME_HEADER;
+            }
+            if (r->len > skip)
+            {
+                iov[n].iov_base = r->line + skip;
+                iov[n++].iov_len = r->len - skip;
+            }
+            skip = 0;
+        }
+        ssize_t k = writev(c->sock, iov, n);
+        if (k < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        size_t done = (size_t)k;
+        while (c->qlen && done)
+        {
+            struct request *r = &c->queue[c->qhead];
+            size_t left = TERM_FRAME_HEADER + r->len - c->sent;
+            if (done < left)
+            {
+                c->sent += done;
+                break;
+            }
+            done -= left;
+            free(r->line);
+            c->qhead++;
+            c->qlen--;
+            c->sent = 0;
+        }
+    }
+    c->qhead = 0;
+    return 0;
+}
+
+/* Prints every complete reply in the receive buffer; -1 on a protocol error. */
+static int take_replies(struct client *c)
+{
+    size_t pos = 0;
+    if (!c->hello)
+    {
+        /* Anything before the acknowledgement (a prompt) is not part of the protocol. */
+        char *h = NULL;
+        for (size_t i = 0; i + TERM_FRAME_HELLO_LEN <= c->rlen && !h; ++i)
+            if (memcmp(c->rbuf + i, TERM_FRAME_HELLO, TERM_FRAME_HELLO_LEN) == 0)
+                h = c->rbuf + i;
+        if (!h)
+        {
+            pos = c->rlen > TERM_FRAME_HELLO_LEN ? c->rlen - TERM_FRAME_HELLO_LEN : 0;
+            goto out;
+        }
+        c->hello = 1;
+        pos = (size_t)(h - c->rbuf) + TERM_FRAME_HELLO_LEN;
+    }
+    while (c->rlen - pos >= TERM_FRAME_HEADER)
+    {
+        size_t len = get32(c->rbuf + pos);
+        if (c->rlen - pos - TERM_FRAME_HEADER < len)
+            break;
+        unsigned long id = get32(c->rbuf + pos + 4);
+        int status = (int)get32(c->rbuf + pos + 8);
+        if (id != (c->expect_id & 0xffffffffUL) || c->inflight == 0)
+        {
+            fprintf(stderr, "Reply %lu does not match request %lu\n", id, c->expect_id);
+            return -1;
+        }
+        fwrite(c->rbuf + pos + TERM_FRAME_HEADER, 1, len, stdout);
+        if (status)
+            c->status = status;
+        c->expect_id++;
+        c->inflight--;
+        pos += TERM_FRAME_HEADER + len;
+    }
+out:
+    if (pos)
+    {
+        memmove(c->rbuf, c->rbuf + pos, c->rlen - pos);
+        c->rlen -= pos;
+    }
+    return 0;
+}
+
+/*
+ * Streams stdin to the server as pipelined requests and prints the replies.
+ * Returns the last failing command status, or 1 on connection errors.
+ */
+int framed(int sockfd, size_t window)
+{
+    struct client c;
+    memset(&c, 0, sizeof(c));
+    c.sock = sockfd;
+    c.window = window ? window : FRAMED_WINDOW;
+    int one = 1, ret = 0;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    if (write(sockfd, TERM_FRAME_HELLO, TERM_FRAME_HELLO_LEN) != TERM_FRAME_HELLO_LEN)
+    {
+        perror("ERROR writing to socket");
+        return 1;
+    }
+
+    while (!c.in_eof || c.inlen || c.inflight)
+    {
+        if (queue_lines(&c) != 0 || send_queued(&c) != 0)
+        {
+            perror("ERROR sending requests");
+            ret = 1;
+            break;
+        }
+        struct pollfd pfd[2];
+        pfd[0].fd = !c.in_eof && c.inflight < c.window ? STDIN_FILENO : -1;
+        pfd[0].events = POLLIN;
+        pfd[1].fd = sockfd;
+        pfd[1].events = POLLIN | (c.qlen ? POLLOUT : 0);
+        fflush(stdout);
+        if (poll(pfd, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("ERROR poll");
+            ret = 1;
+            break;
+        }
+        if (pfd[0].revents)
+        {
+            if (grow(&c.in, &c.incap, c.inlen + READ_CHUNK) != 0)
+            {
+                ret = 1;
+                break;
+            }
+            ssize_t n = read(STDIN_FILENO, c.in + c.inlen, READ_CHUNK);
+            if (n > 0)
+                c.inlen += (size_t)n;
+            else if (n == 0 || errno != EINTR)
+                c.in_eof = 1;
+        }
+        if (pfd[1].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            if (grow(&c.rbuf, &c.rcap, c.rlen + READ_CHUNK) != 0)
+            {
+                ret = 1;
+                break;
+            }
+            ssize_t n = read(sockfd, c.rbuf + c.rlen, READ_CHUNK);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            if (n <= 0)
+            {
+                if (c.inflight)
+                {
+                    fprintf(stderr, "Server closed the connection with %zu request(s) unanswered\n", c.inflight);
+                    ret = 1;
+                }
+                break;
+            }
+            c.rlen += (size_t)n;
+            if (take_replies(&c) != 0)
+            {
+                ret = 1;
+                break;
+            }
+        }
+    }
+    fflush(stdout);
+    for (size_t i = 0; i < c.qlen; ++i)
+        free(c.queue[c.qhead + i].line);
+    free(c.queue);
+    free(c.in);
+    free(c.rbuf);
+    return ret ? ret : c.status;
+}
+
+/* ---- bench mode ----------------------------------------------------------- */
+
+#ifdef __linux__
+
+/*
+ * Latency histogram with HdrHistogram-style buckets: exact below 128 ns,
+ * then 64 linear sub-buckets per power of two (under 1.6% error) up to
+ * 2^63 ns.
+ */
+#define HIST_BUCKETS (64 * 60)
+
+struct histogram
+{
+    unsigned long long counts[HIST_BUCKETS];
+    unsigned long long total, max;
+};
+
+static size_t hist_index(unsigned long long v)
+{
+    if (v < 128)
+        return (size_t)v;
+    int shift = 63 - __builtin_clzll(v) - 6;
+    return (size_t)(64 * shift + (v >> shift));
+}
+
+/* Highest value that falls into bucket @p i. */
+static unsigned long long hist_value(size_t i)
+{
+    if (i < 128)
+        return i;
+    int shift = (int)(i / 64) - 1;
+    return ((i - 64 * (unsigned long long)shift + 1) << shift) - 1;
+}
+
+static void hist_add(struct histogram *h, unsigned long long v)
+{
+    h->counts[hist_index(v)]++;
+    h->total++;
+    if (v > h->max)
+        h->max = v;
+}
+
+static unsigned long long hist_percentile(const struct histogram *h, double q)
+{
+    unsigned long long rank = (unsigned long long)(q * (double)h->total + 0.999999), seen = 0;
+    if (rank < 1)
+        rank = 1;
+    for (size_t i = 0; i < HIST_BUCKETS; ++i)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+            return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+struct bench_conn
+{
+    int fd;
+    int connected, dead;
+    int hello;
+    char *out;                  /* frames not written yet */
+    size_t outoff, outlen, outcap;
+    char *in;                   /* reply bytes not consumed yet */
+    size_t inlen, incap;
+    unsigned long long *due;    /* intended send times of the requests in flight, oldest first */
+    size_t head, count, cap;
+    unsigned long next_id, expect_id;
+};
+
+struct bench
+{
+    struct bench_conn *conns;
+    int nconns, ep;
+    char **lines;               /* command file */
+    size_t *lens, nlines;
+    struct histogram latency;   /* reply time minus intended send time */
+    unsigned long long sent, completed, errors, max_lag;
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ULL + (unsigned long long)t.tv_nsec;
+}
+
+static void bench_watch(struct bench *b, struct bench_conn *c)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (c->outlen || !c->connected ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(b->ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/* Drops a failed connection; its requests in flight count as errors. */
+static void bench_kill(struct bench *b, struct bench_conn *c)
+{
+    if (c->dead)
+        return;
+    c->dead = 1;
+    b->errors += c->count;
+    c->count = 0;
+    close(c->fd);
+}
+
+static void bench_flush(struct bench *b, struct bench_conn *c)
+{
+    while (c->outlen)
+    {
+        ssize_t k = send(c->fd, c->out + c->outoff, c->outlen, MSG_NOSIGNAL);
+        if (k < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                bench_kill(b, c);
+            break;
+        }
+        c->outoff += (size_t)k;
+        c->outlen -= (size_t)k;
+    }
+    if (!c->outlen)
+        c->outoff = 0;
+}
+
+static int bench_append(struct bench_conn *c, const void *p, size_t n)
+{
+    if (c->outoff && c->outoff + c->outlen + n > c->outcap)
+    {
+        memmove(c->out, c->out + c->outoff, c->outlen);
+        c->outoff = 0;
+    }
+    if (grow(&c->out, &c->outcap, c->outoff + c->outlen + n) != 0)
+        return -1;
+    memcpy(c->out + c->outoff + c->outlen, p, n);
+    c->outlen += n;
+    return 0;
+}
+
+/* Queues request number @p k (due at @p due) on its connection and writes what the socket takes. */
+static void bench_send(struct bench *b, unsigned long long k, unsigned long long due)
+{
+    struct bench_conn *c = &b->conns[k % (unsigned long long)b->nconns];
+    size_t line = (size_t)(k % b->nlines);
+    unsigned char hdr[TERM_FRAME_HEADER];
+    b->sent++;
+    if (c->dead || !c->connected)
+    {
+        b->errors++;
+        return;
+    }
+    if (c->count == c->cap)
+    {
+        size_t cap = c->cap ? c->cap * 2 : 64;
+        unsigned long long *d = malloc(cap * sizeof(*d));
+        if (!d)
+        {
+            b->errors++;
+            return;
+        }
+        for (size_t i = 0; i < c->count; ++i)
+            d[i] = c->due[(c->head + i) % c->cap];
+        free(c->due);
+        c->due = d;
+        c->head = 0;
+        c->cap = cap;
+    }
+    put32(hdr, b->lens[line]);
+    put32(hdr + 4, c->next_id++);
+    put32(hdr + 8, 0);
+    int was_idle = c->outlen == 0;
+    if (bench_append(c, hdr, sizeof(hdr)) != 0 || bench_append(c, b->lines[line], b->lens[line]) != 0)
+    {
+        bench_kill(b, c);
+        return;
+    }
+    c->due[(c->head + c->count++) % c->cap] = due;
+    bench_flush(b, c);
+    if (!c->dead && was_idle != (c->outlen == 0))
+        bench_watch(b, c);
+}
+
+/* Takes the complete replies off @p c and records their latency. */
+static void bench_replies(struct bench *b, struct bench_conn *c, unsigned long long now)
+{
+    size_t pos = 0;
+    if (!c->hello)
+    {
+        if (c->inlen < TERM_FRAME_HELLO_LEN)
+            return;
+        if (memcmp(c->in, TERM_FRAME_HELLO, TERM_FRAME_HELLO_LEN) != 0)
+        {
+            fprintf(stderr, "bench: the server does not speak the framed protocol\n");
+            bench_kill(b, c);
+            return;
+        }
+        c->hello = 1;
+        pos = TERM_FRAME_HELLO_LEN;
+    }
+    while (c->inlen - pos >= TERM_FRAME_HEADER)
+    {
+        size_t len = get32(c->in + pos);
+        if (c->inlen - pos - TERM_FRAME_HEADER < len)
+            break;
+        if (get32(c->in + pos + 4) != (c->expect_id & 0xffffffffUL) || c->count == 0)
+        {
+            fprintf(stderr, "bench: reply out of order on a connection\n");
+            bench_kill(b, c);
+            return;
+        }
+        unsigned long long due = c->due[c->head];
+        c->head = (c->head + 1) % c->cap;
+        c->count--;
+        c->expect_id++;
+        hist_add(&b->latency, now > due ? now - due : 0);
+        b->completed++;
+        pos += TERM_FRAME_HEADER + len;
+    }
+    if (pos)
+    {
+        memmove(c->in, c->in + pos, c->inlen - pos);
+        c->inlen -= pos;
+    }
 }
 
-void chat(int sockfd, char *argv[])
+static void bench_readable(struct bench *b, struct bench_conn *c)
 {
-    char buffer[1024];
-    int n;
     for (;;)
     {
-        bzero(buffer, 1024);
-        printf("Client: ");
-        n = 0;
-        while ((buffer[n++] = getchar()) != '\n')
-            ;
-        write(sockfd, buffer, sizeof(buffer));
-        bzero(buffer, 1024);
-        read(sockfd, buffer, sizeof(buffer));
-        printf("Server: %s", buffer);
-        if ((strncmp(buffer, "exit", 4)) == 0)
+        if (grow(&c->in, &c->incap, c->inlen + READ_CHUNK) != 0)
         {
-            printf("Client Exit...\n");
+            bench_kill(b, c);
+            return;
+        }
+        ssize_t n = recv(c->fd, c->in + c->inlen, READ_CHUNK, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n <= 0)
+        {
+            bench_kill(b, c);
+            return;
+        }
+        c->inlen += (size_t)n;
+        bench_replies(b, c, now_ns());
+        if (c->dead || (size_t)n < READ_CHUNK)
+            return;
+    }
+}
+
+static int load_lines(struct bench *b, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    char *line = NULL;
+    size_t cap = 0, alloc = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) >= 0)
+    {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if (len == 0)
+            continue;
+        if (b->nlines == alloc)
+        {
+            alloc = alloc ? alloc * 2 : 256;
+            char **l = realloc(b->lines, alloc * sizeof(*l));
+            size_t *n = realloc(b->lens, alloc * sizeof(*n));
+            if (l)
+                b->lines = l;
+            if (n)
+                b->lens = n;
+            if (!l || !n)
+                break;
+        }
+        b->lens[b->nlines] = (size_t)len;
+        if (!(b->lines[b->nlines] = strdup(line)))
             break;
+        b->nlines++;
+    }
+    free(line);
+    fclose(f);
+    if (b->nlines == 0)
+    {
+        fprintf(stderr, "%s: no commands to replay\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Open-loop load test: request k is due at start + k / rate and goes out on
+ * connection k % nconns whether or not earlier replies have arrived, and its
+ * latency is measured from that due time. A server (or client) that falls
+ * behind therefore shows up in the percentiles instead of quietly lowering
+ * the offered load (coordinated omission).
+ */
+int bench(const struct sockaddr_in *addr, const char *path, int nconns, double rate, double seconds)
+{
+    struct bench b;
+    memset(&b, 0, sizeof(b));
+    int ret = 1, tfd = -1;
+    if (nconns < 1 || rate <= 0 || seconds <= 0)
+    {
+        fprintf(stderr, "bench: connections, rate and duration must be positive\n");
+        return 1;
+    }
+    if (load_lines(&b, path) != 0)
+        goto out;
+    b.nconns = nconns;
+    b.conns = calloc((size_t)nconns, sizeof(*b.conns));
+    b.ep = epoll_create1(EPOLL_CLOEXEC);
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (!b.conns || b.ep < 0 || tfd < 0)
+    {
+        perror("bench");
+        goto out;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(b.ep, EPOLL_CTL_ADD, tfd, &ev);
+
+    /* Connect everything first; the clock starts once all connections are up. */
+    int pending = 0;
+    for (int i = 0; i < nconns; ++i)
+    {
+        struct bench_conn *c = &b.conns[i];
+        c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (c->fd < 0)
+        {
+            perror("bench: socket");
+            c->dead = 1;
+            continue;
         }
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(c->fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0 && errno != EINPROGRESS)
+        {
+            perror("bench: connect");
+            bench_kill(&b, c);
+            continue;
+        }
+        ev.events = EPOLLOUT;
+        ev.data.ptr = c;
+        epoll_ctl(b.ep, EPOLL_CTL_ADD, c->fd, &ev);
+        pending++;
+    }
+    struct epoll_event evs[256];
+    unsigned long long deadline = now_ns() + 5000000000ULL;
+    while (pending > 0 && now_ns() < deadline)
+    {
+        int n = epoll_wait(b.ep, evs, 256, 100);
+        for (int i = 0; i < n; ++i)
+        {
+            struct bench_conn *c = evs[i].data.ptr;
+            if (!c || c->connected || c->dead)
+                continue;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            pending--;
+            if (err)
+            {
+                fprintf(stderr, "bench: connect: %s\n", strerror(err));
+                bench_kill(&b, c);
+                continue;
+            }
+            c->connected = 1;
+            bench_append(c, TERM_FRAME_HELLO, TERM_FRAME_HELLO_LEN);
+            bench_flush(&b, c);
+            bench_watch(&b, c);
+        }
+    }
+    int up = 0;
+    for (int i = 0; i < nconns; ++i)
+        up += b.conns[i].connected && !b.conns[i].dead;
+    if (up == 0)
+    {
+        fprintf(stderr, "bench: no connection could be established\n");
+        goto out;
     }
+
+    unsigned long long total = (unsigned long long)(rate * seconds);
+    double interval = 1e9 / rate;
+    unsigned long long start = now_ns(), k = 0;
+    deadline = start + (unsigned long long)(seconds * 1e9) + 5000000000ULL;   /* 5 s to drain */
+    for (;;)
+    {
+        unsigned long long now = now_ns();
+        while (k < total && start + (unsigned long long)((double)k * interval) <= now)
+        {
+            unsigned long long due = start + (unsigned long long)((double)k * interval);
+            if (now - due > b.max_lag)
+                b.max_lag = now - due;
+            bench_send(&b, k++, due);
+        }
+        if (k == total && b.completed + b.errors >= b.sent)
+            break;
+        if (now >= deadline)
+        {
+            b.errors += b.sent - b.completed - b.errors;
+            fprintf(stderr, "bench: replies still missing after the drain period\n");
+            break;
+        }
+        if (k < total)
+        {
+            struct itimerspec its;
+            unsigned long long next = start + (unsigned long long)((double)k * interval);
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec = (time_t)(next / 1000000000ULL);
+            its.it_value.tv_nsec = (long)(next % 1000000000ULL);
+            timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+        }
+        int n = epoll_wait(b.ep, evs, 256, k < total ? -1 : 100);
+        for (int i = 0; i < n; ++i)
+        {
+            struct bench_conn *c = evs[i].data.ptr;
+            if (!c)
+            {
+                unsigned long long expirations;
+                ssize_t r = read(tfd, &expirations, sizeof(expirations));
+                (void)r;
+                continue;
+            }
+            if (c->dead)
+                continue;
+            if (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                bench_readable(&b, c);
+            if (!c->dead && (evs[i].events & EPOLLOUT) && c->outlen)
+            {
+                bench_flush(&b, c);
+                if (!c->dead && !c->outlen)
+                    bench_watch(&b, c);
+            }
+        }
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    printf("bench: %d connection(s), %zu command(s), target %.0f req/s for %.1f s\n", up, b.nlines, rate, seconds);
+    printf("sent %llu  completed %llu  errors %llu  throughput %.1f req/s  max send lag %.1f us\n", b.sent,
+           b.completed, b.errors, elapsed > 0 ? (double)b.completed / elapsed : 0, (double)b.max_lag / 1e3);
+    if (b.latency.total)
+        printf("latency from intended send: p50 %.1f us  p99 %.1f us  p99.9 %.1f us  max %.1f us\n",
+               (double)hist_percentile(&b.latency, 0.50) / 1e3, (double)hist_percentile(&b.latency, 0.99) / 1e3,
+               (double)hist_percentile(&b.latency, 0.999) / 1e3, (double)b.latency.max / 1e3);
+    ret = b.errors ? 1 : 0;
+
+out:
+    for (int i = 0; b.conns && i < nconns; ++i)
+    {
+        if (!b.conns[i].dead)
+            close(b.conns[i].fd);
+        free(b.conns[i].out);
+        free(b.conns[i].in);
+        free(b.conns[i].due);
+    }
+    free(b.conns);
+    for (size_t i = 0; i < b.nlines; ++i)
+        free(b.lines[i]);
+    free(b.lines);
+    free(b.lens);
+    if (tfd >= 0)
+        close(tfd);
+    if (b.ep >= 0)
+        close(b.ep);
+    return ret;
 }
 
+#else /* !__linux__ */
+
+int bench(const struct sockaddr_in *addr, const char *path, int nconns, double rate, double seconds)
+{
+    (void)addr; (void)path; (void)nconns; (void)rate; (void)seconds;
+    fprintf(stderr, "bench: needs epoll (Linux)\n");
+    return 1;
+}
+
+#endif
+
 int main(int argc, char *argv[])
 {
-    int sockfd, portno;
+    int sockfd, portno, ret = 0;
     struct sockaddr_in serv_addr;
     struct hostent *server;
 
     if (argc < 4)
     {
-        fprintf(stderr, "usage %s hostname port class/chat\n", argv[0]);
+        fprintf(stderr, "usage %s hostname port class/chat/framed [window]\n"
+                        "      %s hostname port bench file [conns] [rate] [seconds]\n", argv[0], argv[0]);
         exit(0);
     }
 
     portno = atoi(argv[2]);
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0)
-    {
-        perror("ERROR opening socket");
-        exit(1);
-    }
-
     server = gethostbyname(argv[1]);
     if (server == NULL)
     {
@@ -83,56 +901,48 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
-    bzero((char *)&serv_addr, sizeof(serv_addr));
+    memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
-    bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length);
+    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, (size_t)server->h_length);
     serv_addr.sin_port = htons(portno);
 
+    if (strcmp(argv[3], "bench") == 0)
+    {
+        if (argc < 5)
+        {
+            fprintf(stderr, "bench needs a command file\n");
+            exit(1);
+        }
+        return bench(&serv_addr, argv[4], argc > 5 ? atoi(argv[5]) : BENCH_CONNS,
+                     argc > 6 ? strtod(argv[6], NULL) : BENCH_RATE, argc > 7 ? strtod(argv[7], NULL) : BENCH_SECONDS);
+    }
+
+    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0)
+    {
+        perror("ERROR opening socket");
+        exit(1);
+    }
+
     if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
     {
         perror("ERROR connecting");
         exit(1);
     }
 
-    if (strcmp(argv[3], "class") == 0)
+    if (strcmp(argv[3], "class") == 0 || strcmp(argv[3], "chat") == 0)
     {
-        class(sockfd, argv);
+        interactive(sockfd);
     }
-    else if (strcmp(argv[3], "chat") == 0)
+    else if (strcmp(argv[3], "framed") == 0)
     {
-        chat(sockfd, argv);
+        ret = framed(sockfd, argc > 4 ? strtoul(argv[4], NULL, 10) : FRAMED_WINDOW);
     }
     else
     {
-        fprintf(stderr, "Invalid mode. Use 'class' or 'chat'.\n");
+        fprintf(stderr, "Invalid mode. Use 'class', 'chat', 'framed' or 'bench'.\n");
     }
 
     close(sockfd);
-    return 0;
+    return ret;
 }
-
-if ('condition')
-{
-    /**
-     * @param {type} name description
-     * @return {type} description
-     * @addtogroup {groupName} data
-     * @brief {briefDescription}
-     */
-}
-else
-{
-    for (size_t i = 0; i < count; i++)
-    {
-        while (static_assert)
-        {
-            cout << "This is a static assert example." << endl;
-            std::cout<< "Static assert passed." << std::endl;
-            return 0;
-            break;
-        }
-        
-    }
-    
-}
-
@@ -1,9 +1,25 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* fopencookie */
+#endif
+
 #include "terminal.h"
+#include "terminal_history.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 /**
  * @file terminal.c
@@ -11,7 +27,7 @@
  * 
  * Provides a portable line-based interface for applications to expose
  * pluggable commands. Handles input parsing, tokenization, and dispatch
- * to registered command handlers.
+ * to registered command handlers through a term_registry.
  */
 
 /**
@@ -49,11 +65,1119 @@ int terminal_find_cmd(const struct term_cmd *cmds, int ncmds, const char *name)
     return -1;
 }
 
+/* ---- command registry ---------------------------------------------------- */
+
+/* Trie node; the children of a node are a sibling list sorted by character. */
+struct trie_node {
+    int child;          /* first child, -1 if none */
+    int sibling;        /* next sibling, -1 if none */
+    int cmd;            /* index into cmds of the command ending here, -1 if none */
+    int count;          /* commands in this subtree */
+    int any;            /* some command in this subtree (the only one if count == 1) */
+    unsigned char ch;
+};
+
+struct hash_slot {
+    uint32_t hash;
+    int cmd;            /* -1 = empty */
+};
+
+struct term_registry {
+    const struct term_cmd *cmds;
+    int count;
+    struct hash_slot *slots;
+    size_t mask;
+    struct trie_node *nodes;
+    int nnodes, capnodes;
+};
+
+static uint32_t name_hash(const char *s) {
+    uint32_t h = 2166136261u;   /* FNV-1a */
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static const struct hash_slot *hash_lookup(const struct term_registry *reg, const char *name) {
+    uint32_t h = name_hash(name);
+    for (size_t i = h & reg->mask;; i = (i + 1) & reg->mask) {
+        const struct hash_slot *slot = &reg->slots[i];
+        if (slot->cmd < 0) return slot;
+        if (slot->hash == h && strcmp(reg->cmds[slot->cmd].name, name) == 0) return slot;
+    }
+}
+
+static int trie_new_node(struct term_registry *reg, unsigned char ch) {
+    if (reg->nnodes == reg->capnodes) {
+        int cap = reg->capnodes ? reg->capnodes * 2 : 64;
+        struct trie_node *n = (struct trie_node *)realloc(reg->nodes, (size_t)cap * sizeof(*n));
+        if (!n) return -1;
+        reg->nodes = n;
+        reg->capnodes = cap;
+    }
+    struct trie_node *n = &reg->nodes[reg->nnodes];
+    n->child = n->sibling = n->cmd = n->any = -1;
+    n->count = 0;
+    n->ch = ch;
+    return reg->nnodes++;
+}
+
+/* Child of @p node for @p ch, created in sorted position if @p create; -1 if absent. */
+static int trie_child(struct term_registry *reg, int node, unsigned char ch, int create) {
+    int prev = -1, cur = reg->nodes[node].child;
+    while (cur >= 0 && reg->nodes[cur].ch < ch) {
+        prev = cur;
+        cur = reg->nodes[cur].sibling;
+    }
+    if (cur >= 0 && reg->nodes[cur].ch == ch) return cur;
+    if (!create) return -1;
+    int n = trie_new_node(reg, ch);   /* may move reg->nodes */
+    if (n < 0) return -1;
+    reg->nodes[n].sibling = cur;
+    if (prev >= 0) reg->nodes[prev].sibling = n;
+    else reg->nodes[node].child = n;
+    return n;
+}
+
+static int trie_insert(struct term_registry *reg, const char *name, int cmd) {
+    int node = 0;
+    for (const char *p = name;; ++p) {
+        reg->nodes[node].count++;
+        if (reg->nodes[node].any < 0) reg->nodes[node].any = cmd;
+        if (*p == '\0') break;
+        node = trie_child(reg, node, (unsigned char)*p, 1);
+        if (node < 0) return -1;
+    }
+    reg->nodes[node].cmd = cmd;
+    return 0;
+}
+
+/* Node reached by @p prefix, or -1. */
+static int trie_find(const struct term_registry *reg, const char *prefix) {
+    int node = 0;
+    for (const char *p = prefix; *p && node >= 0; ++p)
+        node = trie_child((struct term_registry *)reg, node, (unsigned char)*p, 0);
+    return node;
+}
+
+struct term_registry *term_registry_new(const struct term_cmd *cmds, int ncmds) {
+    if (ncmds < 0) {
+        ncmds = 0;
+        while (cmds[ncmds].name) ++ncmds;
+    }
+    struct term_registry *reg = (struct term_registry *)calloc(1, sizeof(*reg));
+    if (!reg) return NULL;
+    reg->cmds = cmds;
+    size_t size = 8;
+    while (size < (size_t)ncmds * 2) size *= 2;
+    reg->mask = size - 1;
+    reg->slots = (struct hash_slot *)malloc(size * sizeof(*reg->slots));
+    if (!reg->slots || trie_new_node(reg, 0) < 0) {
+        term_registry_free(reg);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; ++i) reg->slots[i].cmd = -1;
+
+    for (int i = 0; i < ncmds; ++i) {
+        const char *name = cmds[i].name;
+        if (!name || !*name) continue;
+        struct hash_slot *slot = (struct hash_slot *)hash_lookup(reg, name);
+        if (slot->cmd >= 0) continue;   /* duplicate: the first entry wins */
+        slot->hash = name_hash(name);
+        slot->cmd = i;
+        if (trie_insert(reg, name, i) != 0) {
+            term_registry_free(reg);
+            return NULL;
+        }
+        reg->count++;
+    }
+    return reg;
+}
+
+void term_registry_free(struct term_registry *reg) {
+    if (!reg) return;
+    free(reg->slots);
+    free(reg->nodes);
+    free(reg);
+}
+
+int term_registry_count(const struct term_registry *reg) {
+    return reg->count;
+}
+
+const struct term_cmd *term_registry_find(const struct term_registry *reg, const char *name) {
+    const struct hash_slot *slot = hash_lookup(reg, name);
+    return slot->cmd >= 0 ? &reg->cmds[slot->cmd] : NULL;
+}
+
+const struct term_cmd *term_registry_resolve(const struct term_registry *reg, const char *name, int *nmatches) {
+    const struct term_cmd *cmd = term_registry_find(reg, name);
+    int node = cmd ? -1 : trie_find(reg, name);
+    int n = cmd ? 1 : node >= 0 ? reg->nodes[node].count : 0;
+    if (nmatches) *nmatches = n;
+    if (cmd) return cmd;
+    return n == 1 ? &reg->cmds[reg->nodes[node].any] : NULL;
+}
+
+static int trie_walk(const struct term_registry *reg, int node, int (*fn)(const struct term_cmd *, void *),
+                     void *arg, int *listed) {
+    const struct trie_node *n = &reg->nodes[node];
+    if (n->cmd >= 0) {
+        ++*listed;
+        if (fn(&reg->cmds[n->cmd], arg) != 0) return 1;
+    }
+    for (int c = n->child; c >= 0; c = reg->nodes[c].sibling)
+        if (trie_walk(reg, c, fn, arg, listed)) return 1;
+    return 0;
+}
+
+int term_registry_complete(const struct term_registry *reg, const char *prefix,
+                           int (*fn)(const struct term_cmd *cmd, void *arg), void *arg) {
+    int node = trie_find(reg, prefix);
+    int listed = 0;
+    if (node >= 0) trie_walk(reg, node, fn, arg, &listed);
+    return listed;
+}
+
+/* ---- output streams ------------------------------------------------------- */
+
+#if defined(_MSC_VER)
+#define TERM_THREAD_LOCAL __declspec(thread)
+#else
+#define TERM_THREAD_LOCAL _Thread_local
+#endif
+
+/* Per-thread so that server workers, jobs and pipeline stages each get their own. */
+static TERM_THREAD_LOCAL FILE *tl_in;
+static TERM_THREAD_LOCAL FILE *tl_out;
+static TERM_THREAD_LOCAL FILE *tl_err;
+/*
+ * The stream the last handler wrote to (stdout for legacy handlers,
+ * term_out() otherwise), which may still buffer its output. It is flushed
+ * only when the next handler writes to the other one, so a run of legacy
+ * handlers in batch mode is not flushed line by line.
+ */
+static TERM_THREAD_LOCAL FILE *tl_unflushed;
+
+/* Called before a handler writes to @p to: keeps its output after the previous handler's. */
+static void switch_output(FILE *to) {
+    if (tl_unflushed && tl_unflushed != to) fflush(tl_unflushed);
+    tl_unflushed = to;
+}
+
+FILE *term_in(void) {
+    return tl_in ? tl_in : stdin;
+}
+
+FILE *term_out(void) {
+    return tl_out ? tl_out : stdout;
+}
+
+FILE *term_err(void) {
+    return tl_err ? tl_err : stderr;
+}
+
+void term_set_output(FILE *out, FILE *err) {
+    tl_out = out;
+    tl_err = err;
+}
+
+void term_set_input(FILE *in) {
+    tl_in = in;
+}
+
+/* ---- REPL loop ------------------------------------------------------------ */
+
+static int print_candidate(const struct term_cmd *cmd, void *arg) {
+    int *first = (int *)arg;
+    fprintf(term_err(), "%s%s", *first ? "" : ", ", cmd->name);
+    *first = 0;
+    return 0;
+}
+
 int terminal_run(const char *prompt, const struct term_cmd *cmds, int ncmds) {
+    struct term_registry *reg = term_registry_new(cmds, ncmds);
+    if (!reg) {
+        fputs("terminal: out of memory\n", stderr);
+        return -1;
+    }
+    int ret = terminal_run_registry(prompt, reg);
+    term_registry_free(reg);
+    return ret;
+}
+
+/* ---- tokenizer ------------------------------------------------------------ */
+
+void term_args_free(struct term_args *args) {
+    free(args->argv);
+    args->argv = NULL;
+    args->argc = 0;
+    args->cap = 0;
+}
+
+static int args_push(struct term_args *args, char *arg) {
+    if ((size_t)args->argc + 1 >= args->cap) {
+        size_t cap = args->cap ? args->cap * 2 : 32;
+        char **argv = (char **)realloc(args->argv, cap * sizeof(*argv));
+        if (!argv) return -1;
+        args->argv = argv;
+        args->cap = cap;
+    }
+    args->argv[args->argc++] = arg;
+    args->argv[args->argc] = NULL;
+    return 0;
+}
+
+int term_tokenize(char *line, struct term_args *args, const char **err) {
+    char *r = line, *w = line;
+    args->argc = 0;
+    if (args->argv) args->argv[0] = NULL;
+    for (;;) {
+        while (*r == ' ' || *r == '\t' || *r == '\r' || *r == '\n') ++r;
+        if (*r == '\0') return args->argc;
+
+        /* Unquote into the same buffer: w never overtakes r. */
+        char *arg = w;
+        char quote = 0;
+        while (*r && (quote || (*r != ' ' && *r != '\t' && *r != '\r' && *r != '\n'))) {
+            char c = *r++;
+            if (quote == '\'') {
+                if (c == '\'') quote = 0;
+                else *w++ = c;
+            } else if (c == '\\') {
+                /* in double quotes only \" and \\ are escapes */
+                if (*r && (!quote || *r == '"' || *r == '\\')) c = *r++;
+                *w++ = c;
+            } else if (quote == '"') {
+                if (c == '"') quote = 0;
+                else *w++ = c;
+            } else if (c == '\'' || c == '"') {
+                quote = c;
+            } else {
+                *w++ = c;
+            }
+        }
+        if (quote) {
+            if (err) *err = quote == '"' ? "unterminated double quote" : "unterminated single quote";
+            return -1;
+        }
+        /* Step over the separator first: the terminator may overwrite it. */
+        if (*r) ++r;
+        *w++ = '\0';
+        if (args_push(args, arg) != 0) {
+            if (err) *err = "out of memory";
+            return -1;
+        }
+    }
+}
+
+/* ---- background jobs ------------------------------------------------------ */
+
+#ifndef _WIN32
+#define TERM_HAVE_JOBS 1
+#include <pthread.h>
+#else
+#define TERM_HAVE_JOBS 0
+#endif
+
+#if TERM_HAVE_JOBS
+
+#define JOB_THREADS 8   /* most background jobs at once; more are queued */
+
+enum job_state { JOB_QUEUED, JOB_RUNNING, JOB_DONE };
+
+struct job_pool;
+
+struct term_job {
+    int id;
+    struct job_pool *pool;
+    const struct term_cmd *cmd;
+    int argc;
+    char **argv;                /* copy of the arguments; the strings follow the array */
+    enum job_state state;
+    int status;
+    int cancelled;
+    char *out;                  /* captured term_out()/term_err() output */
+    size_t outlen;
+    struct term_job *next;      /* session list, by id */
+    struct term_job *qnext;     /* run queue */
+};
+
+/* Worker threads and jobs of one session, created on the first `&`. */
+struct job_pool {
+    pthread_mutex_t mu;
+    pthread_cond_t work;        /* queue not empty, or shutdown */
+    pthread_cond_t done;        /* some job finished */
+    pthread_t threads[JOB_THREADS];
+    int nthreads, idle;
+    int queued;                 /* jobs in the run queue */
+    struct term_job *jobs;      /* not yet reported, in id order */
+    struct term_job *qhead, *qtail;
+    int next_id;
+    int finished;               /* jobs done but not yet reported */
+    int shutdown;
+};
+
+static TERM_THREAD_LOCAL struct term_job *tl_job;
+
+bool term_job_cancelled(void) {
+    struct term_job *j = tl_job;
+    if (!j) return false;
+    pthread_mutex_lock(&j->pool->mu);
+    int c = j->cancelled;
+    pthread_mutex_unlock(&j->pool->mu);
+    return c != 0;
+}
+
+static void *job_worker(void *arg) {
+    struct job_pool *p = (struct job_pool *)arg;
+    pthread_mutex_lock(&p->mu);
+    for (;;) {
+        while (!p->qhead && !p->shutdown) pthread_cond_wait(&p->work, &p->mu);
+        struct term_job *j = p->qhead;
+        if (!j) break;
+        p->qhead = j->qnext;
+        if (!p->qhead) p->qtail = NULL;
+        p->queued--;
+        j->state = JOB_RUNNING;
+        p->idle--;
+        pthread_mutex_unlock(&p->mu);
+
+        char *buf = NULL;
+        size_t len = 0;
+        FILE *f = open_memstream(&buf, &len);
+        term_set_output(f, f);      /* NULL (out of memory) prints directly */
+        tl_job = j;
+        int r = j->cmd->fn(j->argc, j->argv, j->cmd->ctx);
+        tl_job = NULL;
+        term_set_output(NULL, NULL);
+        if (f) fclose(f);
+
+        pthread_mutex_lock(&p->mu);
+        j->status = r;
+        j->out = buf;
+        j->outlen = len;
+        j->state = JOB_DONE;
+        p->finished++;
+        p->idle++;
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->mu);
+    return NULL;
+}
+
+static void job_free(struct term_job *j) {
+    free(j->out);
+    free(j);
+}
+
+/* "[2] Exit 3  check --slow" */
+static void job_print_line(FILE *f, const struct term_job *j) {
+    fprintf(f, "[%d] ", j->id);
+    if (j->state == JOB_QUEUED) fputs("Queued     ", f);
+    else if (j->state == JOB_RUNNING) fputs(j->cancelled ? "Cancelling " : "Running    ", f);
+    else if (j->cancelled) fputs("Cancelled  ", f);
+    else if (j->status == 0) fputs("Done       ", f);
+    else fprintf(f, "Exit %-6d", j->status);
+    for (int i = 0; i < j->argc; ++i) fprintf(f, i ? " %s" : "%s", j->argv[i]);
+    fputc('\n', f);
+}
+
+/*
+ * Prints the status line and captured output of every finished job and
+ * drops it from the table. Returns the status of the last failing one (0 if none).
+ */
+static int jobs_report(struct job_pool *p) {
+    if (!p) return 0;
+    struct term_job *done = NULL, **tail = &done;
+    pthread_mutex_lock(&p->mu);
+    if (p->finished) {
+        for (struct term_job **pj = &p->jobs; *pj;) {
+            struct term_job *j = *pj;
+            if (j->state != JOB_DONE) { pj = &j->next; continue; }
+            *pj = j->next;
+            j->next = NULL;
+            *tail = j;
+            tail = &j->next;
+        }
+        p->finished = 0;
+    }
+    pthread_mutex_unlock(&p->mu);
+
+    int ret = 0;
+    if (done) switch_output(term_out());
+    while (done) {
+        struct term_job *j = done;
+        done = j->next;
+        job_print_line(term_out(), j);
+        if (j->outlen) fwrite(j->out, 1, j->outlen, term_out());
+        if (j->status != 0) ret = j->status;
+        job_free(j);
+    }
+    return ret;
+}
+
+/* Queues @p cmd with a copy of argv on the session's pool, creating it if needed. */
+static int job_start(struct job_pool **pp, const struct term_cmd *cmd, int argc, char **argv) {
+    struct job_pool *p = *pp;
+    if (!p) {
+        p = (struct job_pool *)calloc(1, sizeof(*p));
+        if (!p) return -1;
+        pthread_mutex_init(&p->mu, NULL);
+        pthread_cond_init(&p->work, NULL);
+        pthread_cond_init(&p->done, NULL);
+        *pp = p;
+    }
+
+    size_t size = sizeof(struct term_job) + (size_t)(argc + 1) * sizeof(char *);
+    for (int i = 0; i < argc; ++i) size += strlen(argv[i]) + 1;
+    struct term_job *j = (struct term_job *)calloc(1, size);
+    if (!j) return -1;
+    j->pool = p;
+    j->cmd = cmd;
+    j->argc = argc;
+    j->argv = (char **)(j + 1);
+    char *s = (char *)(j->argv + argc + 1);
+    for (int i = 0; i < argc; ++i) {
+        size_t n = strlen(argv[i]) + 1;
+        memcpy(s, argv[i], n);
+        j->argv[i] = s;
+        s += n;
+    }
+    j->argv[argc] = NULL;
+
+    pthread_mutex_lock(&p->mu);
+    if (!p->jobs) p->next_id = 1;   /* numbering restarts once the table is empty */
+    j->id = p->next_id++;
+    struct term_job **pj = &p->jobs;
+    while (*pj) pj = &(*pj)->next;
+    *pj = j;
+    if (p->qtail) p->qtail->qnext = j;
+    else p->qhead = j;
+    p->qtail = j;
+    p->queued++;
+    /* idle workers may not have picked up earlier jobs yet */
+    if (p->queued > p->idle && p->nthreads < JOB_THREADS &&
+        pthread_create(&p->threads[p->nthreads], NULL, job_worker, p) == 0) {
+        p->nthreads++;
+        p->idle++;
+    }
+    pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->mu);
+
+    fprintf(term_err(), "[%d] %s\n", j->id, argv[0]);
+    return 0;
+}
+
+/* Job named by "3" or "%3", or NULL. Called with p->mu held. */
+static struct term_job *job_find(struct job_pool *p, const char *spec) {
+    if (*spec == '%') ++spec;
+    char *end;
+    long id = strtol(spec, &end, 10);
+    if (end == spec || *end) return NULL;
+    for (struct term_job *j = p ? p->jobs : NULL; j; j = j->next)
+        if (j->id == id) return j;
+    return NULL;
+}
+
+static int builtin_jobs(struct job_pool *p) {
+    if (!p) return 0;
+    pthread_mutex_lock(&p->mu);
+    for (struct term_job *j = p->jobs; j; j = j->next) job_print_line(term_out(), j);
+    pthread_mutex_unlock(&p->mu);
+    return 0;
+}
+
+/* `wait [ID...]`: block until the named jobs (all by default) have finished. */
+static int builtin_wait(struct job_pool *p, int argc, char **argv) {
+    int ret = 0;
+    if (!p) {
+        for (int i = 1; i < argc; ++i) fprintf(term_err(), "wait: no such job: %s\n", argv[i]);
+        return argc > 1;
+    }
+    pthread_mutex_lock(&p->mu);
+    if (argc == 1) {
+        for (;;) {
+            struct term_job *j = p->jobs;
+            while (j && j->state == JOB_DONE) j = j->next;
+            if (!j) break;
+            pthread_cond_wait(&p->done, &p->mu);
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        struct term_job *j = job_find(p, argv[i]);
+        if (!j) {
+            fprintf(term_err(), "wait: no such job: %s\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+        /* the job stays in the table until reported, so j remains valid */
+        while (j->state != JOB_DONE) pthread_cond_wait(&p->done, &p->mu);
+    }
+    pthread_mutex_unlock(&p->mu);
+    int r = jobs_report(p);
+    return ret ? ret : r;
+}
+
+/* `cancel ID...`: drop queued jobs and ask running ones to stop (see term_job_cancelled()). */
+static int builtin_cancel(struct job_pool *p, int argc, char **argv) {
+    int ret = 0;
+    if (argc < 2) {
+        fputs("usage: cancel ID...\n", term_err());
+        return 1;
+    }
+    if (p) pthread_mutex_lock(&p->mu);
+    for (int i = 1; i < argc; ++i) {
+        struct term_job *j = job_find(p, argv[i]);
+        if (!j) {
+            fprintf(term_err(), "cancel: no such job: %s\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+        if (j->state == JOB_DONE) continue;
+        j->cancelled = 1;
+        if (j->state == JOB_QUEUED) {
+            struct term_job **pq = &p->qhead, *prev = NULL;
+            while (*pq != j) {
+                prev = *pq;
+                pq = &(*pq)->qnext;
+            }
+            *pq = j->qnext;
+            if (p->qtail == j) p->qtail = prev;
+            p->queued--;
+            j->state = JOB_DONE;
+            j->status = 1;
+            p->finished++;
+            pthread_cond_broadcast(&p->done);
+        }
+    }
+    if (p) pthread_mutex_unlock(&p->mu);
+    return ret;
+}
+
+/* Waits for outstanding jobs, reports them and stops the workers. */
+static int jobs_shutdown(struct job_pool *p) {
+    if (!p) return 0;
+    int pending = 0;
+    pthread_mutex_lock(&p->mu);
+    for (struct term_job *j = p->jobs; j; j = j->next) pending += j->state != JOB_DONE;
+    pthread_mutex_unlock(&p->mu);
+    if (pending) fprintf(term_err(), "Waiting for %d background job%s...\n", pending, pending == 1 ? "" : "s");
+
+    char *argv[] = {(char *)"wait", NULL};
+    int ret = builtin_wait(p, 1, argv);
+
+    pthread_mutex_lock(&p->mu);
+    p->shutdown = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->mu);
+    for (int i = 0; i < p->nthreads; ++i) pthread_join(p->threads[i], NULL);
+    pthread_mutex_destroy(&p->mu);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->done);
+    free(p);
+    return ret;
+}
+
+#else /* !TERM_HAVE_JOBS */
+
+struct job_pool;
+
+bool term_job_cancelled(void) {
+    return false;
+}
+
+static int jobs_report(struct job_pool *p) {
+    (void)p;
+    return 0;
+}
+
+static int jobs_shutdown(struct job_pool *p) {
+    (void)p;
+    return 0;
+}
+
+#endif /* TERM_HAVE_JOBS */
+
+/* ---- history -------------------------------------------------------------- */
+
+/* `history`: a builtin once terminal_set_history() has provided a file; ctx is the history. */
+static struct term_cmd history_builtin = {"history", "Search the command history", term_history_cmd, NULL,
+                                          TERM_CMD_STREAMS};
+
+void terminal_set_history(struct term_history *h) {
+    history_builtin.ctx = h;
+}
+
+static const struct term_cmd *find_history(const char *name) {
+    return history_builtin.ctx && strcmp(name, "history") == 0 ? &history_builtin : NULL;
+}
+
+/* ---- pipelines ------------------------------------------------------------ */
+
+/*
+ * Stages are connected by in-memory ring buffers wrapped in stdio streams
+ * (fopencookie/funopen), so handlers use plain fread/fprintf on term_in()
+ * and term_out(). Needs threads and a custom-stream API.
+ */
+#if TERM_HAVE_JOBS && (defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__) || \
+                       defined(__NetBSD__) || defined(__OpenBSD__))
+#define TERM_HAVE_PIPES 1
+#else
+#define TERM_HAVE_PIPES 0
+#endif
+
+#if TERM_HAVE_PIPES
+
+#define RING_SIZE (64 * 1024)
+
+/* Single-producer, single-consumer byte ring between two stages. */
+struct ring {
+    pthread_mutex_t mu;
+    pthread_cond_t readable, writable;
+    size_t head, len;           /* read position and bytes buffered */
+    int writer_open, reader_open;
+    char buf[RING_SIZE];
+};
+
+static struct ring *ring_new(void) {
+    struct ring *r = (struct ring *)malloc(sizeof(*r));
+    if (!r) return NULL;
+    pthread_mutex_init(&r->mu, NULL);
+    pthread_cond_init(&r->readable, NULL);
+    pthread_cond_init(&r->writable, NULL);
+    r->head = r->len = 0;
+    r->writer_open = r->reader_open = 1;
+    return r;
+}
+
+/* Marks one end closed; the ring is freed with the second. */
+static void ring_close(struct ring *r, int writer) {
+    pthread_mutex_lock(&r->mu);
+    if (writer) r->writer_open = 0;
+    else r->reader_open = 0;
+    int last = !r->writer_open && !r->reader_open;
+    pthread_cond_broadcast(&r->readable);
+    pthread_cond_broadcast(&r->writable);
+    pthread_mutex_unlock(&r->mu);
+    if (last) {
+        pthread_mutex_destroy(&r->mu);
+        pthread_cond_destroy(&r->readable);
+        pthread_cond_destroy(&r->writable);
+        free(r);
+    }
+}
+
+/* Blocks while the ring is full; fails with EPIPE once the reader is gone. */
+static ssize_t ring_write(struct ring *r, const char *p, size_t n) {
+    size_t done = 0;
+    pthread_mutex_lock(&r->mu);
+    while (done < n) {
+        while (r->len == RING_SIZE && r->reader_open) pthread_cond_wait(&r->writable, &r->mu);
+        if (!r->reader_open) break;
+        size_t tail = (r->head + r->len) % RING_SIZE;
+        size_t chunk = RING_SIZE - r->len;
+        if (chunk > RING_SIZE - tail) chunk = RING_SIZE - tail;
+        if (chunk > n - done) chunk = n - done;
+        memcpy(r->buf + tail, p + done, chunk);
+        r->len += chunk;
+        done += chunk;
+        pthread_cond_signal(&r->readable);
+    }
+    pthread_mutex_unlock(&r->mu);
+    if (done == 0 && n > 0) {
+        errno = EPIPE;
+        return -1;
+    }
+    return (ssize_t)done;
+}
+
+/* Blocks while the ring is empty; returns 0 at end of input. */
+static ssize_t ring_read(struct ring *r, char *p, size_t n) {
+    pthread_mutex_lock(&r->mu);
+    while (r->len == 0 && r->writer_open) pthread_cond_wait(&r->readable, &r->mu);
+    size_t chunk = r->len;
+    if (chunk > RING_SIZE - r->head) chunk = RING_SIZE - r->head;
+    if (chunk > n) chunk = n;
+    memcpy(p, r->buf + r->head, chunk);
+    r->head = (r->head + chunk) % RING_SIZE;
+    r->len -= chunk;
+    pthread_cond_signal(&r->writable);
+    pthread_mutex_unlock(&r->mu);
+    return (ssize_t)chunk;
+}
+
+#if defined(__GLIBC__)
+static ssize_t ring_cookie_write(void *c, const char *p, size_t n) {
+    return ring_write((struct ring *)c, p, n);
+}
+static ssize_t ring_cookie_read(void *c, char *p, size_t n) {
+    return ring_read((struct ring *)c, p, n);
+}
+static int ring_cookie_close_writer(void *c) {
+    ring_close((struct ring *)c, 1);
+    return 0;
+}
+static int ring_cookie_close_reader(void *c) {
+    ring_close((struct ring *)c, 0);
+    return 0;
+}
+
+static FILE *ring_stream(struct ring *r, int writer) {
+    cookie_io_functions_t io = {NULL, NULL, NULL, NULL};
+    if (writer) {
+        io.write = ring_cookie_write;
+        io.close = ring_cookie_close_writer;
+    } else {
+        io.read = ring_cookie_read;
+        io.close = ring_cookie_close_reader;
+    }
+    return fopencookie(r, writer ? "w" : "r", io);
+}
+#else
+static int ring_cookie_write(void *c, const char *p, int n) {
+    return (int)ring_write((struct ring *)c, p, (size_t)n);
+}
+static int ring_cookie_read(void *c, char *p, int n) {
+    return (int)ring_read((struct ring *)c, p, (size_t)n);
+}
+static int ring_cookie_close_writer(void *c) {
+    ring_close((struct ring *)c, 1);
+    return 0;
+}
+static int ring_cookie_close_reader(void *c) {
+    ring_close((struct ring *)c, 0);
+    return 0;
+}
+
+static FILE *ring_stream(struct ring *r, int writer) {
+    return writer ? funopen(r, NULL, ring_cookie_write, NULL, ring_cookie_close_writer)
+                  : funopen(r, ring_cookie_read, NULL, NULL, ring_cookie_close_reader);
+}
+#endif
+
+struct stage {
+    const struct term_cmd *cmd;
+    struct term_args args;
+    FILE *in, *out, *err;
+    int first, last;
+    int status;
+    pthread_t thread;
+};
+
+static void stage_run(struct stage *st) {
+    FILE *saved_in = tl_in, *saved_out = tl_out, *saved_err = tl_err;
+    tl_in = st->in;
+    tl_out = st->out;
+    tl_err = st->err;
+    if (st->cmd->flags & TERM_CMD_STREAMS) {
+        if (st->last) switch_output(st->out);
+        st->status = st->cmd->fn(st->args.argc, st->args.argv, st->cmd->ctx);
+    } else {
+        /*
+         * A legacy handler (last stage only) prints to stdout and never reads
+         * term_in(). Its input is closed first so that the stage before it
+         * gets EPIPE instead of blocking on a full ring.
+         */
+        if (!st->first) {
+            fclose(st->in);
+            st->in = tl_in = NULL;
+        }
+        switch_output(stdout);
+        st->status = st->cmd->fn(st->args.argc, st->args.argv, st->cmd->ctx);
+    }
+    if (st->last) fflush(st->out);
+    else fclose(st->out);               /* end of input for the next stage */
+    if (!st->first && st->in) fclose(st->in);   /* later writes upstream fail with EPIPE */
+    tl_in = saved_in;
+    tl_out = saved_out;
+    tl_err = saved_err;
+}
+
+static void *stage_thread(void *arg) {
+    stage_run((struct stage *)arg);
+    return NULL;
+}
+
+static int is_builtin(const char *name) {
+    static const char *const names[] = {"exit", "quit", "jobs", "wait", "cancel"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        if (strcmp(name, names[i]) == 0) return 1;
+    return 0;
+}
+
+/*
+ * Runs segs[0] | segs[1] | ... : every stage but the last on its own
+ * thread, the last one on the caller's. The pipeline's status is the last
+ * stage's.
+ */
+static void run_pipeline(const struct term_registry *reg, char **segs, int n, int *status) {
+    struct stage *st = (struct stage *)calloc((size_t)n, sizeof(*st));
+    if (!st) {
+        fputs("terminal: out of memory\n", term_err());
+        *status = 1;
+        return;
+    }
+    int ok = 1, rings = 0;
+    for (int i = 0; i < n && ok; ++i) {
+        const char *err = NULL;
+        int argc = term_tokenize(segs[i], &st[i].args, &err);
+        if (argc == 0) err = "empty command in pipeline";
+        if (argc <= 0 || err) {
+            fprintf(term_err(), "Parse error: %s\n", err);
+            ok = 0;
+            break;
+        }
+        const char *name = st[i].args.argv[0];
+        int matches = 0;
+        st[i].cmd = find_history(name);
+        if (!st[i].cmd && !is_builtin(name)) st[i].cmd = term_registry_resolve(reg, name, &matches);
+        if (!st[i].cmd) {
+            if (is_builtin(name)) fprintf(term_err(), "Builtin cannot be used in a pipeline: %s\n", name);
+            else if (matches > 1) fprintf(term_err(), "Ambiguous command: %s\n", name);
+            else fprintf(term_err(), "Unknown command: %s\n", name);
+            ok = 0;
+        } else if (i < n - 1 && !(st[i].cmd->flags & TERM_CMD_STREAMS)) {
+            /* its printf()s would bypass the ring; only the last stage may write to stdout */
+            fprintf(term_err(), "Command cannot feed a pipeline: %s\n", name);
+            ok = 0;
+        }
+    }
+    /* Connect the stages; the ends of the pipeline are the caller's streams. */
+    for (int i = 0; i < n; ++i) {
+        st[i].first = i == 0;
+        st[i].last = i == n - 1;
+        st[i].err = term_err();
+    }
+    st[0].in = term_in();
+    st[n - 1].out = term_out();
+    for (int i = 0; ok && i < n - 1; ++i, ++rings) {
+        struct ring *r = ring_new();
+        FILE *w = r ? ring_stream(r, 1) : NULL;
+        FILE *rd = w ? ring_stream(r, 0) : NULL;
+        if (!rd) {
+            if (w) fclose(w);
+            else if (r) ring_close(r, 1);
+            if (r) ring_close(r, 0);
+            fputs("terminal: out of memory\n", term_err());
+            ok = 0;
+            break;
+        }
+        st[i].out = w;
+        st[i + 1].in = rd;
+    }
+
+    int started = 0;
+    if (ok) {
+        for (; started < n - 1; ++started)
+            if (pthread_create(&st[started].thread, NULL, stage_thread, &st[started]) != 0) break;
+        if (started < n - 1) {
+            /* close the rest of the chain so the started stages see EOF/EPIPE */
+            fputs("terminal: cannot start pipeline thread\n", term_err());
+            for (int i = started; i < n - 1; ++i) {
+                fclose(st[i].out);
+                if (i > 0) fclose(st[i].in);
+            }
+            fclose(st[n - 1].in);
+            ok = 0;
+        } else {
+            stage_run(&st[n - 1]);
+        }
+        for (int i = 0; i < started; ++i) pthread_join(st[i].thread, NULL);
+    } else {
+        for (int i = 0; i < rings; ++i) {
+            fclose(st[i].out);
+            fclose(st[i + 1].in);
+        }
+    }
+
+    if (!ok) *status = 1;
+    else if (st[n - 1].status != 0) *status = st[n - 1].status;
+    for (int i = 0; i < n; ++i) term_args_free(&st[i].args);
+    free(st);
+}
+
+#endif /* TERM_HAVE_PIPES */
+
+/*
+ * Returns the number of `|`-separated segments of @p line, honouring the
+ * quoting rules of term_tokenize(). With @p segs, also cuts the line at
+ * each `|` and stores the start of every segment.
+ */
+static int pipe_segments(char *line, char **segs) {
+    int n = 1;
+    char quote = 0;
+    if (segs) segs[0] = line;
+    for (char *p = line; *p; ++p) {
+        if (quote == '\'') {
+            if (*p == '\'') quote = 0;
+        } else if (*p == '\\') {
+            if (p[1] && (!quote || p[1] == '"' || p[1] == '\\')) ++p;
+        } else if (quote == '"') {
+            if (*p == '"') quote = 0;
+        } else if (*p == '\'' || *p == '"') {
+            quote = *p;
+        } else if (*p == '|') {
+            if (segs) {
+                *p = '\0';
+                segs[n] = p + 1;
+            }
+            ++n;
+        }
+    }
+    return n;
+}
+
+/*
+ * Removes a trailing unquoted `&` (and the blanks before it) from @p line.
+ * Returns 1 if there was one.
+ */
+static int strip_background(char *line) {
+    size_t n = strlen(line);
+    while (n > 0 && (line[n - 1] == ' ' || line[n - 1] == '\t')) --n;
+    if (n == 0 || line[n - 1] != '&') return 0;
+    size_t bs = 0;
+    while (bs + 1 < n && line[n - 2 - bs] == '\\') ++bs;
+    if (bs % 2) return 0;   /* `\&` is a literal ampersand */
+    line[n - 1] = '\0';
+    return 1;
+}
+
+/* State of one REPL or batch run. */
+struct session {
+    const struct term_registry *reg;
+    struct term_args args;      /* reused for every line */
+    int ret;                    /* status of the last failing command */
+    struct job_pool *jobs;      /* background jobs; NULL until the first `&` */
+};
+
+/*
+ * terminal_exec_line() with job control when @p jobs is not NULL: a trailing
+ * `&` queues an async-capable command and `jobs`, `wait` and `cancel` are builtins.
+ */
+static int exec_line(const struct term_registry *reg, struct term_args *args, char *line, int *status,
+                     struct job_pool **jobs) {
+    int background = strip_background(line);
+    int nsegs = strchr(line, '|') ? pipe_segments(line, NULL) : 1;
+    if (nsegs > 1) {
+#if TERM_HAVE_PIPES
+        char **segs = background ? NULL : (char **)malloc((size_t)nsegs * sizeof(*segs));
+        if (segs) {
+            pipe_segments(line, segs);
+            run_pipeline(reg, segs, nsegs, status);
+            free(segs);
+            return 0;
+        }
+        fputs(background ? "Pipelines cannot run in the background\n" : "terminal: out of memory\n", term_err());
+#else
+        fputs("Pipelines are not available here\n", term_err());
+#endif
+        *status = 1;
+        return 0;
+    }
+
+    const char *err = NULL;
+    int argc = term_tokenize(line, args, &err);
+    if (argc == 0 && background) err = "nothing to run in the background";
+    if (argc < 0 || err) {
+        fprintf(term_err(), "Parse error: %s\n", err);
+        *status = 1;
+        return 0;
+    }
+    if (argc == 0) return 0;
+    char **argv = args->argv;
+
+    /* builtin `exit` */
+    if (strcmp(argv[0], "exit") == 0 || strcmp(argv[0], "quit") == 0) return 1;
+
+#if TERM_HAVE_JOBS
+    if (jobs) {
+        int r = -1;
+        if (strcmp(argv[0], "jobs") == 0) r = builtin_jobs(*jobs);
+        else if (strcmp(argv[0], "wait") == 0) r = builtin_wait(*jobs, argc, argv);
+        else if (strcmp(argv[0], "cancel") == 0) r = builtin_cancel(*jobs, argc, argv);
+        if (r >= 0) {
+            if (r != 0) *status = r;
+            return 0;
+        }
+    }
+#endif
+
+    int matches = 0;
+    const struct term_cmd *cmd = find_history(argv[0]);
+    if (!cmd) cmd = term_registry_resolve(reg, argv[0], &matches);
+    if (cmd && background) {
+        if (!(cmd->flags & TERM_CMD_ASYNC)) {
+            fprintf(term_err(), "Command cannot run in the background: %s\n", cmd->name);
+            *status = 1;
+            return 0;
+        }
+#if TERM_HAVE_JOBS
+        if (jobs) {
+            if (job_start(jobs, cmd, argc, argv) != 0) {
+                fputs("terminal: out of memory\n", term_err());
+                *status = 1;
+            }
+            return 0;
+        }
+#endif
+        fputs("Background jobs are not available here\n", term_err());
+        *status = 1;
+    } else if (cmd) {
+        /* A legacy handler prints to stdout: keep it in order with a redirected term_out(). */
+        switch_output(cmd->flags & TERM_CMD_STREAMS ? term_out() : stdout);
+        int r = cmd->fn(argc, argv, cmd->ctx);
+        if (r != 0) *status = r;
+    } else if (matches > 1) {
+        int first = 1;
+        fprintf(term_err(), "Ambiguous command: %s (", argv[0]);
+        term_registry_complete(reg, argv[0], print_candidate, &first);
+        fputs(")\n", term_err());
+    } else {
+        fprintf(term_err(), "Unknown command: %s\n", argv[0]);
+    }
+    return 0;
+}
+
+int terminal_exec_line(const struct term_registry *reg, struct term_args *args, char *line, int *status) {
+    int stop = exec_line(reg, args, line, status, NULL);
+    /* Callers (e.g. the server) run one line at a time: don't leave a legacy handler's output buffered. */
+    if (tl_unflushed == stdout) {
+        fflush(stdout);
+        tl_unflushed = NULL;
+    }
+    return stop;
+}
+
+/*
+ * Records @p line in the history (if any), tokenizes it in place and
+ * dispatches it, then prints the jobs that finished meanwhile. Returns 1 if
+ * the line was `exit`/`quit`, 0 otherwise; a failing command's status is kept
+ * in s->ret.
+ */
+static int run_line(struct session *s, char *line) {
+    if (history_builtin.ctx && line[strspn(line, " \t")])
+        term_history_add((struct term_history *)history_builtin.ctx, line);
+    int stop = exec_line(s->reg, &s->args, line, &s->ret, &s->jobs);
+    if (s->jobs) {
+        int r = jobs_report(s->jobs);
+        if (r != 0) s->ret = r;
+    }
+    return stop;
+}
+
+/* Ends a REPL or batch session: waits for its background jobs and frees it. */
+static void session_end(struct session *s) {
+    int r = jobs_shutdown(s->jobs);
+    if (r != 0) s->ret = r;
+    s->jobs = NULL;
+    term_args_free(&s->args);
+}
+
+int terminal_run_registry(const char *prompt, const struct term_registry *reg) {
     char *line = NULL;
     size_t linecap = 0;
     ssize_t linelen;
-    int ret = 0;
+    struct session s = {reg, {NULL, 0, 0}, 0, NULL};
 
     while (1) {
         if (prompt) fputs(prompt, stdout);
@@ -66,37 +1190,145 @@ int terminal_run(const char *prompt, const struct term_cmd *cmds, int ncmds) {
         }
 
         trim_newline(line);
+        if (run_line(&s, line)) break;
+    }
 
-        /* skip empty lines */
-        char *p = line;
-        while (*p && isspace((unsigned char)*p)) ++p;
-        if (*p == '\0') continue;
+    free(line);
+    session_end(&s);
+    return s.ret;
+}
 
-        /* tokenize (simple whitespace split) */
-        char *argv[TERM_MAX_ARGS];
-        int argc = 0;
-        char *saveptr = NULL;
-        char *tok = strtok_r(line, " \t", &saveptr);
-        while (tok && argc < TERM_MAX_ARGS) {
-            argv[argc++] = tok;
-            tok = strtok_r(NULL, " \t", &saveptr);
-        }
-        if (argc == 0) continue;
+/* ---- batch mode ----------------------------------------------------------- */
 
-        /* builtin `exit` */
-        if (strcmp(argv[0], "exit") == 0 || strcmp(argv[0], "quit") == 0) {
-            break;
+void terminal_flush(void) {
+    if (tl_out) fflush(tl_out);
+    if (tl_err) fflush(tl_err);
+    fflush(stdout);
+    fflush(stderr);
+    tl_unflushed = NULL;
+}
+
+/*
+ * Runs every complete line in buf[0..len) and returns the number of bytes
+ * consumed; *stop is set once `exit` is seen. With @p final, a trailing line
+ * without newline is run too (buf must have room for its terminator).
+ */
+static size_t run_lines(struct session *s, char *buf, size_t len, int final, int *stop) {
+    size_t pos = 0;
+    while (pos < len && !*stop) {
+        char *nl = (char *)memchr(buf + pos, '\n', len - pos);
+        if (!nl && !final) break;
+        size_t end = nl ? (size_t)(nl - buf) : len;
+        size_t next = nl ? end + 1 : len;
+        if (end > pos && buf[end - 1] == '\r') --end;
+        buf[end] = '\0';
+        *stop = run_line(s, buf + pos);
+        pos = next;
+    }
+    return pos;
+}
+
+/*
+ * A private, fully buffered stream on a duplicate of @p std's descriptor, so
+ * that handlers' term_out()/term_err() writes batch up without re-buffering
+ * the process-wide streams. NULL if it cannot be set up.
+ */
+static FILE *batch_stream(FILE *std, size_t size) {
+    int fd = dup(fileno(std));
+    if (fd < 0) return NULL;
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        return NULL;
+    }
+    setvbuf(f, NULL, _IOFBF, size);
+    return f;
+}
+
+static int run_batch(struct session *s, int fd);
+
+int terminal_run_batch(int fd, const struct term_registry *reg) {
+    struct session s = {reg, {NULL, 0, 0}, 0, NULL};
+    FILE *saved_out = tl_out, *saved_err = tl_err, *out = NULL, *err = NULL;
+    terminal_flush();
+    /* Callers that redirected the thread's output (e.g. a server) keep their streams. */
+    if (!saved_out) out = batch_stream(stdout, 1 << 20);
+    if (!saved_err) err = batch_stream(stderr, 1 << 16);
+    term_set_output(out ? out : saved_out, err ? err : saved_err);
+    int ret = run_batch(&s, fd);
+    session_end(&s);
+    terminal_flush();
+    term_set_output(saved_out, saved_err);
+    if (out) fclose(out);
+    if (err) fclose(err);
+    return ret < 0 ? ret : s.ret;
+}
+
+static int run_batch(struct session *s, int fd) {
+    int stop = 0;
+
+#ifndef _WIN32
+    /* Regular files are mapped copy-on-write and tokenized in place. */
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t size = (size_t)st.st_size;
+        char *map = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, size, MADV_SEQUENTIAL);
+#endif
+            size_t used = run_lines(s, map, size, 0, &stop);
+            if (used < size && !stop) {
+                /* the last line has no newline and the mapping has no room for a NUL */
+                char *tail = (char *)malloc(size - used + 1);
+                if (tail) {
+                    memcpy(tail, map + used, size - used);
+                    run_lines(s, tail, size - used, 1, &stop);
+                    free(tail);
+                }
+            }
+            munmap(map, size);
+            terminal_flush();
+            return s->ret;
         }
+    }
+#endif
 
-        int idx = terminal_find_cmd(cmds, ncmds, argv[0]);
-        if (idx >= 0) {
-            int r = cmds[idx].fn(argc, argv, cmds[idx].ctx);
-            if (r != 0) ret = r;
-        } else {
-            fprintf(stderr, "Unknown command: %s\n", argv[0]);
+    /* Pipes and terminals: bulk reads into a growing buffer, split in place. */
+    size_t cap = 1 << 16, len = 0;
+    char *buf = (char *)malloc(cap + 1);
+    if (!buf) return -1;
+    while (!stop) {
+        if (len == cap) {
+            char *nb = (char *)realloc(buf, cap * 2 + 1);
+            if (!nb) { s->ret = -1; break; }
+            buf = nb;
+            cap *= 2;
         }
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n < 0) s->ret = -1;
+            run_lines(s, buf, len, 1, &stop);
+            break;
+        }
+        len += (size_t)n;
+        size_t used = run_lines(s, buf, len, 0, &stop);
+        memmove(buf, buf + used, len - used);
+        len -= used;
     }
+    free(buf);
+    terminal_flush();
+    return s->ret;
+}
 
-    free(line);
+int terminal_run_script(const char *path, const struct term_registry *reg) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "terminal: cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int ret = terminal_run_batch(fd, reg);
+    close(fd);
     return ret;
 }
@@ -11,12 +11,17 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/** @brief Maximum number of arguments per command. */
+/**
+ * @brief Former fixed argument limit per command.
+ * @deprecated The tokenizer no longer limits the number of arguments.
+ */
 #define TERM_MAX_ARGS 16
 
 /**
@@ -28,6 +33,25 @@ extern "C" {
  */
 typedef int (*term_cmd_fn)(int argc, char **argv, void *ctx);
 
+/**
+ * @brief term_cmd flag: the command may run as a background job (`cmd args &`).
+ *
+ * The handler then runs on a worker thread, concurrently with the REPL and
+ * other jobs, so it must be thread-safe. Its term_out()/term_err() output is
+ * collected and printed between prompts once it finishes. Long-running
+ * handlers should poll term_job_cancelled() and return early.
+ */
+#define TERM_CMD_ASYNC 0x1u
+
+/**
+ * @brief term_cmd flag: the handler reads term_in() and prints only through
+ *        term_out()/term_err(), so it can be any stage of a pipeline.
+ *
+ * Handlers without it are treated as legacy stdout writers: they can only
+ * be the last stage of a pipeline, and their input is closed.
+ */
+#define TERM_CMD_STREAMS 0x2u
+
 /**
  * @brief Terminal command definition.
  * 
@@ -38,13 +62,95 @@ struct term_cmd {
     const char *help;       /**< Help text displayed by the help command. */
     term_cmd_fn fn;         /**< Function pointer to execute the command. */
     void *ctx;              /**< User-provided context passed to fn(). */
+    unsigned flags;         /**< TERM_CMD_* bits; 0 for a foreground-only command. */
 };
 
+/**
+ * @brief Whether the background job running the calling handler was cancelled.
+ *
+ * Set by the `cancel` builtin; always false outside a background job.
+ */
+bool term_job_cancelled(void);
+
+/**
+ * @brief Argument vector produced by term_tokenize().
+ *
+ * The arguments point into the tokenized line. The pointer array is reused
+ * from line to line and only grows, so a loop that keeps one term_args
+ * allocates nothing per command once it has seen its longest line.
+ * Zero-initialize before first use; release with term_args_free().
+ */
+struct term_args {
+    char **argv;    /**< argc arguments followed by NULL. */
+    int argc;
+    size_t cap;     /**< Capacity of argv in pointers. */
+};
+
+/**
+ * @brief Split @p line into arguments in place.
+ *
+ * Arguments are separated by unquoted spaces or tabs. `'...'` is literal,
+ * `"..."` allows `\"` and `\\`, and a backslash outside quotes escapes the next
+ * character. Quotes and escapes are removed by rewriting @p line.
+ *
+ * @param err Set to a static message when -1 is returned (e.g. "unterminated double quote").
+ * @return Number of arguments, or -1 on a syntax error or allocation failure.
+ */
+int term_tokenize(char *line, struct term_args *args, const char **err);
+
+/** @brief Release the pointer array of @p args. */
+void term_args_free(struct term_args *args);
+
+/**
+ * @brief Stream command handlers should read input from.
+ *
+ * stdin, or the output of the previous stage when the command runs
+ * inside a pipeline (`producer | filter`).
+ */
+FILE *term_in(void);
+
+/**
+ * @brief Stream command handlers should print to.
+ *
+ * stdout unless the calling thread redirected it with term_set_output(),
+ * e.g. to the client connection under terminal_serve(). Handlers that print
+ * with plain printf() still work in the REPL and batch mode but write to the
+ * server's own stdout when served.
+ */
+FILE *term_out(void);
+
+/** @brief Stream for diagnostics (stderr unless redirected); see term_out(). */
+FILE *term_err(void);
+
+/** @brief Redirect term_out() and term_err() for the calling thread (NULL restores stdout/stderr). */
+void term_set_output(FILE *out, FILE *err);
+
+/** @brief Redirect term_in() for the calling thread (NULL restores stdin). */
+void term_set_input(FILE *in);
+
 /**
  * @brief Run a simple line-based terminal loop.
  * 
  * Prompts the user for input, parses commands, and dispatches to registered
  * handlers. Continues until "exit" command or EOF.
+ *
+ * A command flagged TERM_CMD_ASYNC followed by `&` runs as a background job.
+ * The builtins `jobs` (list), `wait [ID...]` (block until done) and
+ * `cancel ID...` manage them; finished jobs are reported with their output
+ * before the next prompt, and the loop waits for outstanding jobs before it
+ * returns. A failing job's status counts like a failing command's.
+ *
+ * `cmd1 | cmd2 | ...` runs a pipeline in-process: each stage but the last
+ * runs on its own thread, and stages are connected by 64 KiB ring buffers
+ * exposed as term_in()/term_out() streams, so a fast producer blocks until
+ * the consumer catches up. The pipeline's status is the last stage's.
+ * Pipelines cannot run in the background.
+ *
+ * With a history file set by terminal_set_history() (terminal_history.h),
+ * every non-blank line is appended to it and `history` searches it.
+ *
+ * Builds a term_registry for @p cmds; callers that run the loop repeatedly
+ * can build one themselves and use terminal_run_registry().
  * 
  * @param prompt NUL-terminated prompt string (e.g., "> ").
  * @param cmds Array of available commands.
@@ -63,6 +169,97 @@ int terminal_run(const char *prompt, const struct term_cmd *cmds, int ncmds);
  */
 int terminal_find_cmd(const struct term_cmd *cmds, int ncmds, const char *name);
 
+/**
+ * @brief Command lookup index built once from a `term_cmd` table.
+ *
+ * Exact names are found through a hash table (one hash and usually one
+ * strcmp per lookup, independent of the table size); a character trie
+ * resolves unique prefixes and lists completions in name order. The
+ * registry points into the caller's table, which must outlive it.
+ */
+struct term_registry;
+
+/**
+ * @brief Build a registry over @p cmds.
+ * @param ncmds Number of commands, or -1 if @p cmds ends with a NULL name.
+ * @return The registry, or NULL on allocation failure. When a name occurs
+ *         more than once the first entry wins, as with terminal_find_cmd().
+ */
+struct term_registry *term_registry_new(const struct term_cmd *cmds, int ncmds);
+
+/** @brief Release a registry (NULL is ignored). */
+void term_registry_free(struct term_registry *reg);
+
+/** @brief Number of distinct commands in the registry. */
+int term_registry_count(const struct term_registry *reg);
+
+/** @brief Command named exactly @p name, or NULL. */
+const struct term_cmd *term_registry_find(const struct term_registry *reg, const char *name);
+
+/**
+ * @brief Resolve @p name as an exact name or a unique prefix.
+ * @param nmatches If not NULL, receives the number of commands starting with
+ *                 @p name (1 for an exact match, even if it is also a prefix).
+ * @return The command, or NULL if there is no match or the prefix is ambiguous.
+ */
+const struct term_cmd *term_registry_resolve(const struct term_registry *reg, const char *name, int *nmatches);
+
+/**
+ * @brief List the commands starting with @p prefix in name order.
+ * @param fn Called once per command; listing stops early if it returns non-zero.
+ * @return Number of commands passed to @p fn.
+ */
+int term_registry_complete(const struct term_registry *reg, const char *prefix,
+                           int (*fn)(const struct term_cmd *cmd, void *arg), void *arg);
+
+/**
+ * @brief terminal_run() over a prebuilt registry.
+ *
+ * Commands may be abbreviated to any unique prefix; an ambiguous prefix
+ * lists the candidates instead of running anything.
+ */
+int terminal_run_registry(const char *prompt, const struct term_registry *reg);
+
+/**
+ * @brief Tokenize and run one line; the building block of every front end.
+ *
+ * Resolves the command like terminal_run_registry() and reports parse
+ * errors, unknown and ambiguous commands on term_err(). There is no job
+ * control: a trailing `&` is refused, and `jobs`, `wait` and `cancel` are
+ * looked up in @p reg like any other name. `history` is a builtin once
+ * terminal_set_history() has been called; lines are not recorded here.
+ *
+ * @param args Argument vector reused across calls (zero-initialized before first use).
+ * @param status Receives the status of a failing command (1 for a parse error); untouched otherwise.
+ * @return 1 if the line was `exit` or `quit`, 0 otherwise.
+ */
+int terminal_exec_line(const struct term_registry *reg, struct term_args *args, char *line, int *status);
+
+/**
+ * @brief Run the commands read from @p fd without prompts (scripts, pipes).
+ *
+ * Regular files are memory-mapped, anything else is read in large chunks;
+ * lines are split in place instead of one getline() per line. Unless the
+ * calling thread has redirected them, term_out() and term_err() become
+ * private fully buffered streams (1 MiB / 64 KiB) on duplicates of the
+ * stdout and stderr descriptors, flushed on terminal_flush() and closed
+ * before returning; stdout and stderr themselves are left as they were.
+ * The relative order of output and error lines is not kept. Handlers
+ * without TERM_CMD_STREAMS still print to stdout; each stream is flushed
+ * before a handler writing to the other one runs, so output stays in
+ * order without a write per line. Stops at EOF or `exit`/`quit`.
+ * Background jobs and history recording work as in terminal_run().
+ *
+ * @return Status of the last failing command (0 if none), -1 on read errors.
+ */
+int terminal_run_batch(int fd, const struct term_registry *reg);
+
+/** @brief terminal_run_batch() on the file at @p path. */
+int terminal_run_script(const char *path, const struct term_registry *reg);
+
+/** @brief Flush term_out(), term_err(), stdout and stderr (e.g. before a long-running handler in batch mode). */
+void terminal_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,449 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* mkstemp, dup2 */
+#endif
+
+/**
+ * @file terminal_bench.c
+ * @brief Replay benchmark for the terminal's tokenizer and dispatch.
+ *
+ * Replays a command script through a registry of thousands of no-op
+ * commands. The script is either recorded (`--script FILE`, one command per
+ * line) or generated: random commands with varied argument counts, quoted
+ * arguments and a share of unknown names. Each mode runs the whole script
+ * once after a warm-up pass:
+ *   - exec:  terminal_exec_line() per line, timed individually (latency percentiles)
+ *   - repl:  terminal_run_registry() reading the script on stdin
+ *   - batch: terminal_run_batch() on the script file
+ *
+ * Reports lines per second and heap allocations per line (malloc, calloc
+ * and realloc calls, counted on glibc) for every mode, and p50/p99/p99.9
+ * latency for exec. Command output goes to /dev/null.
+ *
+ * @usage
+ *   - Build: `gcc -O2 -pthread -Isrc -o terminal_bench src/terminal_bench.c src/terminal.c src/terminal_history.c`
+ *   - Run:   `./terminal_bench --out terminal-baseline.json`
+ *   - Check: `./terminal_bench --compare terminal-baseline.json --threshold 0.25`
+ *
+ * `./scripts/build.sh --bench` builds and runs it with the default sizes.
+ */
+
+#include "terminal.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ---- allocation counting ------------------------------------------------- */
+
+#if defined(__GLIBC__)
+#define BENCH_COUNTS_ALLOCS 1
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t n);
+extern void __libc_free(void *p);
+
+static size_t g_allocs;
+
+void *malloc(size_t n) {
+    __atomic_fetch_add(&g_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+    __atomic_fetch_add(&g_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+    __atomic_fetch_add(&g_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(p, n);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+
+static size_t allocs(void) {
+    return __atomic_load_n(&g_allocs, __ATOMIC_RELAXED);
+}
+#else
+#define BENCH_COUNTS_ALLOCS 0
+
+static size_t allocs(void) {
+    return 0;
+}
+#endif
+
+/* ---- script ---------------------------------------------------------------- */
+
+struct bench_opts {
+    size_t lines;           /* generated lines */
+    int commands;           /* registry size */
+    int max_args;
+    double unknown;         /* share of lines naming no command */
+    unsigned seed;
+    const char *script;     /* recorded script instead of a generated one */
+    const char *out, *compare;
+    double threshold;
+};
+
+static uint64_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;   /* xorshift64 */
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+
+static const char *const words[] = {
+    "-v", "--force", "eth0", "/etc/ssh/sshd_config", "net.ipv4.ip_forward=0", "1", "on", "--timeout=30",
+    "\"two words\"", "'single quoted'", "a\\ b", "0x7f", "sysctl", "--output=/var/log/os_typing/audit.log",
+};
+
+/* Writes a generated script to a temporary file and returns its path (static). */
+static const char *generate_script(const struct bench_opts *o) {
+    static char path[] = "/tmp/terminal_bench.XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!f) {
+        fprintf(stderr, "[bench] ERROR creating %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    rng_state = 0x9E3779B97F4A7C15ull ^ o->seed;
+    uint32_t unknown_cut = (uint32_t)(o->unknown * 4294967295.0);
+    for (size_t i = 0; i < o->lines; ++i) {
+        unsigned id = rng() % (unsigned)o->commands;
+        fprintf(f, rng() < unknown_cut ? "nosuch%05u" : "cmd%05u", id);
+        int nargs = o->max_args ? (int)(rng() % (unsigned)(o->max_args + 1)) : 0;
+        for (int a = 0; a < nargs; ++a) fprintf(f, " %s", words[rng() % (sizeof(words) / sizeof(words[0]))]);
+        fputc('\n', f);
+    }
+    if (fclose(f) != 0) {
+        fprintf(stderr, "[bench] ERROR writing %s: %s\n", path, strerror(errno));
+        unlink(path);
+        return NULL;
+    }
+    return path;
+}
+
+static char *read_script(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 1 << 20, n = 0, got;
+    char *buf = (char *)malloc(cap + 1);
+    while (buf && (got = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += got;
+        if (n == cap) {
+            char *more = (char *)realloc(buf, cap * 2 + 1);
+            if (!more) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = more;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (buf) buf[n] = '\0';
+    *len = n;
+    return buf;
+}
+
+/* ---- measurement ------------------------------------------------------------ */
+
+struct mode_result {
+    const char *mode;
+    size_t lines;
+    double lines_per_s;
+    double allocs_per_line;
+    double p50_ns, p99_ns, p999_ns;     /* exec only */
+};
+
+static double now_s(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile of sorted @p v. */
+static double percentile(const uint32_t *v, size_t n, double q) {
+    if (n == 0) return 0;
+    size_t rank = (size_t)(q * (double)n + 0.999999);
+    if (rank < 1) rank = 1;
+    return v[(rank > n ? n : rank) - 1];
+}
+
+static int noop(int argc, char **argv, void *ctx) {
+    (void)argc; (void)argv; (void)ctx;
+    return 0;
+}
+
+/*
+ * Runs every line of @p text through terminal_exec_line(), timing each.
+ * With @p r NULL this is the warm-up pass.
+ */
+static int run_exec(const struct term_registry *reg, const char *text, size_t len, struct mode_result *r) {
+    size_t nlines = 0;
+    for (const char *p = text; (p = (const char *)memchr(p, '\n', (size_t)(text + len - p))) != NULL; ++p) ++nlines;
+    uint32_t *lat = r ? (uint32_t *)malloc((nlines + 1) * sizeof(*lat)) : NULL;
+    char *line = (char *)malloc(len + 1);
+    if ((r && !lat) || !line) {
+        free(lat);
+        free(line);
+        return -1;
+    }
+    struct term_args args = {NULL, 0, 0};
+    int status = 0;
+    size_t n = 0, a0 = allocs();
+    double t0 = now_s();
+    for (size_t pos = 0; pos < len;) {
+        const char *nl = (const char *)memchr(text + pos, '\n', len - pos);
+        size_t end = nl ? (size_t)(nl - text) : len;
+        /* The tokenizer works in place, as the REPL's getline() buffer would be reused. */
+        memcpy(line, text + pos, end - pos);
+        line[end - pos] = '\0';
+        uint64_t l0 = r ? now_ns() : 0;
+        terminal_exec_line(reg, &args, line, &status);
+        if (r) {
+            uint64_t d = now_ns() - l0;
+            lat[n] = d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+        }
+        ++n;
+        pos = end + 1;
+    }
+    double t = now_s() - t0;
+    size_t a = allocs() - a0;
+    term_args_free(&args);
+    free(line);
+    if (r) {
+        qsort(lat, n, sizeof(*lat), cmp_u32);
+        r->lines = n;
+        r->lines_per_s = t > 0 ? (double)n / t : 0;
+        r->allocs_per_line = n ? (double)a / (double)n : 0;
+        r->p50_ns = percentile(lat, n, 0.50);
+        r->p99_ns = percentile(lat, n, 0.99);
+        r->p999_ns = percentile(lat, n, 0.999);
+        free(lat);
+    }
+    return 0;
+}
+
+/* Runs the REPL (@p batch = 0) or batch mode over the script file with stdout on /dev/null. */
+static int run_loop(const struct term_registry *reg, const char *path, int batch, size_t lines,
+                    struct mode_result *r) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    int in = open(path, O_RDONLY);
+    if (saved < 0 || null < 0 || in < 0) {
+        fprintf(stderr, "[bench] ERROR %s: %s\n", in < 0 ? path : "/dev/null", strerror(errno));
+        if (saved >= 0) close(saved);
+        if (null >= 0) close(null);
+        if (in >= 0) close(in);
+        return -1;
+    }
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    size_t a0 = allocs();
+    double t0 = now_s();
+    if (batch) {
+        terminal_run_batch(in, reg);
+    } else {
+        dup2(in, STDIN_FILENO);
+        clearerr(stdin);
+        terminal_run_registry(NULL, reg);
+    }
+    double t = now_s() - t0;
+    size_t a = allocs() - a0;
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(in);
+    if (r) {
+        r->lines = lines;
+        r->lines_per_s = t > 0 ? (double)lines / t : 0;
+        r->allocs_per_line = lines ? (double)a / (double)lines : 0;
+    }
+    return 0;
+}
+
+/* ---- baseline ---------------------------------------------------------------- */
+
+static const char *result_line(const struct mode_result *r) {
+    static char line[256];
+    snprintf(line, sizeof(line),
+             "{\"mode\": \"%s\", \"lines\": %zu, \"lines_per_s\": %.0f, \"allocs_per_line\": %.3f, "
+             "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f}",
+             r->mode, r->lines, r->lines_per_s, r->allocs_per_line, r->p50_ns, r->p99_ns, r->p999_ns);
+    return line;
+}
+
+static int write_results(FILE *f, const struct mode_result *res, int n) {
+    fprintf(f, "{\n  \"version\": 1,\n  \"results\": [\n");
+    for (int i = 0; i < n; ++i) fprintf(f, "    %s%s\n", result_line(&res[i]), i + 1 < n ? "," : "");
+    fprintf(f, "  ]\n}\n");
+    return ferror(f) ? -1 : 0;
+}
+
+/*
+ * Compares against a baseline written by --out (one result object per
+ * line). A mode regresses when its throughput drops by more than
+ * @p threshold (fraction) or it allocates more per line.
+ */
+static int compare_baseline(const char *path, const struct mode_result *res, int n, double threshold) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[bench] ERROR %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+    char line[512];
+    int regressions = 0;
+    fprintf(stderr, "\n%-6s %14s %14s %8s %10s %10s\n", "mode", "base lines/s", "lines/s", "delta", "base alloc",
+            "allocs");
+    while (fgets(line, sizeof(line), f)) {
+        char mode[16];
+        double lps, apl;
+        const char *p = strstr(line, "{\"mode\"");
+        if (!p || sscanf(p, "{\"mode\": \"%15[^\"]\", \"lines\": %*u, \"lines_per_s\": %lf, \"allocs_per_line\": %lf",
+                         mode, &lps, &apl) != 3)
+            continue;
+        for (int i = 0; i < n; ++i) {
+            if (strcmp(res[i].mode, mode) != 0) continue;
+            double delta = lps > 0 ? (res[i].lines_per_s - lps) / lps : 0;
+            int slow = -delta > threshold;
+            int more = res[i].allocs_per_line > apl + 0.0005;
+            regressions += slow || more;
+            fprintf(stderr, "%-6s %14.0f %14.0f %+7.1f%% %10.3f %10.3f%s%s\n", mode, lps, res[i].lines_per_s,
+                    delta * 100, apl, res[i].allocs_per_line, slow ? "  SLOWER" : "", more ? "  MORE-ALLOCS" : "");
+        }
+    }
+    fclose(f);
+    fprintf(stderr, "[bench] %d regression(s) against %s (threshold %.0f%%)\n", regressions, path, threshold * 100);
+    return regressions ? 1 : 0;
+}
+
+static void bench_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--lines N] [--commands N] [--max-args N] [--unknown FRACTION] [--seed N]\n"
+            "       [--script FILE] [--out FILE] [--compare FILE [--threshold 0.25]]\n"
+            "Replays a generated (or recorded) command script through terminal_exec_line(), the REPL\n"
+            "and batch mode, and reports lines/s, exec latency percentiles and allocations per line.\n"
+            "--out writes a JSON baseline; --compare exits 1 on regression.\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    struct bench_opts o = {1000000, 5000, 8, 0.05, 1, NULL, NULL, NULL, 0.25};
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        int more = i + 1 < argc;
+        if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) { bench_usage(argv[0]); return 0; }
+        if (strcmp(a, "--lines") == 0 && more) { o.lines = strtoul(argv[++i], NULL, 10); continue; }
+        if (strcmp(a, "--commands") == 0 && more) { o.commands = atoi(argv[++i]); continue; }
+        if (strcmp(a, "--max-args") == 0 && more) { o.max_args = atoi(argv[++i]); continue; }
+        if (strcmp(a, "--unknown") == 0 && more) { o.unknown = atof(argv[++i]); continue; }
+        if (strcmp(a, "--seed") == 0 && more) { o.seed = (unsigned)strtoul(argv[++i], NULL, 10); continue; }
+        if (strcmp(a, "--script") == 0 && more) { o.script = argv[++i]; continue; }
+        if (strcmp(a, "--out") == 0 && more) { o.out = argv[++i]; continue; }
+        if (strcmp(a, "--compare") == 0 && more) { o.compare = argv[++i]; continue; }
+        if (strcmp(a, "--threshold") == 0 && more) { o.threshold = atof(argv[++i]); continue; }
+        bench_usage(argv[0]);
+        return 2;
+    }
+    if (o.commands < 1) o.commands = 1;
+    if (o.max_args < 0) o.max_args = 0;
+
+    /* cmd00000 .. cmdNNNNN, all no-ops */
+    struct term_cmd *cmds = (struct term_cmd *)calloc((size_t)o.commands + 1, sizeof(*cmds));
+    char *names = (char *)malloc((size_t)o.commands * 16);
+    if (!cmds || !names) {
+        fputs("[bench] ERROR out of memory\n", stderr);
+        return 2;
+    }
+    for (int i = 0; i < o.commands; ++i) {
+        snprintf(names + (size_t)i * 16, 16, "cmd%05d", i);
+        cmds[i].name = names + (size_t)i * 16;
+        cmds[i].help = "no-op";
+        cmds[i].fn = noop;
+    }
+    struct term_registry *reg = term_registry_new(cmds, o.commands);
+
+    const char *path = o.script ? o.script : generate_script(&o);
+    size_t len = 0;
+    char *text = path ? read_script(path, &len) : NULL;
+    if (!reg || !text) {
+        if (path && !text) fprintf(stderr, "[bench] ERROR reading %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+    size_t lines = 0;
+    for (const char *p = text; (p = (const char *)memchr(p, '\n', (size_t)(text + len - p))) != NULL; ++p) ++lines;
+    if (len && text[len - 1] != '\n') ++lines;
+    fprintf(stderr, "[bench] %zu lines (%s), %d commands%s\n", lines, o.script ? o.script : "generated", o.commands,
+            BENCH_COUNTS_ALLOCS ? "" : "; allocations are not counted on this platform");
+
+    /* Unknown commands are reported on term_err(). */
+    FILE *devnull = fopen("/dev/null", "w");
+    term_set_output(devnull, devnull);
+
+    struct mode_result res[3];
+    memset(res, 0, sizeof(res));
+    res[0].mode = "exec";
+    res[1].mode = "repl";
+    res[2].mode = "batch";
+    int failed = run_exec(reg, text, len, NULL) != 0 || run_exec(reg, text, len, &res[0]) != 0 ||
+                 run_loop(reg, path, 0, lines, &res[1]) != 0 || run_loop(reg, path, 1, lines, &res[2]) != 0;
+
+    term_set_output(NULL, NULL);
+    if (devnull) fclose(devnull);
+    if (!o.script) unlink(path);
+    free(text);
+    term_registry_free(reg);
+    free(names);
+    free(cmds);
+    if (failed) {
+        fputs("[bench] ERROR replay failed\n", stderr);
+        return 2;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        fprintf(stderr, "%-6s %10.0f lines/s  allocs/line %6.3f", res[i].mode, res[i].lines_per_s,
+                res[i].allocs_per_line);
+        if (i == 0)
+            fprintf(stderr, "  p50 %6.0f ns  p99 %6.0f ns  p99.9 %7.0f ns", res[i].p50_ns, res[i].p99_ns,
+                    res[i].p999_ns);
+        fputc('\n', stderr);
+    }
+
+    if (o.out) {
+        FILE *f = fopen(o.out, "w");
+        if (!f || write_results(f, res, 3) != 0 || fclose(f) != 0) {
+            fprintf(stderr, "[bench] ERROR writing %s\n", o.out);
+            return 2;
+        }
+        fprintf(stderr, "[bench] baseline written to %s\n", o.out);
+    } else if (!o.compare) {
+        write_results(stdout, res, 3);
+    }
+    return o.compare ? compare_baseline(o.compare, res, 3, o.threshold) : 0;
+}
@@ -0,0 +1,623 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* flock, localtime_r */
+#endif
+
+#include "terminal_history.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/**
+ * @file terminal_history.c
+ * @brief Memory-mapped history ring shared by concurrent sessions.
+ *
+ * File layout: a HIST_HEADER-byte header followed by the ring. Records are
+ * addressed by logical offset (bytes reserved before them, never reused);
+ * the ring position is the offset modulo the ring size. Every record
+ * starts on a HIST_ALIGN boundary, so its fixed-size head never wraps while
+ * its text may. A record stores its own logical offset and a checksum, which
+ * is written last: bytes left from an earlier lap, a half-written record
+ * and a record being overwritten all fail validation, and a reader that hits
+ * one steps forward HIST_ALIGN bytes at a time to the next valid record.
+ *
+ * The header index divides the ring into HIST_SEGMENTS segments and keeps,
+ * per segment boundary, where the first record at or after it starts, so
+ * the newest entries can be listed without reading the whole ring.
+ */
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HIST_MAGIC      "OSTTHST1"
+#define HIST_VERSION    1u
+#define HIST_HEADER     4096u
+#define HIST_SEGMENTS   64u
+#define HIST_ALIGN      32u
+#define HIST_MIN_SIZE   ((uint64_t)64 << 10)
+#define HIST_MAX_TEXT   65536u
+
+struct hist_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t data_size;             /* ring bytes */
+    uint64_t reserved;              /* logical bytes handed out so far (atomic) */
+    uint64_t seq;                   /* entries appended so far (atomic) */
+    uint64_t index[HIST_SEGMENTS];  /* boundary k: first record start >= k * segment, slot k % HIST_SEGMENTS */
+};
+
+struct hist_rec {
+    uint64_t off;       /* logical offset of this record */
+    uint64_t seq;
+    int64_t when;
+    uint32_t len;       /* text bytes, not NUL-terminated */
+    uint32_t sum;       /* FNV-1a of the fields above and the text; stored last, 0 = not committed */
+};
+
+/* One indexed entry; its text is a NUL-terminated copy in the arena. */
+struct hist_entry {
+    uint64_t off;
+    uint64_t seq;
+    int64_t when;
+    size_t text;
+};
+
+/* Posting list of the entries containing one trigram, in ascending order. */
+struct gram {
+    uint32_t key;       /* 0x1000000 | trigram; 0 = empty slot */
+    uint32_t n, cap;
+    uint32_t *ids;
+};
+
+struct term_history {
+    struct hist_header *hdr;
+    unsigned char *data;
+    size_t maplen;
+    uint64_t size, seg;
+    uint32_t max_text;
+
+    pthread_mutex_t mu;     /* everything below; appends do not take it */
+    char *buf;              /* text of the record being read */
+    size_t bufcap;
+    struct hist_entry *ent;
+    size_t nent, entcap;
+    size_t first;           /* entries before this one have been overwritten in the file */
+    char *text;
+    size_t textlen, textcap;
+    struct gram *grams;
+    size_t ngrams, gramcap; /* gramcap is a power of two */
+    uint64_t indexed;       /* logical offset the index is complete up to */
+};
+
+static uint64_t rec_size(uint32_t len) {
+    return (sizeof(struct hist_rec) + len + HIST_ALIGN - 1) & ~(uint64_t)(HIST_ALIGN - 1);
+}
+
+static uint32_t fnv(uint32_t h, const void *p, size_t n) {
+    const unsigned char *s = (const unsigned char *)p;
+    while (n--) h = (h ^ *s++) * 16777619u;
+    return h;
+}
+
+static uint32_t rec_sum(const struct hist_rec *r, const char *text) {
+    uint32_t h = 2166136261u;
+    h = fnv(h, &r->off, sizeof(r->off));
+    h = fnv(h, &r->seq, sizeof(r->seq));
+    h = fnv(h, &r->when, sizeof(r->when));
+    h = fnv(h, &r->len, sizeof(r->len));
+    h = fnv(h, text, r->len);
+    return h ? h : 1;
+}
+
+/* ---- file ----------------------------------------------------------------- */
+
+/*
+ * Whether the file still has to be initialized: empty, or left behind by a
+ * creator that died between sizing it and storing the magic (which goes last).
+ */
+static int needs_init(int fd, off_t filesize) {
+    static const char zero[8] = {0};
+    char magic[8];
+    if (filesize == 0) return 1;
+    if (pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic)) return filesize < (off_t)sizeof(magic);
+    return memcmp(magic, zero, sizeof(magic)) == 0;
+}
+
+static int header_ok(const struct hist_header *hdr, off_t filesize) {
+    return memcmp(hdr->magic, HIST_MAGIC, 8) == 0 && hdr->version == HIST_VERSION &&
+           hdr->header_size == HIST_HEADER && hdr->data_size >= HIST_MIN_SIZE &&
+           hdr->data_size % (HIST_SEGMENTS * HIST_ALIGN) == 0 &&
+           (uint64_t)filesize == HIST_HEADER + hdr->data_size;
+}
+
+struct term_history *term_history_open(const char *path, size_t size, const char **err) {
+    const char *why = "cannot open history file";
+    struct term_history *h = NULL;
+    struct hist_header probe;
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) goto fail;
+
+    /* Creation is the only step that locks: sessions starting together must not both initialize. */
+    if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) goto fail;
+    if (needs_init(fd, st.st_size)) {
+        uint64_t n = size ? size : TERM_HISTORY_DEFAULT_SIZE;
+        if (n < HIST_MIN_SIZE) n = HIST_MIN_SIZE;
+        n = (n + HIST_SEGMENTS * HIST_ALIGN - 1) / (HIST_SEGMENTS * HIST_ALIGN) * (HIST_SEGMENTS * HIST_ALIGN);
+        struct hist_header hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.version = HIST_VERSION;
+        hdr.header_size = HIST_HEADER;
+        hdr.data_size = n;
+        why = "cannot create history file";
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)(HIST_HEADER + n)) != 0 ||
+            pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+            pwrite(fd, HIST_MAGIC, 8, 0) != 8 || fstat(fd, &st) != 0)
+            goto fail;
+    }
+    flock(fd, LOCK_UN);
+
+    why = "not a history file";
+    if (pread(fd, &probe, sizeof(probe), 0) != (ssize_t)sizeof(probe) || !header_ok(&probe, st.st_size)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    why = "out of memory";
+    h = (struct term_history *)calloc(1, sizeof(*h));
+    if (!h) goto fail;
+    why = "cannot map history file";
+    h->maplen = (size_t)st.st_size;
+    map = mmap(NULL, h->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) goto fail;
+    close(fd);
+    h->hdr = (struct hist_header *)map;
+    h->data = (unsigned char *)map + HIST_HEADER;
+    h->size = h->hdr->data_size;
+    h->seg = h->size / HIST_SEGMENTS;
+    h->max_text = (uint32_t)(h->seg - sizeof(struct hist_rec) < HIST_MAX_TEXT ? h->seg - sizeof(struct hist_rec)
+                                                                               : HIST_MAX_TEXT);
+    pthread_mutex_init(&h->mu, NULL);
+    return h;
+
+fail:
+    if (fd >= 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+    }
+    free(h);
+    if (err) *err = why;
+    return NULL;
+}
+
+static void index_reset(struct term_history *h) {
+    for (size_t i = 0; i < h->gramcap; ++i) free(h->grams[i].ids);
+    free(h->grams);
+    free(h->ent);
+    free(h->text);
+    h->grams = NULL;
+    h->ngrams = h->gramcap = 0;
+    h->ent = NULL;
+    h->nent = h->entcap = h->first = 0;
+    h->text = NULL;
+    h->textlen = h->textcap = 0;
+    h->indexed = 0;
+}
+
+void term_history_close(struct term_history *h) {
+    if (!h) return;
+    munmap(h->hdr, h->maplen);
+    index_reset(h);
+    free(h->buf);
+    pthread_mutex_destroy(&h->mu);
+    free(h);
+}
+
+/* ---- append --------------------------------------------------------------- */
+
+int term_history_add(struct term_history *h, const char *line) {
+    size_t n = line ? strlen(line) : 0;
+    if (!h || n == 0) return -1;
+    uint32_t len = n > h->max_text ? h->max_text : (uint32_t)n;
+    uint64_t total = rec_size(len);
+
+    struct hist_rec r;
+    r.off = __atomic_fetch_add(&h->hdr->reserved, total, __ATOMIC_RELAXED);
+    r.seq = __atomic_add_fetch(&h->hdr->seq, 1, __ATOMIC_RELAXED);
+    r.when = (int64_t)time(NULL);
+    r.len = len;
+    r.sum = rec_sum(&r, line);
+
+    uint64_t pos = r.off % h->size;
+    struct hist_rec *dst = (struct hist_rec *)(h->data + pos);
+    __atomic_store_n(&dst->sum, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(dst, &r, offsetof(struct hist_rec, sum));
+    pos += sizeof(r);
+    size_t first = h->size - pos < len ? (size_t)(h->size - pos) : len;
+    memcpy(h->data + pos, line, first);
+    memcpy(h->data, line + first, len - first);
+    __atomic_store_n(&dst->sum, r.sum, __ATOMIC_RELEASE);
+
+    /* Records are at most one segment long, so at most one boundary falls inside this one. */
+    uint64_t end = r.off + total;
+    if (r.off % h->seg == 0) {
+        __atomic_store_n(&h->hdr->index[(r.off / h->seg) % HIST_SEGMENTS], r.off, __ATOMIC_RELEASE);
+    } else {
+        uint64_t k = r.off / h->seg + 1;
+        if (k * h->seg <= end) __atomic_store_n(&h->hdr->index[k % HIST_SEGMENTS], end, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/* ---- read ----------------------------------------------------------------- */
+
+/*
+ * Copies the record at logical offset @p pos into *r and h->buf (NUL-terminated).
+ * Returns -1 if no committed record starts there.
+ */
+static int read_rec(struct term_history *h, uint64_t pos, struct hist_rec *r) {
+    const struct hist_rec *src = (const struct hist_rec *)(h->data + pos % h->size);
+    uint32_t sum = __atomic_load_n(&src->sum, __ATOMIC_ACQUIRE);
+    if (sum == 0) return -1;
+    memcpy(r, src, sizeof(*r));
+    if (r->off != pos || r->len == 0 || r->len > h->max_text) return -1;
+    if (h->bufcap <= r->len) {
+        char *b = (char *)realloc(h->buf, (size_t)h->max_text + 1);
+        if (!b) return -1;
+        h->buf = b;
+        h->bufcap = (size_t)h->max_text + 1;
+    }
+    uint64_t at = (pos + sizeof(*r)) % h->size;
+    size_t first = h->size - at < r->len ? (size_t)(h->size - at) : r->len;
+    memcpy(h->buf, h->data + at, first);
+    memcpy(h->buf + first, h->data, r->len - first);
+    h->buf[r->len] = '\0';
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    /* A writer that started overwriting meanwhile has cleared or changed the sum. */
+    if (rec_sum(r, h->buf) != sum || __atomic_load_n(&src->sum, __ATOMIC_RELAXED) != sum) return -1;
+    return 0;
+}
+
+/* Calls fn for each committed record starting in [from, to); returns where the walk stopped. */
+static uint64_t walk(struct term_history *h, uint64_t from, uint64_t to,
+                     int (*fn)(struct term_history *h, const struct hist_rec *r, void *arg), void *arg) {
+    uint64_t pos = from;
+    struct hist_rec r;
+    while (pos < to) {
+        if (read_rec(h, pos, &r) != 0) {
+            uint64_t next = pos + HIST_ALIGN;
+            while (next < to && read_rec(h, next, &r) != 0) next += HIST_ALIGN;
+            /* Nothing valid after it: the record is still being written, stop in front of it. */
+            if (next >= to) break;
+            pos = next;
+        }
+        if (fn && fn(h, &r, arg) != 0) return pos;
+        pos += rec_size(r.len);
+    }
+    return pos;
+}
+
+static uint64_t ring_tail(const struct term_history *h, uint64_t head) {
+    return head > h->size ? head - h->size : 0;
+}
+
+/* Where to start reading for records at or after segment boundary k (see the header index). */
+static uint64_t boundary_start(const struct term_history *h, uint64_t k, uint64_t tail) {
+    uint64_t b = k * h->seg;
+    if (b <= tail) return tail;
+    uint64_t c = __atomic_load_n(&h->hdr->index[k % HIST_SEGMENTS], __ATOMIC_ACQUIRE);
+    /* Anything outside the segment is left from an earlier lap (or not written yet). */
+    return c >= b && c < b + h->seg ? c : UINT64_MAX;
+}
+
+/* ---- search index --------------------------------------------------------- */
+
+static struct gram *gram_find(const struct term_history *h, uint32_t key) {
+    if (!h->gramcap) return NULL;
+    for (size_t i = (key * 2654435761u) & (h->gramcap - 1);; i = (i + 1) & (h->gramcap - 1)) {
+        if (h->grams[i].key == key) return &h->grams[i];
+        if (h->grams[i].key == 0) return NULL;
+    }
+}
+
+static struct gram *gram_get(struct term_history *h, uint32_t key) {
+    struct gram *g = gram_find(h, key);
+    if (g) return g;
+    if ((h->ngrams + 1) * 4 > h->gramcap * 3) {
+        size_t cap = h->gramcap ? h->gramcap * 2 : 4096;
+        struct gram *grams = (struct gram *)calloc(cap, sizeof(*grams));
+        if (!grams) return NULL;
+        for (size_t i = 0; i < h->gramcap; ++i) {
+            if (!h->grams[i].key) continue;
+            size_t j = (h->grams[i].key * 2654435761u) & (cap - 1);
+            while (grams[j].key) j = (j + 1) & (cap - 1);
+            grams[j] = h->grams[i];
+        }
+        free(h->grams);
+        h->grams = grams;
+        h->gramcap = cap;
+    }
+    size_t i = (key * 2654435761u) & (h->gramcap - 1);
+    while (h->grams[i].key) i = (i + 1) & (h->gramcap - 1);
+    h->grams[i].key = key;
+    ++h->ngrams;
+    return &h->grams[i];
+}
+
+static uint32_t gram_key(const char *s) {
+    return 0x1000000u | (uint32_t)(unsigned char)s[0] << 16 | (uint32_t)(unsigned char)s[1] << 8 |
+           (unsigned char)s[2];
+}
+
+static int index_add(struct term_history *h, const struct hist_rec *r, void *arg) {
+    int *failed = (int *)arg;
+    uint32_t id = (uint32_t)h->nent;
+    struct hist_entry *e;
+    if (h->nent == h->entcap) {
+        size_t cap = h->entcap ? h->entcap * 2 : 1024;
+        struct hist_entry *ent = (struct hist_entry *)realloc(h->ent, cap * sizeof(*ent));
+        if (!ent) goto oom;
+        h->ent = ent;
+        h->entcap = cap;
+    }
+    if (h->textcap - h->textlen <= r->len) {
+        size_t cap = h->textcap ? h->textcap : 65536;
+        while (cap - h->textlen <= r->len) cap *= 2;
+        char *text = (char *)realloc(h->text, cap);
+        if (!text) goto oom;
+        h->text = text;
+        h->textcap = cap;
+    }
+    for (uint32_t i = 0; i + 3 <= r->len; ++i) {
+        struct gram *g = gram_get(h, gram_key(h->buf + i));
+        if (!g) goto oom;
+        if (g->n && g->ids[g->n - 1] == id) continue;
+        if (g->n == g->cap) {
+            uint32_t cap = g->cap ? g->cap * 2 : 4;
+            uint32_t *ids = (uint32_t *)realloc(g->ids, cap * sizeof(*ids));
+            if (!ids) goto oom;
+            g->ids = ids;
+            g->cap = cap;
+        }
+        g->ids[g->n++] = id;
+    }
+    e = &h->ent[h->nent++];
+    e->off = r->off;
+    e->seq = r->seq;
+    e->when = r->when;
+    e->text = h->textlen;
+    memcpy(h->text + h->textlen, h->buf, (size_t)r->len + 1);
+    h->textlen += (size_t)r->len + 1;
+    return 0;
+
+oom:
+    /* Posting lists may already name this id; dropping the index keeps them consistent. */
+    *failed = 1;
+    return 1;
+}
+
+/* Indexes the records appended since the last call. */
+static int index_refresh(struct term_history *h) {
+    uint64_t head = __atomic_load_n(&h->hdr->reserved, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring_tail(h, head);
+    while (h->first < h->nent && h->ent[h->first].off < tail) ++h->first;
+    /* Overwritten entries are skipped by searches; once they are most of the index, start over. */
+    if (h->first > 4096 && h->first * 2 > h->nent) index_reset(h);
+    int failed = 0;
+    h->indexed = walk(h, h->indexed < tail ? tail : h->indexed, head, index_add, &failed);
+    if (failed) index_reset(h);
+    return failed ? -1 : 0;
+}
+
+/* ---- search --------------------------------------------------------------- */
+
+struct recent {
+    uint64_t skip;      /* records to pass over before reporting */
+    long reported;
+    void (*fn)(unsigned long long, long long, const char *, void *);
+    void *arg;
+};
+
+static int count_rec(struct term_history *h, const struct hist_rec *r, void *arg) {
+    (void)h; (void)r;
+    ++*(uint64_t *)arg;
+    return 0;
+}
+
+static int report_rec(struct term_history *h, const struct hist_rec *r, void *arg) {
+    struct recent *q = (struct recent *)arg;
+    if (q->skip) {
+        --q->skip;
+        return 0;
+    }
+    q->fn(r->seq, r->when, h->buf, q->arg);
+    ++q->reported;
+    return 0;
+}
+
+/*
+ * The newest @p limit records straight from the file: walks back one
+ * segment at a time through the header index until enough are found, so
+ * the cost follows @p limit and not the size of the ring.
+ */
+static long search_recent(struct term_history *h, size_t limit,
+                          void (*fn)(unsigned long long, long long, const char *, void *), void *arg) {
+    uint64_t head = __atomic_load_n(&h->hdr->reserved, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring_tail(h, head);
+    uint64_t found = 0, start = head, end = head;
+    for (uint64_t k = head / h->seg + 1; k-- > 0 && found < limit && start > tail;) {
+        uint64_t s = boundary_start(h, k, tail);
+        if (s == UINT64_MAX || s >= end) continue;
+        walk(h, s, end, count_rec, &found);
+        start = end = s;
+    }
+    struct recent q = {found > limit ? found - limit : 0, 0, fn, arg};
+    walk(h, start, head, report_rec, &q);
+    return q.reported;
+}
+
+long term_history_search(struct term_history *h, const char *text, unsigned flags, size_t limit,
+                         void (*fn)(unsigned long long seq, long long when, const char *line, void *arg),
+                         void *arg) {
+    size_t tlen = text ? strlen(text) : 0;
+    pthread_mutex_lock(&h->mu);
+    if (tlen == 0 && limit > 0) {
+        long n = search_recent(h, limit, fn, arg);
+        pthread_mutex_unlock(&h->mu);
+        return n;
+    }
+    if (index_refresh(h) != 0) {
+        pthread_mutex_unlock(&h->mu);
+        return -1;
+    }
+
+    /* Candidates: every entry, or the posting list of the text's rarest trigram. */
+    const uint32_t *cand = NULL;
+    size_t ncand = h->nent;
+    if (tlen >= 3) {
+        const struct gram *best = NULL;
+        for (size_t i = 0; i + 3 <= tlen; ++i) {
+            const struct gram *g = gram_find(h, gram_key(text + i));
+            if (!g) {
+                best = NULL;
+                break;
+            }
+            if (!best || g->n < best->n) best = g;
+        }
+        cand = best ? best->ids : NULL;
+        ncand = best ? best->n : 0;
+    }
+
+    size_t cap = limit ? limit : 64, nhits = 0;
+    size_t *hits = (size_t *)malloc(cap * sizeof(*hits));
+    long ret = -1;
+    if (!hits) goto out;
+    for (size_t i = ncand; i-- > 0 && (!limit || nhits < limit);) {
+        size_t id = cand ? cand[i] : i;
+        if (id < h->first) break;
+        const char *s = h->text + h->ent[id].text;
+        if (tlen && !((flags & TERM_HISTORY_PREFIX) ? strncmp(s, text, tlen) == 0 : strstr(s, text) != NULL))
+            continue;
+        if (nhits == cap) {
+            size_t *more = (size_t *)realloc(hits, cap * 2 * sizeof(*hits));
+            if (!more) goto out;
+            hits = more;
+            cap *= 2;
+        }
+        hits[nhits++] = id;
+    }
+    for (size_t i = nhits; i-- > 0;) {
+        const struct hist_entry *e = &h->ent[hits[i]];
+        fn(e->seq, e->when, h->text + e->text, arg);
+    }
+    ret = (long)nhits;
+out:
+    free(hits);
+    pthread_mutex_unlock(&h->mu);
+    return ret;
+}
+
+#else /* _WIN32 */
+
+struct term_history *term_history_open(const char *path, size_t size, const char **err) {
+    (void)path; (void)size;
+    if (err) *err = "history is not available on this platform";
+    errno = ENOSYS;
+    return NULL;
+}
+
+void term_history_close(struct term_history *h) { (void)h; }
+
+int term_history_add(struct term_history *h, const char *line) {
+    (void)h; (void)line;
+    return -1;
+}
+
+long term_history_search(struct term_history *h, const char *text, unsigned flags, size_t limit,
+                         void (*fn)(unsigned long long seq, long long when, const char *line, void *arg),
+                         void *arg) {
+    (void)h; (void)text; (void)flags; (void)limit; (void)fn; (void)arg;
+    return -1;
+}
+
+#endif /* _WIN32 */
+
+/* ---- `history` command ---------------------------------------------------- */
+
+static void print_entry(unsigned long long seq, long long when, const char *line, void *arg) {
+    char stamp[32] = "";
+    time_t t = (time_t)when;
+    struct tm tm;
+#ifdef _WIN32
+    if (localtime_s(&tm, &t) == 0)
+#else
+    if (localtime_r(&t, &tm))
+#endif
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf((FILE *)arg, "%6llu  %s  %s\n", seq, stamp, line);
+}
+
+int term_history_cmd(int argc, char **argv, void *ctx) {
+    struct term_history *h = (struct term_history *)ctx;
+    unsigned flags = 0;
+    size_t limit = 20;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        char *end = NULL;
+        if (strcmp(argv[i], "--") == 0) {
+            ++i;
+            break;
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            flags |= TERM_HISTORY_PREFIX;
+            continue;
+        }
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) {
+            limit = strtoul(argv[++i], &end, 10);
+            if (!*end) continue;
+        }
+        fputs("usage: history [-n COUNT] [-p] [TEXT]\n", term_err());
+        return 1;
+    }
+    if (!h) {
+        fputs("history: no history file\n", term_err());
+        return 1;
+    }
+
+    /* The remaining words are one search text: `history git commit`. */
+    char *text = NULL;
+    size_t len = 0;
+    for (int j = i; j < argc; ++j) len += strlen(argv[j]) + 1;
+    if (len) {
+        text = (char *)malloc(len);
+        if (!text) {
+            fputs("terminal: out of memory\n", term_err());
+            return 1;
+        }
+        text[0] = '\0';
+        for (int j = i; j < argc; ++j) {
+            if (j > i) strcat(text, " ");
+            strcat(text, argv[j]);
+        }
+    }
+    long n = term_history_search(h, text, flags, limit, print_entry, term_out());
+    free(text);
+    if (n < 0) {
+        fputs("history: out of memory\n", term_err());
+        return 1;
+    }
+    return n == 0 && len ? 1 : 0;  /* like grep: a search without matches fails */
+}
@@ -0,0 +1,98 @@
+#ifndef TERMINAL_HISTORY_H
+#define TERMINAL_HISTORY_H
+
+/**
+ * @file terminal_history.h
+ * @brief Persistent command history shared by concurrent terminal sessions.
+ *
+ * The history is a fixed-size ring of records in a memory-mapped file. A
+ * one-page header holds the ring size, the number of bytes ever reserved
+ * and a sparse index of record starts, so opening a file costs the same
+ * regardless of its size: nothing is read until the first search. Writers
+ * reserve space with a single atomic add on the shared header and never
+ * take a lock; a record becomes visible when its checksum is stored last,
+ * so a session that dies mid-append leaves a record readers skip. When the
+ * ring is full the oldest records are overwritten.
+ *
+ * Searches run over an in-memory trigram index that is built on first use
+ * and extended with the records appended since. POSIX only; elsewhere
+ * term_history_open() fails.
+ */
+
+#include <stddef.h>
+
+#include "terminal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Ring size used when a new history file is created with size 0 (4 MiB). */
+#define TERM_HISTORY_DEFAULT_SIZE ((size_t)4 << 20)
+
+/** @brief An open history file and this process's search index over it. */
+struct term_history;
+
+/**
+ * @brief Open the history at @p path, creating it with a ring of @p size bytes if needed.
+ *
+ * An existing file keeps the size it was created with. Any number of
+ * processes may have the same file open.
+ *
+ * @param size Ring bytes for a new file (0 = TERM_HISTORY_DEFAULT_SIZE); at least 64 KiB,
+ *             rounded up to a multiple of 2 KiB.
+ * @param err Receives a static description when NULL is returned (errno is set as well).
+ * @return The history, or NULL if the file cannot be opened or is not a history file.
+ */
+struct term_history *term_history_open(const char *path, size_t size, const char **err);
+
+/** @brief Unmap and free a history (NULL is ignored). */
+void term_history_close(struct term_history *h);
+
+/**
+ * @brief Append @p line; safe to call from several threads and processes at once.
+ *
+ * Lines longer than a sixty-fourth of the ring (at most 64 KiB) are truncated.
+ *
+ * @return 0 on success, -1 if @p line is empty or the history is NULL.
+ */
+int term_history_add(struct term_history *h, const char *line);
+
+/** @brief Search flag: @p text must match at the start of the line. */
+#define TERM_HISTORY_PREFIX 0x1u
+
+/**
+ * @brief Report the newest entries containing (or starting with) @p text, oldest first.
+ *
+ * @param text Substring to look for; NULL or "" matches every entry.
+ * @param limit Most recent matches to report; 0 = all.
+ * @param fn Called with each entry's sequence number, time and text.
+ * @return Number of entries reported, or -1 on allocation failure.
+ */
+long term_history_search(struct term_history *h, const char *text, unsigned flags, size_t limit,
+                         void (*fn)(unsigned long long seq, long long when, const char *line, void *arg),
+                         void *arg);
+
+/**
+ * @brief Handler for the `history [-n COUNT] [-p] [TEXT]` command; @p ctx is the term_history.
+ *
+ * Prints the last COUNT (default 20, 0 = all) entries containing TEXT, or
+ * starting with it with -p, on term_out(). Registered automatically as a
+ * builtin by terminal_set_history().
+ */
+int term_history_cmd(int argc, char **argv, void *ctx);
+
+/**
+ * @brief Use @p h for the interactive loop; NULL turns history off again.
+ *
+ * terminal_run() and terminal_run_registry() then append every non-blank
+ * line they read, and REPL and batch sessions get a `history` builtin.
+ * The history is not closed by the terminal.
+ */
+void terminal_set_history(struct term_history *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TERMINAL_HISTORY_H */
@@ -0,0 +1,704 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* accept4, sched_getaffinity */
+#endif
+
+#include "terminal_server.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/**
+ * @file terminal_server.c
+ * @brief epoll front end that runs term_registry commands for network clients.
+ *
+ * Every loop owns its connections outright, so nothing on the request path
+ * takes a lock. Input is read into a per-loop scratch buffer and lines are
+ * run straight from there; a connection only allocates when a line arrives
+ * in pieces or the socket will not take all of a reply. Handler output is
+ * captured through a per-loop memory stream installed with term_set_output()
+ * and sent with one send() per batch of lines (or frames). While a client has unsent
+ * output its socket is not read, which pushes back on the sender through TCP
+ * flow control instead of buffering without bound.
+ */
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define READ_CHUNK      (16 * 1024)
+#define CAPTURE_KEEP    (1 << 20)   /* capture buffers above this are released after use */
+#define MAX_EVENTS      256
+#define ACCEPT_BATCH    64
+
+enum conn_mode { CONN_NEW, CONN_LINES, CONN_FRAMES };
+
+struct conn {
+    int fd;
+    enum conn_mode mode;    /* CONN_NEW until the first bytes show the protocol */
+    uint32_t events;        /* interest registered with epoll */
+    int eof;                /* client shut down its side */
+    int closing;            /* `exit`, oversized line or error: close once output is sent */
+    int status;             /* last failing command (not reported; kept for parity with the REPL) */
+    char *in;               /* input not run yet: a partial line or lines held back */
+    size_t inlen, incap;
+    char *out;              /* output the socket did not take yet */
+    size_t outoff, outlen, outcap;
+    struct term_args args;
+    struct conn *prev, *next;
+};
+
+struct worker {
+    const struct term_registry *reg;
+    const struct term_serve_config *cfg;
+    pthread_t thread;
+    int ep;
+    int tcp_fd;             /* this loop's SO_REUSEPORT listener, -1 if none */
+    int unix_fd;            /* shared by all loops, -1 if none */
+    int paused;             /* listeners are out of the epoll set */
+    int nconns, max_conns;
+    struct conn *conns;
+    char *scratch;          /* READ_CHUNK + 1 bytes */
+    FILE *capture;          /* term_out()/term_err() of this loop */
+    char *cap_buf;
+    size_t cap_len;
+};
+
+static int g_stop_fd = -1;
+static volatile sig_atomic_t g_stop_requested;
+
+void terminal_serve_stop(void) {
+    g_stop_requested = 1;
+    int fd = g_stop_fd;
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t n = write(fd, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+/* ---- buffers -------------------------------------------------------------- */
+
+/* Grows *buf to hold at least @p need bytes (plus a spare byte for a NUL). */
+static int reserve(char **buf, size_t *cap, size_t need) {
+    if (need < *cap) return 0;
+    size_t n = *cap ? *cap : 4096;
+    while (n <= need) n *= 2;
+    char *p = (char *)realloc(*buf, n);
+    if (!p) return -1;
+    *buf = p;
+    *cap = n;
+    return 0;
+}
+
+/* Sends as much of p[0..n) as the socket takes; returns the byte count or -1 if the peer is gone. */
+static ssize_t send_some(int fd, const char *p, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t k = send(fd, p + done, n - done, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (k > 0) { done += (size_t)k; continue; }
+        if (k < 0 && errno == EINTR) continue;
+        if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        return -1;
+    }
+    return (ssize_t)done;
+}
+
+/* ---- connections ---------------------------------------------------------- */
+
+static void listeners_arm(struct worker *w, int on) {
+    if (w->paused == !on) return;
+    struct epoll_event ev;
+    if (w->tcp_fd >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = &w->tcp_fd;
+        epoll_ctl(w->ep, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, w->tcp_fd, &ev);
+    }
+    if (w->unix_fd >= 0) {
+        /* one loop wakes per connection instead of all of them */
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = &w->unix_fd;
+        epoll_ctl(w->ep, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, w->unix_fd, &ev);
+    }
+    w->paused = !on;
+}
+
+static void conn_close(struct worker *w, struct conn *c) {
+    close(c->fd);   /* also drops it from the epoll set */
+    free(c->in);
+    free(c->out);
+    term_args_free(&c->args);
+    if (c->prev) c->prev->next = c->next;
+    else w->conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    free(c);
+    w->nconns--;
+}
+
+/* Registers interest in output space while output is queued, otherwise in input. */
+static void conn_update(struct worker *w, struct conn *c) {
+    uint32_t want = c->outlen ? EPOLLOUT : EPOLLIN;
+    if (want == c->events) return;
+    struct epoll_event ev;
+    ev.events = want;
+    ev.data.ptr = c;
+    epoll_ctl(w->ep, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = want;
+}
+
+/*
+ * Sends what the handlers printed since the last call, queueing the part the
+ * socket does not take. Returns -1 if the connection is dead.
+ */
+static int conn_send(struct worker *w, struct conn *c) {
+    fflush(w->capture);
+    const char *p = w->cap_buf;
+    size_t n = w->cap_len;
+    int ret = 0;
+    if (n && c->outlen == 0) {
+        ssize_t k = send_some(c->fd, p, n);
+        if (k < 0) ret = -1;
+        else { p += k; n -= (size_t)k; }
+    }
+    if (ret == 0 && n) {
+        if (c->outoff) {
+            memmove(c->out, c->out + c->outoff, c->outlen);
+            c->outoff = 0;
+        }
+        if (reserve(&c->out, &c->outcap, c->outlen + n) != 0) ret = -1;
+        else {
+            memcpy(c->out + c->outlen, p, n);
+            c->outlen += n;
+        }
+    }
+    if (w->cap_len > CAPTURE_KEEP) {
+        /* a handler printed a lot; do not keep its buffer for the life of the loop */
+        fclose(w->capture);
+        free(w->cap_buf);
+        w->cap_buf = NULL;
+        w->capture = open_memstream(&w->cap_buf, &w->cap_len);
+        if (!w->capture) abort();
+        term_set_output(w->capture, w->capture);
+    } else {
+        fseeko(w->capture, 0, SEEK_SET);
+    }
+    return ret;
+}
+
+/*
+ * Runs the complete lines in buf[0..len) and returns the bytes consumed. At
+ * EOF an unterminated last line runs too (buf needs a spare byte for its
+ * NUL). Stops at `exit` and sets *held when it stops because max_pending
+ * bytes of output are waiting.
+ */
+static size_t run_lines(struct worker *w, struct conn *c, char *buf, size_t len, int *held) {
+    size_t pos = 0;
+    while (pos < len && !c->closing) {
+        if ((size_t)ftello(w->capture) >= w->cfg->max_pending) {
+            *held = 1;
+            break;
+        }
+        char *nl = (char *)memchr(buf + pos, '\n', len - pos);
+        if (!nl && !c->eof) break;
+        size_t end = nl ? (size_t)(nl - buf) : len;
+        size_t next = nl ? end + 1 : len;
+        if (end > pos && buf[end - 1] == '\r') --end;
+        buf[end] = '\0';
+        /* clients that send fixed-size records pad them with NULs */
+        while (pos < end && buf[pos] == '\0') ++pos;
+        if (terminal_exec_line(w->reg, &c->args, buf + pos, &c->status)) c->closing = 1;
+        else if (w->cfg->prompt) fputs(w->cfg->prompt, w->capture);
+        pos = next;
+    }
+    return pos;
+}
+
+static uint32_t get32(const char *p) {
+    const unsigned char *u = (const unsigned char *)p;
+    return (uint32_t)u[0] << 24 | (uint32_t)u[1] << 16 | (uint32_t)u[2] << 8 | u[3];
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/*
+ * Writes a reply header at @p start of the capture stream, in front of the
+ * output captured since, and moves back to the end.
+ */
+static void reply_header(struct worker *w, off_t start, uint32_t id, int status) {
+    off_t end = ftello(w->capture);
+    unsigned char hdr[TERM_FRAME_HEADER];
+    put32(hdr, (uint32_t)(end - start - TERM_FRAME_HEADER));
+    put32(hdr + 4, id);
+    put32(hdr + 8, (uint32_t)status);
+    fseeko(w->capture, start, SEEK_SET);
+    fwrite(hdr, 1, sizeof(hdr), w->capture);
+    fseeko(w->capture, end, SEEK_SET);
+}
+
+/*
+ * Framed counterpart of run_lines(): runs every complete request in
+ * buf[0..len) and captures one reply frame for each.
+ */
+static size_t run_frames(struct worker *w, struct conn *c, char *buf, size_t len, int *held) {
+    static const char blank[TERM_FRAME_HEADER] = {0};
+    size_t pos = 0;
+    while (len - pos >= TERM_FRAME_HEADER && !c->closing) {
+        off_t start = ftello(w->capture);
+        if ((size_t)start >= w->cfg->max_pending) {
+            *held = 1;
+            break;
+        }
+        uint32_t n = get32(buf + pos), id = get32(buf + pos + 4);
+        if (n > w->cfg->max_line) {
+            fwrite(blank, 1, sizeof(blank), w->capture);
+            fprintf(w->capture, "Request too long (limit %zu bytes)\n", w->cfg->max_line);
+            reply_header(w, start, id, 1);
+            c->closing = 1;
+            break;
+        }
+        if (len - pos - TERM_FRAME_HEADER < n) break;
+        /* the byte after the payload is the next frame's (or the spare one); borrow it for the NUL */
+        char *line = buf + pos + TERM_FRAME_HEADER;
+        char saved = line[n];
+        line[n] = '\0';
+        int status = 0;
+        fwrite(blank, 1, sizeof(blank), w->capture);
+        if (terminal_exec_line(w->reg, &c->args, line, &status)) c->closing = 1;
+        line[n] = saved;
+        reply_header(w, start, id, status);
+        if (status) c->status = status;
+        pos += TERM_FRAME_HEADER + n;
+    }
+    return pos;
+}
+
+/*
+ * Runs what can be run of buf[0..len) in the connection's protocol and
+ * returns the bytes consumed; *held is set when output is backing up.
+ */
+static size_t conn_run(struct worker *w, struct conn *c, char *buf, size_t len, int *held) {
+    size_t pos = 0;
+    *held = 0;
+    if (c->mode == CONN_NEW && len) {
+        /* A line never starts with the hello's NUL (padding only follows a newline). */
+        if (buf[0] != '\0') {
+            c->mode = CONN_LINES;
+        } else if (len >= TERM_FRAME_HELLO_LEN) {
+            c->mode = memcmp(buf, TERM_FRAME_HELLO, TERM_FRAME_HELLO_LEN) == 0 ? CONN_FRAMES : CONN_LINES;
+        } else if (c->eof) {
+            c->mode = CONN_LINES;
+        }
+        if (c->mode == CONN_FRAMES) {
+            fwrite(TERM_FRAME_HELLO, 1, TERM_FRAME_HELLO_LEN, w->capture);
+            pos = TERM_FRAME_HELLO_LEN;
+        }
+    }
+    if (c->mode == CONN_LINES) pos += run_lines(w, c, buf + pos, len - pos, held);
+    else if (c->mode == CONN_FRAMES) pos += run_frames(w, c, buf + pos, len - pos, held);
+    return pos;
+}
+
+/* Runs the input in buf[0..len) (the scratch buffer or c->in) and sends the replies. */
+static void conn_input(struct worker *w, struct conn *c, char *buf, size_t len) {
+    int held;
+    do {
+        size_t used = conn_run(w, c, buf, len, &held);
+        size_t rest = len - used;
+        if (buf == c->in) {
+            if (used && rest) memmove(c->in, c->in + used, rest);
+        } else if (rest) {
+            if (reserve(&c->in, &c->incap, rest) != 0) {
+                conn_close(w, c);
+                return;
+            }
+            memcpy(c->in, buf + used, rest);
+        }
+        c->inlen = rest;
+        if (c->mode == CONN_LINES && c->inlen > w->cfg->max_line && !memchr(c->in, '\n', c->inlen)) {
+            fprintf(w->capture, "Line too long (limit %zu bytes)\n", w->cfg->max_line);
+            c->closing = 1;
+            c->inlen = 0;
+        }
+        if (c->inlen == 0) {
+            free(c->in);
+            c->in = NULL;
+            c->incap = 0;
+        }
+        if (conn_send(w, c) != 0) {
+            conn_close(w, c);
+            return;
+        }
+        buf = c->in;
+        len = c->inlen;
+    } while (held && c->outlen == 0 && !c->closing);
+
+    if ((c->closing || (c->eof && c->inlen == 0)) && c->outlen == 0) {
+        conn_close(w, c);
+        return;
+    }
+    conn_update(w, c);
+}
+
+static void conn_readable(struct worker *w, struct conn *c) {
+    char *dst;
+    size_t room;
+    if (c->inlen) {
+        if (reserve(&c->in, &c->incap, c->inlen + READ_CHUNK) != 0) {
+            conn_close(w, c);
+            return;
+        }
+        dst = c->in + c->inlen;
+        room = c->incap - c->inlen - 1;
+    } else {
+        dst = w->scratch;
+        room = READ_CHUNK;
+    }
+    ssize_t n = recv(c->fd, dst, room, 0);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) conn_close(w, c);
+        return;
+    }
+    if (n == 0) c->eof = 1;
+    if (c->inlen) conn_input(w, c, c->in, c->inlen + (size_t)n);
+    else conn_input(w, c, w->scratch, (size_t)n);
+}
+
+static void conn_writable(struct worker *w, struct conn *c) {
+    ssize_t k = send_some(c->fd, c->out + c->outoff, c->outlen);
+    if (k < 0) {
+        conn_close(w, c);
+        return;
+    }
+    c->outoff += (size_t)k;
+    c->outlen -= (size_t)k;
+    if (c->outlen) return;
+    free(c->out);
+    c->out = NULL;
+    c->outoff = c->outcap = 0;
+    /* lines held back by backpressure run now */
+    conn_input(w, c, c->in, c->inlen);
+}
+
+static void accept_clients(struct worker *w, int lfd) {
+    for (int i = 0; i < ACCEPT_BATCH; ++i) {
+        if (w->nconns >= w->max_conns) {
+            listeners_arm(w, 0);
+            return;
+        }
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            /* out of descriptors or memory: stop accepting and retry from the loop */
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) listeners_arm(w, 0);
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   /* fails harmlessly on AF_UNIX */
+
+        struct conn *c = (struct conn *)calloc(1, sizeof(*c));
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (!c || epoll_ctl(w->ep, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->next = w->conns;
+        if (c->next) c->next->prev = c;
+        w->conns = c;
+        w->nconns++;
+        if (w->cfg->prompt) {
+            fputs(w->cfg->prompt, w->capture);
+            conn_input(w, c, NULL, 0);
+        }
+    }
+}
+
+/* ---- event loops ---------------------------------------------------------- */
+
+static void *worker_main(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    struct epoll_event events[MAX_EVENTS];
+    term_set_output(w->capture, w->capture);
+
+    for (int running = 1; running;) {
+        /* paused listeners are retried every 100 ms: a descriptor may have been freed elsewhere */
+        int n = epoll_wait(w->ep, events, MAX_EVENTS, w->paused ? 100 : -1);
+        if (n < 0 && errno != EINTR) {
+            perror("terminal_serve: epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            void *p = events[i].data.ptr;
+            uint32_t ev = events[i].events;
+            if (p == &g_stop_fd) {
+                running = 0;
+            } else if (p == &w->tcp_fd) {
+                accept_clients(w, w->tcp_fd);
+            } else if (p == &w->unix_fd) {
+                accept_clients(w, w->unix_fd);
+            } else {
+                struct conn *c = (struct conn *)p;
+                if (ev & (EPOLLERR | EPOLLHUP)) conn_close(w, c);
+                else if (ev & EPOLLOUT) conn_writable(w, c);
+                else if (ev & EPOLLIN) conn_readable(w, c);
+            }
+        }
+        if (w->paused && w->nconns < w->max_conns) listeners_arm(w, 1);
+    }
+
+    while (w->conns) conn_close(w, w->conns);
+    term_set_output(NULL, NULL);
+    return NULL;
+}
+
+static int worker_init(struct worker *w) {
+    struct epoll_event ev;
+    w->ep = epoll_create1(EPOLL_CLOEXEC);
+    w->scratch = (char *)malloc(READ_CHUNK + 1);
+    w->capture = open_memstream(&w->cap_buf, &w->cap_len);
+    if (w->ep < 0 || !w->scratch || !w->capture) return -1;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_stop_fd;
+    if (epoll_ctl(w->ep, EPOLL_CTL_ADD, g_stop_fd, &ev) != 0) return -1;
+    w->paused = 1;
+    listeners_arm(w, 1);
+    return 0;
+}
+
+static void worker_free(struct worker *w) {
+    if (w->ep >= 0) close(w->ep);
+    if (w->tcp_fd >= 0) close(w->tcp_fd);
+    if (w->capture) fclose(w->capture);
+    free(w->cap_buf);
+    free(w->scratch);
+}
+
+/* ---- listeners ------------------------------------------------------------ */
+
+static int cpu_count(void) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) return CPU_COUNT(&set);
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void print_addr(const char *what, const struct sockaddr *sa, socklen_t len, int loops) {
+    char host[NI_MAXHOST], serv[NI_MAXSERV];
+    if (getnameinfo(sa, len, host, sizeof(host), serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+        strcpy(host, "?");
+        strcpy(serv, "?");
+    }
+    fprintf(stderr, "terminal_serve: listening on %s %s%s%s:%s (%d loops)\n", what, sa->sa_family == AF_INET6 ? "[" : "",
+            host, sa->sa_family == AF_INET6 ? "]" : "", serv, loops);
+}
+
+static int tcp_listen(const struct sockaddr *sa, socklen_t len) {
+    int fd = socket(sa->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1, zero = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 ||
+        (sa->sa_family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)) != 0) ||
+        bind(fd, sa, len) != 0 || listen(fd, SOMAXCONN) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Opens one SO_REUSEPORT listener per loop on the same address. The first
+ * candidate address that binds is used; with port 0 the other loops join
+ * the port the first one was given.
+ */
+static int open_tcp(struct worker *ws, int nw, const struct term_serve_config *cfg) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", cfg->port);
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    /* without a host, try the dual-stack wildcard before the IPv4-only one */
+    if (!cfg->host) hints.ai_family = AF_INET6;
+    int rc = getaddrinfo(cfg->host, port, &hints, &res);
+    if (rc != 0 && !cfg->host) {
+        hints.ai_family = AF_INET;
+        rc = getaddrinfo(NULL, port, &hints, &res);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "terminal_serve: %s: %s\n", cfg->host ? cfg->host : "*", gai_strerror(rc));
+        return -1;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t len = 0;
+    int err = 0;
+    for (struct addrinfo *ai = res; ai && ws[0].tcp_fd < 0; ai = ai->ai_next) {
+        ws[0].tcp_fd = tcp_listen(ai->ai_addr, ai->ai_addrlen);
+        if (ws[0].tcp_fd < 0) err = errno;
+    }
+    if (ws[0].tcp_fd < 0 && !cfg->host && err == EAFNOSUPPORT) {
+        struct sockaddr_in in4;
+        memset(&in4, 0, sizeof(in4));
+        in4.sin_family = AF_INET;
+        in4.sin_port = htons((uint16_t)cfg->port);
+        ws[0].tcp_fd = tcp_listen((struct sockaddr *)&in4, sizeof(in4));
+        if (ws[0].tcp_fd < 0) err = errno;
+    }
+    freeaddrinfo(res);
+    if (ws[0].tcp_fd < 0) {
+        fprintf(stderr, "terminal_serve: cannot listen on port %d: %s\n", cfg->port, strerror(err));
+        return -1;
+    }
+
+    len = sizeof(addr);
+    getsockname(ws[0].tcp_fd, (struct sockaddr *)&addr, &len);
+    for (int i = 1; i < nw; ++i) {
+        ws[i].tcp_fd = tcp_listen((struct sockaddr *)&addr, len);
+        if (ws[i].tcp_fd < 0) {
+            fprintf(stderr, "terminal_serve: SO_REUSEPORT listener %d: %s\n", i, strerror(errno));
+            return -1;
+        }
+    }
+    print_addr("tcp", (struct sockaddr *)&addr, len, nw);
+    return 0;
+}
+
+static int open_unix(const char *path, int loops) {
+    struct sockaddr_un sun;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+        fprintf(stderr, "terminal_serve: %s: socket path too long\n", path);
+        return -1;
+    }
+    strcpy(sun.sun_path, path);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);   /* left over from an earlier run */
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "terminal_serve: %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    fprintf(stderr, "terminal_serve: listening on unix %s (%d loops)\n", path, loops);
+    return fd;
+}
+
+/* Raises the soft descriptor limit to the hard one and returns the connection budget. */
+static int conn_budget(int loops) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return 1024;
+    if (rl.rlim_cur < rl.rlim_max) {
+        struct rlimit raised = rl;
+        raised.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &raised) == 0) rl = raised;
+    }
+    /* stdio, the stop event, the Unix listener, and an epoll fd plus a listener per loop */
+    long reserved = 32 + 2L * loops;
+    long n = rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > (1u << 30) ? (1L << 30) : (long)rl.rlim_cur;
+    return n > reserved ? (int)(n - reserved) : 1;
+}
+
+int terminal_serve(const struct term_registry *reg, const struct term_serve_config *user) {
+    struct term_serve_config cfg = *user;
+    if (cfg.threads <= 0) cfg.threads = cpu_count();
+    if (cfg.max_conns <= 0) cfg.max_conns = conn_budget(cfg.threads);
+    if (cfg.max_line == 0) cfg.max_line = 64 * 1024;
+    if (cfg.max_pending == 0) cfg.max_pending = 256 * 1024;
+    if (cfg.port < 0 && !cfg.unix_path) {
+        fputs("terminal_serve: no TCP port or Unix socket to listen on\n", stderr);
+        return -1;
+    }
+
+    int nw = cfg.threads, ret = -1, started = 0;
+    int unix_fd = -1;
+    struct worker *ws = (struct worker *)calloc((size_t)nw, sizeof(*ws));
+    if (!ws) return -1;
+    for (int i = 0; i < nw; ++i) {
+        ws[i].reg = reg;
+        ws[i].cfg = &cfg;
+        ws[i].ep = ws[i].tcp_fd = ws[i].unix_fd = -1;
+        ws[i].max_conns = (cfg.max_conns + nw - 1) / nw;
+    }
+
+    g_stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (g_stop_fd < 0) {
+        perror("terminal_serve: eventfd");
+        goto out;
+    }
+    if (cfg.port >= 0 && open_tcp(ws, nw, &cfg) != 0) goto out;
+    if (cfg.unix_path && (unix_fd = open_unix(cfg.unix_path, nw)) < 0) goto out;
+    for (int i = 0; i < nw; ++i) {
+        ws[i].unix_fd = unix_fd;
+        if (worker_init(&ws[i]) != 0) {
+            perror("terminal_serve: event loop setup");
+            goto out;
+        }
+    }
+    if (g_stop_requested) terminal_serve_stop();   /* stopped before the event existed */
+
+    for (; started < nw; ++started) {
+        errno = pthread_create(&ws[started].thread, NULL, worker_main, &ws[started]);
+        if (errno != 0) {
+            perror("terminal_serve: pthread_create");
+            terminal_serve_stop();
+            break;
+        }
+    }
+    for (int i = 0; i < started; ++i) pthread_join(ws[i].thread, NULL);
+    ret = started == nw ? 0 : -1;
+
+out:
+    for (int i = 0; i < nw; ++i) worker_free(&ws[i]);
+    free(ws);
+    if (unix_fd >= 0) {
+        close(unix_fd);
+        unlink(cfg.unix_path);
+    }
+    if (g_stop_fd >= 0) close(g_stop_fd);
+    g_stop_fd = -1;
+    g_stop_requested = 0;
+    return ret;
+}
+
+#else /* !__linux__ */
+
+int terminal_serve(const struct term_registry *reg, const struct term_serve_config *cfg) {
+    (void)reg;
+    (void)cfg;
+    fputs("terminal_serve: not supported on this platform (needs epoll)\n", stderr);
+    return -1;
+}
+
+void terminal_serve_stop(void) {}
+
+#endif
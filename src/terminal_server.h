@@ -0,0 +1,82 @@
+#ifndef TERMINAL_SERVER_H
+#define TERMINAL_SERVER_H
+
+/**
+ * @file terminal_server.h
+ * @brief Serve a term_registry to many network clients at once.
+ *
+ * Each client gets its own session: it sends command lines and receives
+ * everything the handlers print on term_out() and term_err(). One epoll
+ * event loop runs per CPU; TCP listeners are opened once per loop with
+ * SO_REUSEPORT so the kernel spreads new connections across them, and a
+ * Unix socket (for local tests) is shared by all loops. Connections are
+ * non-blocking and never get a thread of their own. Linux only.
+ *
+ * Handlers run concurrently on the loop threads and must be thread-safe.
+ * A handler blocks its loop (and every client on it) while it runs.
+ *
+ * Clients speak one of two protocols, told apart by the first bytes:
+ *   - lines: newline-terminated commands in, raw output back (telnet, nc);
+ *   - frames: a client that opens with TERM_FRAME_HELLO gets the same 4
+ *     bytes back and from then on sends requests and receives replies as
+ *     frames (see TERM_FRAME_HEADER). Requests carry an ID and may be
+ *     pipelined; the server runs them in order and answers each with one
+ *     frame holding that ID, the command's status and all of its output.
+ */
+
+#include <stddef.h>
+
+#include "terminal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief First bytes a framed client sends, and the server's acknowledgement. */
+#define TERM_FRAME_HELLO "\0OSF"
+#define TERM_FRAME_HELLO_LEN 4
+
+/**
+ * @brief Frame header size: three big-endian 32-bit fields, then the payload.
+ *
+ *   - payload length (requests longer than max_line get an error reply and the connection closes)
+ *   - request ID, chosen by the client and echoed in the reply
+ *   - status: 0 in requests; in replies the command's status as with terminal_exec_line()
+ *
+ * A request's payload is one command line without newline; a reply's is
+ * everything the command printed. `exit` is answered with an empty reply
+ * before the connection closes.
+ */
+#define TERM_FRAME_HEADER 12
+
+/** @brief Listener and limit settings; zero fields take the documented default. */
+struct term_serve_config {
+    const char *host;       /**< TCP address to bind; NULL = all IPv6 and IPv4 addresses. */
+    int port;               /**< TCP port; 0 = ephemeral, -1 = no TCP listener. */
+    const char *unix_path;  /**< Unix socket path; NULL = none. A stale socket file is replaced. */
+    int threads;            /**< Event loops; 0 = one per CPU the process may run on. */
+    int max_conns;          /**< Concurrent clients; 0 = as many as RLIMIT_NOFILE allows. */
+    size_t max_line;        /**< Longest accepted line or request; 0 = 64 KiB. Longer ones close the connection. */
+    size_t max_pending;     /**< Unsent output per client before its input is paused; 0 = 256 KiB. */
+    const char *prompt;     /**< Sent on connect and after every line (not frame); NULL = none. */
+};
+
+/**
+ * @brief Run the server until terminal_serve_stop() is called.
+ *
+ * Binding errors are reported before any loop starts. The soft
+ * RLIMIT_NOFILE is raised to the hard limit. A client's session ends on
+ * `exit`/`quit` (after its pending output is sent) or when it disconnects.
+ *
+ * @return 0 after a stop, -1 if the listeners could not be set up (reason on stderr).
+ */
+int terminal_serve(const struct term_registry *reg, const struct term_serve_config *cfg);
+
+/** @brief Ask a running terminal_serve() to close all clients and return; async-signal-safe. */
+void terminal_serve_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TERMINAL_SERVER_H */
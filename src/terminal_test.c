@@ -1,35 +1,134 @@
 #include "terminal.h"
+#include "terminal_history.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 static int cmd_help(int argc, char **argv, void *ctx) {
+    (void)argc; (void)argv;
     const struct term_cmd *cmds = (const struct term_cmd *)ctx;
-    printf("Available commands:\n");
+    fprintf(term_out(), "Available commands:\n");
     for (int i = 0; cmds[i].name != NULL; ++i) {
-        printf("  %s\t- %s\n", cmds[i].name, cmds[i].help ? cmds[i].help : "");
+        fprintf(term_out(), "  %s\t- %s\n", cmds[i].name, cmds[i].help ? cmds[i].help : "");
     }
     return 0;
 }
 
 static int cmd_echo(int argc, char **argv, void *ctx) {
+    (void)ctx;
     for (int i = 1; i < argc; ++i) {
-        if (i != 1) putchar(' ');
-        fputs(argv[i], stdout);
+        if (i != 1) fputc(' ', term_out());
+        fputs(argv[i], term_out());
     }
-    putchar('\n');
+    fputc('\n', term_out());
     return 0;
 }
 
+static int cmd_seq(int argc, char **argv, void *ctx) {
+    (void)ctx;
+    long n = argc > 1 ? atol(argv[1]) : 10;
+    for (long i = 1; i <= n; ++i)
+        if (fprintf(term_out(), "%ld\n", i) < 0) return 1;   /* reader went away */
+    return 0;
+}
+
+/* Copies the input lines that contain argv[1] (a plain substring). */
+static int cmd_grep(int argc, char **argv, void *ctx) {
+    (void)ctx;
+    if (argc < 2) {
+        fputs("usage: grep TEXT\n", term_err());
+        return 2;
+    }
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int found = 0;
+    while ((len = getline(&line, &cap, term_in())) >= 0) {
+        if (strstr(line, argv[1])) {
+            fwrite(line, 1, (size_t)len, term_out());
+            found = 1;
+        }
+    }
+    free(line);
+    return found ? 0 : 1;
+}
+
+static int cmd_count(int argc, char **argv, void *ctx) {
+    (void)argc; (void)argv; (void)ctx;
+    char buf[65536];
+    size_t n, lines = 0;
+    while ((n = fread(buf, 1, sizeof(buf), term_in())) > 0)
+        for (char *p = buf; (p = memchr(p, '\n', (size_t)(buf + n - p))) != NULL; ++p) ++lines;
+    fprintf(term_out(), "%zu\n", lines);
+    return 0;
+}
+
+/* Sleeps in 10 ms slices so that `cancel` takes effect promptly. */
+static int cmd_sleep(int argc, char **argv, void *ctx) {
+    (void)ctx;
+    double left = argc > 1 ? atof(argv[1]) : 1.0;
+    struct timespec slice = {0, 10 * 1000 * 1000};
+    for (; left > 0; left -= 0.01) {
+        if (term_job_cancelled()) {
+            fputs("sleep: cancelled\n", term_err());
+            return 130;
+        }
+        nanosleep(&slice, NULL);
+    }
+    fprintf(term_out(), "slept %s s\n", argc > 1 ? argv[1] : "1");
+    return 0;
+}
+
+/*
+ * History survives restarts: $OS_TERMINAL_HISTORY, or ~/.os_terminal_history
+ * for interactive sessions (scripts only get one when asked for).
+ */
+static struct term_history *open_history(int interactive) {
+    char path[4096];
+    const char *hist = getenv("OS_TERMINAL_HISTORY");
+    if (!hist && interactive && getenv("HOME")) {
+        snprintf(path, sizeof(path), "%s/.os_terminal_history", getenv("HOME"));
+        hist = path;
+    }
+    if (!hist || !*hist) return NULL;
+    const char *err = NULL;
+    struct term_history *h = term_history_open(hist, 0, &err);
+    if (!h) fprintf(stderr, "%s: %s (history disabled)\n", hist, err);
+    return h;
+}
+
 int main(void) {
     struct term_cmd cmds[] = {
-        {"help", "Show this help", cmd_help, NULL},
-        {"echo", "Print arguments", cmd_echo, NULL},
-        {NULL, NULL, NULL, NULL}
+        {"help", "Show this help", cmd_help, NULL, TERM_CMD_STREAMS},
+        {"echo", "Print arguments", cmd_echo, NULL, TERM_CMD_STREAMS},
+        {"sleep", "Wait SECONDS (may run in the background with &)", cmd_sleep, NULL,
+         TERM_CMD_ASYNC | TERM_CMD_STREAMS},
+        {"seq", "Print the numbers 1..N", cmd_seq, NULL, TERM_CMD_STREAMS},
+        {"grep", "Print the input lines containing TEXT (e.g. seq 100 | grep 7)", cmd_grep, NULL, TERM_CMD_STREAMS},
+        {"count", "Count the input lines", cmd_count, NULL, TERM_CMD_STREAMS},
+        {NULL, NULL, NULL, NULL, 0}
     };
 
     /* make help see list */
     cmds[0].ctx = cmds;
 
-    printf("Simple terminal demo. Type 'help' for commands, 'exit' to quit.\n");
-    return terminal_run("os> ", cmds, 2);
+    int interactive = isatty(STDIN_FILENO);
+    struct term_history *h = open_history(interactive);
+    terminal_set_history(h);
+
+    int ret;
+    if (!interactive) {
+        /* scripted input (e.g. a pipe): no prompts, buffered output */
+        struct term_registry *reg = term_registry_new(cmds, -1);
+        ret = reg ? terminal_run_batch(STDIN_FILENO, reg) : 1;
+        term_registry_free(reg);
+    } else {
+        printf("Simple terminal demo. Type 'help' for commands, 'exit' to quit.\n");
+        ret = terminal_run("os> ", cmds, -1);
+    }
+    terminal_set_history(NULL);
+    term_history_close(h);
+    return ret;
 }
@@ -1,5 +1,6 @@
 import os
 import json
+import operator
 import pytest
 import testinfra
 
@@ -19,6 +20,49 @@ EXPECTED_EXEC = cfg.get('service_exec')
 EXPECTED_SYSCTL = cfg.get('sysctl', {})
 
 
+_OPS = {'==': operator.eq, '!=': operator.ne, '>=': operator.ge,
+        '<=': operator.le, '>': operator.gt, '<': operator.lt}
+
+
+def _int(text):
+    try:
+        return int(text)
+    except ValueError:
+        return None
+
+
+def _field_matches(expected, actual):
+    # Mirrors scripts/c-c++/os_expect.h: "*", comparisons, a..b ranges, {a,b} sets.
+    if expected == '*':
+        return True
+    if expected.startswith('{') and expected.endswith('}'):
+        return any(_field_matches(atom.strip(), actual) for atom in expected[1:-1].split(','))
+    lo, sep, hi = expected.partition('..')
+    if sep and _int(lo) is not None and _int(hi) is not None:
+        return _int(actual) is not None and _int(lo) <= _int(actual) <= _int(hi)
+    op = next((o for o in ('==', '!=', '>=', '<=', '>', '<') if expected.startswith(o)), '==')
+    if expected.startswith(op):
+        expected = expected[len(op):].strip()
+    if _int(expected) is not None:
+        return _int(actual) is not None and _OPS[op](_int(actual), _int(expected))
+    return op in ('==', '!=') and _OPS[op](actual, expected)
+
+
+def sysctl_matches(expected, value):
+    """Match a sysctl value against a config expectation such as "2", ">= 100000" or "32768 60999"."""
+    fields = []
+    for tok in str(expected).split():
+        # Keep "{1, 2}" whole and join a bare operator with its operand (">= 100000").
+        if fields and (fields[-1] in _OPS or (fields[-1].startswith('{') and not fields[-1].endswith('}'))):
+            fields[-1] += tok
+        else:
+            fields.append(tok)
+    if fields == ['*']:
+        return True
+    actual = value.split()
+    return len(fields) == len(actual) and all(_field_matches(e, a) for e, a in zip(fields, actual))
+
+
 def test_sysctl_values():
     # If no sysctl expectations provided, skip
     if not EXPECTED_SYSCTL:
@@ -30,7 +74,7 @@ def test_sysctl_values():
         if res.rc != 0 or res.stdout.strip() == '':
             pytest.skip('sysctl key %s not present on this system' % key)
         value = res.stdout.strip()
-        assert value == str(expected), 'sysctl %s -> expected %s, got %s' % (key, expected, value)
+        assert sysctl_matches(expected, value), 'sysctl %s -> expected %s, got %s' % (key, expected, value)
 
 
 def test_systemd_unit_contents_and_active():